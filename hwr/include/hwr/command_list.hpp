@@ -0,0 +1 @@
+#include "../rendering_pipeline/gpu/command/command_list.hpp"
\ No newline at end of file
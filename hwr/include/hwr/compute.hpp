@@ -0,0 +1 @@
+#include "../rendering_pipeline/compute/compute_kernel.hpp"
\ No newline at end of file
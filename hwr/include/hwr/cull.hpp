@@ -0,0 +1 @@
+#include "../rendering_pipeline/cull/transform_cull.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../rendering_pipeline/draw/instanced_draw.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../rendering_pipeline/frame_graph/frame_graph.hpp"
\ No newline at end of file
@@ -0,0 +1,2 @@
+#include "../rendering_pipeline/framebuffer/framebuffer.hpp"
+#include "../rendering_pipeline/framebuffer/readback.hpp"
\ No newline at end of file
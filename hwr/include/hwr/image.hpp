@@ -0,0 +1,3 @@
+#include "../rendering_pipeline/gpu/image/gpu_image.hpp"
+#include "../rendering_pipeline/gpu/image/mip_chain.hpp"
+#include "../rendering_pipeline/gpu/image/texture_cache.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../util/jobs/thread_pool.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../rendering_pipeline/gpu/kernel/kernel.hpp"
\ No newline at end of file
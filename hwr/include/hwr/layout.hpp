@@ -0,0 +1 @@
+#include "../rendering_pipeline/layout/struct_layout.hpp"
\ No newline at end of file
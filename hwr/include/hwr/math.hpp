@@ -1 +1,2 @@
-#include "../util/math/math_util.hpp"
\ No newline at end of file
+#include "../util/math/math_util.hpp"
+#include "../util/math/transform.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../rendering_pipeline/mesh/mesh.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../util/metrics/metrics.hpp"
\ No newline at end of file
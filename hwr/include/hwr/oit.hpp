@@ -0,0 +1 @@
+#include "../rendering_pipeline/oit/fragment_lists.hpp"
\ No newline at end of file
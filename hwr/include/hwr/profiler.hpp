@@ -0,0 +1 @@
+#include "../rendering_pipeline/gpu/profiling/gpu_profiler.hpp"
\ No newline at end of file
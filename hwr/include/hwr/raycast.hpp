@@ -0,0 +1 @@
+#include "../rendering_pipeline/raycast/ray_caster.hpp"
\ No newline at end of file
@@ -0,0 +1,2 @@
+#include "../rendering_pipeline/scene/scene_graph.hpp"
+#include "../rendering_pipeline/scene/bvh.hpp"
\ No newline at end of file
@@ -0,0 +1,2 @@
+#include "../rendering_pipeline/mesh/scene_file.hpp"
+#include "../rendering_pipeline/mesh/scene_streamer.hpp"
\ No newline at end of file
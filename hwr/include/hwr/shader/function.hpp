@@ -0,0 +1 @@
+#include "../../../rendering_pipeline/gpu/shader/function.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../../rendering_pipeline/gpu/shader/work_group.hpp"
\ No newline at end of file
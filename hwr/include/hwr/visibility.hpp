@@ -0,0 +1,2 @@
+#include "../rendering_pipeline/raster/visibility_raster.hpp"
+#include "../rendering_pipeline/shading/visibility_shading.hpp"
\ No newline at end of file
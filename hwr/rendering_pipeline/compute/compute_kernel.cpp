@@ -0,0 +1,45 @@
+#include "compute_kernel.hpp"
+
+namespace hwr {
+
+namespace detail {
+
+std::string makeComputeSource(const std::vector<KernelParam>& params,
+                              const std::string& body)
+{
+    std::string signature;
+    for (const KernelParam& p : params) {
+        signature += (signature.empty() ? "\n    " : ",\n    ") + p.declaration;
+    }
+
+    std::string src(OPENCL_STDINT_PRELUDE);
+    src += "__kernel void " + std::string(COMPUTE_ENTRY) + "(" + signature + ")\n"
+           "{\n";
+    src += body;
+    src += "}\n";
+    return src;
+}
+
+} // namespace detail
+
+void ComputeKernel::dispatch(const cl::NDRange& global, const cl::NDRange& local) {
+    if (local.dimensions() != 0) {
+        if (local.dimensions() != global.dimensions()) {
+            HWR_FATAL("ComputeKernel::dispatch - global and local ranges differ in dimensions");
+        }
+        for (size_t d = 0; d < global.dimensions(); ++d) {
+            if (local.get()[d] == 0 || global.get()[d] % local.get()[d] != 0) {
+                HWR_FATAL("ComputeKernel::dispatch - local size must divide the global size");
+            }
+        }
+    }
+    m_kernel.dispatch(global, local);
+}
+
+std::string ComputeKernel::generateSource(Program& body) {
+    const std::string code = body.compile();
+    return detail::makeBodyPrelude(body)
+         + detail::makeComputeSource(body.parameters(), code);
+}
+
+} // namespace hwr
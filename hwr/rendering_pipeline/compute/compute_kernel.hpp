@@ -0,0 +1,61 @@
+#ifndef HWR_COMPUTE_KERNEL_HPP
+#define HWR_COMPUTE_KERNEL_HPP
+
+#include "../draw/instanced_draw.hpp"
+#include "../gpu/shader/work_group.hpp"
+
+namespace hwr {
+
+namespace detail {
+
+    std::string makeComputeSource(const std::vector<KernelParam>& params,
+                                  const std::string& body);
+
+} // namespace detail
+
+inline constexpr const char* COMPUTE_ENTRY = "hwr_compute";
+
+/**
+* \class ComputeKernel
+* \brief Runs a shader body once per work-item of an NDRange, with no
+*        fixed inputs or outputs.
+*
+* Everything the body reads or writes is declared in it: global_buffer(),
+* local_array(), textures and samplers. Buffers and images are bound by
+* name with bind(); local arrays are sized by their declaration.
+*
+* Work-items are never dropped, so the body may use barrier(). When it
+* does, dispatch with an explicit local size that divides the global one,
+* and keep out-of-range items alive until after the last barrier instead
+* of returning early.
+*/
+class ComputeKernel {
+public:
+    template<typename Lambda,
+        typename = std::enable_if_t<std::is_invocable_v<Lambda>>>
+    ComputeKernel(const GPUContext& ctx, Lambda&& body)
+        : m_body(std::forward<Lambda>(body))
+        , m_kernel(ctx, generateSource(m_body), COMPUTE_ENTRY)
+    {
+        detail::declareBodyParams(m_kernel, 0, m_body.parameters());
+    }
+
+    template<typename T>
+    void bind(const std::string& name, const T& value) {
+        m_kernel.setParam(name, value);
+    }
+
+    void dispatch(const cl::NDRange& global, const cl::NDRange& local = cl::NullRange);
+
+    const Kernel& kernel() const { return m_kernel; }
+
+private:
+    Program m_body;
+    Kernel m_kernel;
+
+    static std::string generateSource(Program& body);
+};
+
+} // namespace hwr
+
+#endif // HWR_COMPUTE_KERNEL_HPP
@@ -0,0 +1,188 @@
+#include "transform_cull.hpp"
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+namespace hwr {
+
+    namespace {
+
+        const char* TRANSFORM_CULL_SOURCE = R"CLC(
+__kernel void hwr_transform_soa(const float16 m,
+    __global const float* ix, __global const float* iy,
+    __global const float* iz, __global const float* iw,
+    __global float* ox, __global float* oy, __global float* oz, __global float* ow,
+    const uint count)
+{
+    const uint i = get_global_id(0);
+    if (i >= count) return;
+    const float4 v = (float4)(ix[i], iy[i], iz[i], iw[i]);
+    ox[i] = dot(m.s0123, v);
+    oy[i] = dot(m.s4567, v);
+    oz[i] = dot(m.s89ab, v);
+    ow[i] = dot(m.scdef, v);
+}
+
+__kernel void hwr_cull_spheres(const float4 p0, const float4 p1, const float4 p2,
+    const float4 p3, const float4 p4, const float4 p5,
+    __global const float* x, __global const float* y,
+    __global const float* z, __global const float* r,
+    const uint count, __global uint* visible, __global uint* visibleCount)
+{
+    const uint i = get_global_id(0);
+    if (i >= count) return;
+    const float4 c = (float4)(x[i], y[i], z[i], 1.0f);
+    const float d = min(min(min(dot(p0, c), dot(p1, c)), min(dot(p2, c), dot(p3, c))),
+                        min(dot(p4, c), dot(p5, c)));
+    if (d < -r[i]) return;
+    visible[atomic_inc(visibleCount)] = i;
+}
+)CLC";
+
+        vec4f normalizedPlane(const vec4f& p) {
+            const float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+            return len > 0.0f ? vec_scale(p, 1.0f / len) : p;
+        }
+
+        void checkSize(size_t count, std::initializer_list<size_t> sizes, const char* what) {
+            if (count > std::numeric_limits<cl_uint>::max()) {
+                HWR_FATAL(std::string(what) + " - count exceeds 32 bits");
+            }
+            for (size_t size : sizes) {
+                if (size < count) {
+                    HWR_FATAL(std::string(what) + " - buffer smaller than count");
+                }
+            }
+        }
+
+    }
+
+    Frustum Frustum::fromViewProjection(const mat4f& viewProj) {
+        const auto row = [&](int r) {
+            return vec4f{ viewProj.m[r][0], viewProj.m[r][1], viewProj.m[r][2], viewProj.m[r][3] };
+        };
+        const vec4f r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+        Frustum f;
+        f.planes[0] = normalizedPlane(vec_add(r3, r0)); // left
+        f.planes[1] = normalizedPlane(vec_sub(r3, r0)); // right
+        f.planes[2] = normalizedPlane(vec_add(r3, r1)); // bottom
+        f.planes[3] = normalizedPlane(vec_sub(r3, r1)); // top
+        f.planes[4] = normalizedPlane(vec_add(r3, r2)); // near
+        f.planes[5] = normalizedPlane(vec_sub(r3, r2)); // far
+        return f;
+    }
+
+    size_t cull_spheres_soa(const Frustum& frustum, const_vec4f_soa spheres,
+                            size_t begin, size_t end, uint32_t* visible)
+    {
+        using Wide = detail::simd::Wide;
+        namespace simd = detail::simd;
+
+        size_t n = 0;
+        size_t i = begin;
+        float nearest[Wide::WIDTH];
+        for (; i + Wide::WIDTH <= end; i += Wide::WIDTH) {
+            const Wide::type x = Wide::load(spheres.x + i);
+            const Wide::type y = Wide::load(spheres.y + i);
+            const Wide::type z = Wide::load(spheres.z + i);
+            const Wide::type r = Wide::load(spheres.w + i);
+            // min over planes of (signed distance + radius); < 0 is outside one.
+            const auto distance = [&](const vec4f& plane) {
+                Wide::type d = simd::fmadd(Wide::splat(plane.x), x, simd::add(Wide::splat(plane.w), r));
+                d = simd::fmadd(Wide::splat(plane.y), y, d);
+                return simd::fmadd(Wide::splat(plane.z), z, d);
+            };
+            Wide::type d = distance(frustum.planes[0]);
+            for (int p = 1; p < 6; ++p) {
+                d = simd::min(d, distance(frustum.planes[p]));
+            }
+            Wide::store(nearest, d);
+            for (size_t lane = 0; lane < Wide::WIDTH; ++lane) {
+                visible[n] = static_cast<uint32_t>(i + lane);
+                n += nearest[lane] >= 0.0f ? 1 : 0;
+            }
+        }
+        for (; i < end; ++i) {
+            bool inside = true;
+            for (const vec4f& plane : frustum.planes) {
+                const float dist = plane.x * spheres.x[i] + plane.y * spheres.y[i]
+                                 + plane.z * spheres.z[i] + plane.w;
+                inside = inside && dist >= -spheres.w[i];
+            }
+            if (inside) {
+                visible[n++] = static_cast<uint32_t>(i);
+            }
+        }
+        return n;
+    }
+
+    DeviceTransformCull::DeviceTransformCull(const GPUContext& ctx)
+        : m_transform(ctx, TRANSFORM_CULL_SOURCE, "hwr_transform_soa")
+        , m_cull(ctx, TRANSFORM_CULL_SOURCE, "hwr_cull_spheres")
+        , m_visibleCount(ctx, 1)
+    {}
+
+    void DeviceTransformCull::transform(const mat4f& m, ConstVec4Array in, Vec4Array out, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        checkSize(count, { in.x.size(), in.y.size(), in.z.size(), in.w.size(),
+                           out.x.size(), out.y.size(), out.z.size(), out.w.size() },
+                  "DeviceTransformCull::transform");
+        m_transform.setArgs(m, in.x, in.y, in.z, in.w, out.x, out.y, out.z, out.w,
+                            static_cast<cl_uint>(count));
+        m_transform.dispatch(cl::NDRange(count));
+    }
+
+    size_t DeviceTransformCull::cull(const Frustum& frustum, ConstVec4Array spheres,
+                                     IndexArray visible, size_t count)
+    {
+        if (count == 0) {
+            return 0;
+        }
+        checkSize(count, { spheres.x.size(), spheres.y.size(), spheres.z.size(),
+                           spheres.w.size(), visible.size() },
+                  "DeviceTransformCull::cull");
+        m_visibleCount.writeFrom(std::vector<uint32_t>{ 0 });
+        const vec4f* p = frustum.planes;
+        m_cull.setArgs(p[0], p[1], p[2], p[3], p[4], p[5],
+                       spheres.x, spheres.y, spheres.z, spheres.w,
+                       static_cast<cl_uint>(count), visible, m_visibleCount);
+        m_cull.dispatch(cl::NDRange(count));
+        std::vector<uint32_t> visibleCount;
+        m_visibleCount.readTo(visibleCount);
+        return visibleCount[0];
+    }
+
+    void HostTransformCull::transform(const mat4f& m, ConstVec4Array in, Vec4Array out, size_t count) {
+        m_pool.parallelFor(count, m_grain, [&](size_t begin, size_t end) {
+            mat_mul_vec_soa(m,
+                            { in.x + begin, in.y + begin, in.z + begin, in.w + begin },
+                            { out.x + begin, out.y + begin, out.z + begin, out.w + begin },
+                            end - begin);
+        });
+    }
+
+    size_t HostTransformCull::cull(const Frustum& frustum, ConstVec4Array spheres,
+                                   IndexArray visible, size_t count)
+    {
+        // Each chunk fills its own range of visible, then the ranges are
+        // packed in order.
+        const size_t grain = std::max<size_t>(m_grain, 1);
+        std::vector<size_t> found((count + grain - 1) / grain);
+        m_pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+            found[begin / grain] = cull_spheres_soa(frustum, spheres, begin, end, visible + begin);
+        });
+        size_t n = 0;
+        for (size_t c = 0; c < found.size(); ++c) {
+            if (n != c * grain) {
+                std::memmove(visible + n, visible + c * grain, found[c] * sizeof(uint32_t));
+            }
+            n += found[c];
+        }
+        return n;
+    }
+
+} // namespace hwr
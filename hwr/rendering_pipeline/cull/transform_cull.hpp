@@ -0,0 +1,88 @@
+#ifndef HWR_TRANSFORM_CULL_HPP
+#define HWR_TRANSFORM_CULL_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/kernel/kernel.hpp"
+#include "../../util/jobs/thread_pool.hpp"
+#include "../../util/math/math_util.hpp"
+#include <cstdint>
+
+namespace hwr {
+
+// Six normalized planes (xyz normal pointing inside, w offset).
+struct Frustum {
+    vec4f planes[6];
+
+    // Planes of the clip volume of a row-major view-projection matrix,
+    // OpenCL/GL convention (-w <= z <= w).
+    static Frustum fromViewProjection(const mat4f& viewProj);
+};
+
+// Device counterpart of vec4f_soa: one float buffer per component.
+struct DeviceVec4Soa {
+    const BaseBuffer<float>& x;
+    const BaseBuffer<float>& y;
+    const BaseBuffer<float>& z;
+    const BaseBuffer<float>& w;
+};
+
+/**
+* \class DeviceTransformCull
+* \brief Transforms and frustum-culls SoA vectors with OpenCL kernels.
+*
+* Bounding spheres are passed as vectors with the center in xyz and the
+* radius in w. cull() writes the indices of the visible spheres, in no
+* particular order, and reads back how many there are.
+*/
+class DeviceTransformCull {
+public:
+    using ConstVec4Array = const DeviceVec4Soa&;
+    using Vec4Array = const DeviceVec4Soa&;
+    using IndexArray = const BaseBuffer<uint32_t>&;
+
+    explicit DeviceTransformCull(const GPUContext& ctx);
+
+    void transform(const mat4f& m, ConstVec4Array in, Vec4Array out, size_t count);
+    size_t cull(const Frustum& frustum, ConstVec4Array spheres, IndexArray visible, size_t count);
+
+private:
+    Kernel m_transform;
+    Kernel m_cull;
+    AllPurposeBuffer<uint32_t> m_visibleCount;
+};
+
+/**
+* \class HostTransformCull
+* \brief CPU fallback of DeviceTransformCull with the same interface,
+*        over host arrays.
+*
+* Work is split in chunks of grain elements across the pool, each chunk
+* using the batch math functions. cull() writes the visible indices in
+* ascending order.
+*/
+class HostTransformCull {
+public:
+    using ConstVec4Array = const_vec4f_soa;
+    using Vec4Array = vec4f_soa;
+    using IndexArray = uint32_t*;
+
+    explicit HostTransformCull(ThreadPool& pool, size_t grain = 16384)
+        : m_pool(pool), m_grain(grain) {}
+
+    void transform(const mat4f& m, ConstVec4Array in, Vec4Array out, size_t count);
+    size_t cull(const Frustum& frustum, ConstVec4Array spheres, IndexArray visible, size_t count);
+
+private:
+    ThreadPool& m_pool;
+    size_t m_grain;
+};
+
+// Indices i < count with sphere i at least partially inside the frustum,
+// written to visible in ascending order; returns how many. Single-threaded
+// building block of HostTransformCull.
+size_t cull_spheres_soa(const Frustum& frustum, const_vec4f_soa spheres,
+                        size_t begin, size_t end, uint32_t* visible);
+
+} // namespace hwr
+
+#endif // HWR_TRANSFORM_CULL_HPP
@@ -0,0 +1,77 @@
+#include "instanced_draw.hpp"
+
+namespace hwr::detail {
+
+std::string makeInstancedDrawSource(const std::string& structDefs,
+                                    const std::string& vertexType,
+                                    const std::string& instanceType,
+                                    const std::string& outputType,
+                                    const std::vector<KernelParam>& params,
+                                    const std::string& body)
+{
+    const std::string V = "struct " + vertexType;
+    const std::string I = "struct " + instanceType;
+    const std::string O = "struct " + outputType;
+
+    std::string src(OPENCL_STDINT_PRELUDE);
+    src += structDefs;
+    src += "__kernel void " + std::string(INSTANCED_DRAW_ENTRY) + "(\n"
+           "    __global const " + V + "* hwr_vertices, const uint hwr_vertex_count,\n"
+           "    __global const " + I + "* hwr_instances, const uint hwr_instance_count,\n"
+           "    __global " + O + "* hwr_output" + makeParamList(params) + ")\n"
+           "{\n"
+           "const uint hwr_vertex_id = (uint)get_global_id(0);\n"
+           "const uint hwr_instance_id = (uint)get_global_id(1);\n"
+           "if (hwr_vertex_id >= hwr_vertex_count || hwr_instance_id >= hwr_instance_count) return;\n"
+           "__global const " + V + "* hwr_vertex = hwr_vertices + hwr_vertex_id;\n"
+           "__global const " + I + "* hwr_instance = hwr_instances + hwr_instance_id;\n"
+           "__global " + O + "* hwr_out = hwr_output"
+           " + (size_t)hwr_instance_id * hwr_vertex_count + hwr_vertex_id;\n";
+    src += body;
+    src += "}\n";
+    return src;
+}
+
+std::string makeParamList(const std::vector<KernelParam>& params)
+{
+    std::string res;
+    for (const KernelParam& p : params) {
+        res += ",\n    " + p.declaration;
+    }
+    return res;
+}
+
+std::vector<std::string> paramNames(const std::vector<KernelParam>& params)
+{
+    std::vector<std::string> names;
+    names.reserve(params.size());
+    for (const KernelParam& p : params) {
+        names.push_back(p.name);
+    }
+    return names;
+}
+
+void declareBodyParams(Kernel& kernel, cl_uint firstIndex,
+                       const std::vector<KernelParam>& params)
+{
+    kernel.declareParams(firstIndex, paramNames(params));
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (params[i].localBytes > 0) {
+            kernel.setArg(firstIndex + static_cast<cl_uint>(i), cl::Local(params[i].localBytes));
+        }
+    }
+}
+
+std::string makeBodyPrelude(const Program& body)
+{
+    std::string res;
+    for (const std::string& e : body.extensions()) {
+        res += "#pragma OPENCL EXTENSION " + e + " : enable\n";
+    }
+    for (const FunctionDef& f : body.functions()) {
+        res += f.source;
+    }
+    return res;
+}
+
+} // namespace hwr::detail
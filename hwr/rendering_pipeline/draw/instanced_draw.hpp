@@ -0,0 +1,166 @@
+#ifndef HWR_INSTANCED_DRAW_HPP
+#define HWR_INSTANCED_DRAW_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/kernel/kernel.hpp"
+#include "../gpu/shader/shader.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+#include <limits>
+
+namespace hwr {
+
+// Built-ins usable inside the body of an InstancedDraw.
+// Field names refer to the HWR_STRUCT members, e.g. instance<float>("color[0]").
+namespace draw {
+
+    inline ShaderRValue<uint32_t> vertex_id() {
+        return ShaderRValue<uint32_t>(std::string("hwr_vertex_id"));
+    }
+
+    inline ShaderRValue<uint32_t> instance_id() {
+        return ShaderRValue<uint32_t>(std::string("hwr_instance_id"));
+    }
+
+    // Read-only access to the current vertex.
+    template<AllowedShaderType T>
+    ShaderRValue<T> vertex(const std::string& field) {
+        return ShaderRValue<T>("hwr_vertex->" + field);
+    }
+
+    // Read-only access to the current instance.
+    template<AllowedShaderType T>
+    ShaderRValue<T> instance(const std::string& field) {
+        return ShaderRValue<T>("hwr_instance->" + field);
+    }
+
+    // Writable slot for this (vertex, instance) pair in the output buffer.
+    template<AllowedShaderType T>
+    ShaderValue<T> output(const std::string& field) {
+        return ShaderValue<T>(detail::bind_existing, "hwr_out->" + field);
+    }
+
+} // namespace draw
+
+namespace detail {
+
+    // Wraps the generated body into the instanced draw kernel.
+    // structDefs must contain every struct named in the signature, params
+    // (textures, samplers) are appended after the fixed arguments.
+    std::string makeInstancedDrawSource(const std::string& structDefs,
+                                        const std::string& vertexType,
+                                        const std::string& instanceType,
+                                        const std::string& outputType,
+                                        const std::vector<KernelParam>& params,
+                                        const std::string& body);
+
+    // Signature fragment for the extra parameters, one ",\n    decl" each.
+    std::string makeParamList(const std::vector<KernelParam>& params);
+
+    std::vector<std::string> paramNames(const std::vector<KernelParam>& params);
+
+    // Names the body parameters from firstIndex on and sizes the __local
+    // arrays among them, which are never bound by name.
+    void declareBodyParams(Kernel& kernel, cl_uint firstIndex,
+                           const std::vector<KernelParam>& params);
+
+    // What the compiled body needs ahead of the kernel: the pragmas that
+    // enable its extensions, then the functions it calls.
+    std::string makeBodyPrelude(const Program& body);
+
+    // The HWR_STRUCT definitions are shared Programs; serializes their
+    // compilation when pipelines are built on several threads.
+    inline std::mutex struct_def_mutex;
+
+    // Compiles each distinct HWR_STRUCT definition once.
+    template<ShaderStruct... Ts>
+    std::string compileStructDefs() {
+        std::lock_guard<std::mutex> lock(struct_def_mutex);
+        std::vector<std::string_view> seen;
+        std::string res;
+        auto add = [&](std::string_view name, Program& def) {
+            for (std::string_view s : seen) {
+                if (s == name) return;
+            }
+            seen.push_back(name);
+            res += def.compile();
+        };
+        (add(Ts::opencl_name, Ts::opencl_def), ...);
+        return res;
+    }
+
+} // namespace detail
+
+inline constexpr const char* INSTANCED_DRAW_ENTRY = "hwr_instanced_draw";
+
+/**
+* \class InstancedDraw
+* \brief Runs one shader body for every (vertex, instance) pair in a single
+*        dispatch.
+*
+* The output buffer is laid out instance-major: the result for vertex v of
+* instance i lives at index i * vertexCount + v. Textures and samplers
+* declared in the body are bound by name with bind().
+*/
+template<ShaderStruct Vertex, ShaderStruct Instance, ShaderStruct Output>
+class InstancedDraw {
+public:
+    template<typename Lambda,
+        typename = std::enable_if_t<std::is_invocable_v<Lambda>>>
+    InstancedDraw(const GPUContext& ctx, Lambda&& body)
+        : m_body(std::forward<Lambda>(body))
+        , m_kernel(ctx, generateSource(m_body), INSTANCED_DRAW_ENTRY)
+    {
+        detail::declareBodyParams(m_kernel, FIXED_ARGS, m_body.parameters());
+    }
+
+    // Binds a Texture2D, Texture2DArray or Sampler to the body parameter
+    // of the same name. Stays bound across draw() calls.
+    template<typename T>
+    void bind(const std::string& name, const T& value) {
+        m_kernel.setParam(name, value);
+    }
+
+    void draw(const BaseBuffer<Vertex>& vertices,
+              const BaseBuffer<Instance>& instances,
+              const BaseBuffer<Output>& out)
+    {
+        if (vertices.size() == 0 || instances.size() == 0) {
+            return;
+        }
+        if (out.size() != vertices.size() * instances.size()) {
+            HWR_FATAL("InstancedDraw::draw - output must hold vertexCount * instanceCount elements");
+        }
+        if (vertices.size() > std::numeric_limits<cl_uint>::max()
+            || instances.size() > std::numeric_limits<cl_uint>::max()) {
+            HWR_FATAL("InstancedDraw::draw - too many vertices or instances");
+        }
+        m_kernel.setArgs(vertices, static_cast<cl_uint>(vertices.size()),
+                         instances, static_cast<cl_uint>(instances.size()),
+                         out);
+        m_kernel.dispatch(cl::NDRange(vertices.size(), instances.size()));
+    }
+
+    const Kernel& kernel() const { return m_kernel; }
+
+private:
+    static constexpr cl_uint FIXED_ARGS = 5;
+
+    Program m_body;
+    Kernel m_kernel;
+
+    static std::string generateSource(Program& body) {
+        const std::string code = body.compile();
+        return detail::makeBodyPrelude(body)
+             + detail::makeInstancedDrawSource(
+            detail::compileStructDefs<Vertex, Instance, Output>(),
+            Vertex::opencl_name, Instance::opencl_name, Output::opencl_name,
+            body.parameters(), code
+        );
+    }
+};
+
+} // namespace hwr
+
+#endif // HWR_INSTANCED_DRAW_HPP
@@ -0,0 +1,438 @@
+#include "frame_graph.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace hwr {
+
+    namespace {
+        constexpr uint32_t NO_PASS = std::numeric_limits<uint32_t>::max();
+        constexpr uint32_t NO_BLOCK = std::numeric_limits<uint32_t>::max();
+    }
+
+    void PassBuilder::read(ResourceId id) {
+        m_graph.resource(id);
+        m_graph.m_passes[m_pass].reads.push_back(id);
+        m_graph.m_resources[id].users.push_back(m_pass);
+    }
+
+    void PassBuilder::write(ResourceId id) {
+        m_graph.resource(id);
+        m_graph.m_passes[m_pass].writes.push_back(id);
+        m_graph.m_resources[id].users.push_back(m_pass);
+    }
+
+    const cl::Buffer& PassContext::buffer(ResourceId id) const {
+        return m_graph.bufferOf(id);
+    }
+
+    FrameGraph::FrameGraph(const GPUContext& ctx, uint32_t queueCount)
+        : m_ctx(ctx)
+    {
+        if (queueCount == 0) {
+            HWR_FATAL("FrameGraph - needs at least one queue");
+        }
+        m_queues.push_back(ctx.getQueue());
+        for (uint32_t i = 1; i < queueCount; ++i) {
+            m_queues.push_back(ctx.createQueue());
+        }
+    }
+
+    ResourceId FrameGraph::createTransient(const std::string& name, size_t bytes) {
+        if (bytes == 0) {
+            HWR_FATAL("FrameGraph::createTransient - " + name + " has no size");
+        }
+        Resource res;
+        res.name = name;
+        res.bytes = bytes;
+        res.block = NO_BLOCK;
+        m_resources.push_back(std::move(res));
+        m_compiled = false;
+        return static_cast<ResourceId>(m_resources.size() - 1);
+    }
+
+    ResourceId FrameGraph::importBuffer(const std::string& name, const cl::Buffer& buffer, size_t bytes) {
+        Resource res;
+        res.name = name;
+        res.bytes = bytes;
+        res.imported = true;
+        res.buffer = buffer;
+        m_resources.push_back(std::move(res));
+        m_compiled = false;
+        return static_cast<ResourceId>(m_resources.size() - 1);
+    }
+
+    void FrameGraph::addPass(const std::string& name,
+                             const std::function<void(PassBuilder&)>& setup,
+                             std::function<void(PassContext&)> execute)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        pass.latency = &metrics().histogram("frame_graph.pass." + pass.name + ".cpu_ms");
+        m_passes.push_back(std::move(pass));
+        PassBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+        if (setup) {
+            setup(builder);
+        }
+        m_compiled = false;
+    }
+
+    void FrameGraph::compile() {
+        for (Pass& pass : m_passes) {
+            pass.deps.clear();
+            pass.waits.clear();
+            pass.live = false;
+            pass.signals = false;
+            pass.queue = 0;
+        }
+        m_order.clear();
+        m_joins.clear();
+
+        buildDependencies();
+        cullPasses();
+        const std::vector<std::vector<bool>> ancestors = computeAncestors();
+        assignQueues(ancestors);
+        aliasTransients(ancestors);
+        m_compiled = true;
+
+        HWR_DEBUG_IN(LogModule::GPU, "FrameGraph::compile - {} of {} passes, {} transient bytes",
+                     m_order.size(), m_passes.size(), transientMemory());
+    }
+
+    void FrameGraph::buildDependencies() {
+        std::vector<uint32_t> lastWriter(m_resources.size(), NO_PASS);
+        std::vector<std::vector<uint32_t>> readers(m_resources.size());
+
+        for (uint32_t i = 0; i < m_passes.size(); ++i) {
+            Pass& pass = m_passes[i];
+            for (ResourceId r : pass.reads) {
+                if (lastWriter[r] != NO_PASS && lastWriter[r] != i) {
+                    pass.deps.push_back(lastWriter[r]);
+                }
+                readers[r].push_back(i);
+            }
+            for (ResourceId r : pass.writes) {
+                if (lastWriter[r] != NO_PASS && lastWriter[r] != i) {
+                    pass.deps.push_back(lastWriter[r]);
+                }
+                for (uint32_t reader : readers[r]) {
+                    if (reader != i) {
+                        pass.deps.push_back(reader);
+                    }
+                }
+                lastWriter[r] = i;
+                readers[r].clear();
+            }
+            std::sort(pass.deps.begin(), pass.deps.end());
+            pass.deps.erase(std::unique(pass.deps.begin(), pass.deps.end()), pass.deps.end());
+        }
+    }
+
+    void FrameGraph::cullPasses() {
+        std::vector<uint32_t> stack;
+        for (uint32_t i = 0; i < m_passes.size(); ++i) {
+            const Pass& pass = m_passes[i];
+            const bool sideEffect = pass.writes.empty()
+                || std::any_of(pass.writes.begin(), pass.writes.end(),
+                               [&](ResourceId r) { return m_resources[r].imported; });
+            if (sideEffect) {
+                stack.push_back(i);
+            }
+        }
+        while (!stack.empty()) {
+            const uint32_t i = stack.back();
+            stack.pop_back();
+            if (m_passes[i].live) {
+                continue;
+            }
+            m_passes[i].live = true;
+            stack.insert(stack.end(), m_passes[i].deps.begin(), m_passes[i].deps.end());
+        }
+        for (uint32_t i = 0; i < m_passes.size(); ++i) {
+            if (m_passes[i].live) {
+                m_order.push_back(i);
+            }
+        }
+    }
+
+    std::vector<std::vector<bool>> FrameGraph::computeAncestors() const {
+        // Dependencies always point to earlier passes, so one forward sweep
+        // gives the transitive closure.
+        std::vector<std::vector<bool>> ancestors(m_passes.size(),
+                                                 std::vector<bool>(m_passes.size(), false));
+        for (uint32_t i = 0; i < m_passes.size(); ++i) {
+            for (uint32_t d : m_passes[i].deps) {
+                ancestors[i][d] = true;
+                for (uint32_t j = 0; j < d; ++j) {
+                    if (ancestors[d][j]) {
+                        ancestors[i][j] = true;
+                    }
+                }
+            }
+        }
+        return ancestors;
+    }
+
+    void FrameGraph::assignQueues(const std::vector<std::vector<bool>>& ancestors) {
+        const size_t queueCount = m_queues.size();
+        std::vector<uint32_t> tail(queueCount, NO_PASS);
+        std::vector<size_t> load(queueCount, 0);
+        // synced[q][o]: latest pass of queue o that queue q already waited for.
+        std::vector<std::vector<uint32_t>> synced(queueCount, std::vector<uint32_t>(queueCount, NO_PASS));
+
+        for (uint32_t i : m_order) {
+            Pass& pass = m_passes[i];
+
+            // Continue the chain of the latest dependency when possible,
+            // otherwise take a queue whose last pass is already ordered
+            // before this one, otherwise the least loaded queue.
+            uint32_t queue = NO_PASS;
+            for (auto d = pass.deps.rbegin(); d != pass.deps.rend() && queue == NO_PASS; ++d) {
+                if (tail[m_passes[*d].queue] == *d) {
+                    queue = m_passes[*d].queue;
+                }
+            }
+            for (uint32_t q = 0; q < queueCount && queue == NO_PASS; ++q) {
+                if (tail[q] == NO_PASS || ancestors[i][tail[q]]) {
+                    queue = q;
+                }
+            }
+            if (queue == NO_PASS) {
+                queue = static_cast<uint32_t>(std::min_element(load.begin(), load.end()) - load.begin());
+            }
+            pass.queue = queue;
+
+            // In-order queues: waiting on the latest dependency of each
+            // other queue covers the earlier ones.
+            std::vector<uint32_t> latest(queueCount, NO_PASS);
+            for (uint32_t d : pass.deps) {
+                const uint32_t q = m_passes[d].queue;
+                if (q != queue && (latest[q] == NO_PASS || d > latest[q])) {
+                    latest[q] = d;
+                }
+            }
+            for (uint32_t q = 0; q < queueCount; ++q) {
+                if (latest[q] == NO_PASS) {
+                    continue;
+                }
+                if (synced[queue][q] != NO_PASS && synced[queue][q] >= latest[q]) {
+                    continue;
+                }
+                pass.waits.push_back(latest[q]);
+                m_passes[latest[q]].signals = true;
+                synced[queue][q] = latest[q];
+            }
+
+            tail[queue] = i;
+            ++load[queue];
+        }
+
+        for (uint32_t q = 1; q < queueCount; ++q) {
+            if (tail[q] != NO_PASS) {
+                m_passes[tail[q]].signals = true;
+                m_joins.push_back(tail[q]);
+            }
+        }
+    }
+
+    void FrameGraph::aliasTransients(const std::vector<std::vector<bool>>& ancestors) {
+        for (Block& block : m_blocks) {
+            block.bytes = 0;
+            block.users.clear();
+        }
+
+        struct Lifetime {
+            ResourceId id;
+            size_t first;
+            std::vector<uint32_t> users;
+        };
+        std::vector<size_t> position(m_passes.size(), 0);
+        for (size_t k = 0; k < m_order.size(); ++k) {
+            position[m_order[k]] = k;
+        }
+        std::vector<Lifetime> lifetimes;
+        for (ResourceId r = 0; r < m_resources.size(); ++r) {
+            Resource& res = m_resources[r];
+            if (res.imported) {
+                continue;
+            }
+            res.block = NO_BLOCK;
+            Lifetime life{r, std::numeric_limits<size_t>::max(), {}};
+            for (uint32_t u : res.users) {
+                if (m_passes[u].live) {
+                    life.users.push_back(u);
+                    life.first = std::min(life.first, position[u]);
+                }
+            }
+            if (!life.users.empty()) {
+                lifetimes.push_back(std::move(life));
+            }
+        }
+        std::sort(lifetimes.begin(), lifetimes.end(),
+                  [](const Lifetime& a, const Lifetime& b) { return a.first < b.first; });
+
+        size_t used = 0;
+        for (const Lifetime& life : lifetimes) {
+            const size_t bytes = m_resources[life.id].bytes;
+            // A block can be shared once every pass touching its current
+            // occupant is ordered before every pass touching this resource.
+            uint32_t best = NO_BLOCK;
+            for (uint32_t b = 0; b < used; ++b) {
+                const bool ordered = std::all_of(m_blocks[b].users.begin(), m_blocks[b].users.end(),
+                    [&](uint32_t before) {
+                        return std::all_of(life.users.begin(), life.users.end(),
+                            [&](uint32_t after) { return ancestors[after][before]; });
+                    });
+                if (!ordered) {
+                    continue;
+                }
+                // Smallest block that fits, else the largest one to grow.
+                if (best == NO_BLOCK) {
+                    best = b;
+                } else if (m_blocks[b].bytes >= bytes) {
+                    if (m_blocks[best].bytes < bytes || m_blocks[b].bytes < m_blocks[best].bytes) {
+                        best = b;
+                    }
+                } else if (m_blocks[best].bytes < bytes && m_blocks[b].bytes > m_blocks[best].bytes) {
+                    best = b;
+                }
+            }
+            if (best == NO_BLOCK) {
+                if (used == m_blocks.size()) {
+                    m_blocks.emplace_back();
+                }
+                best = static_cast<uint32_t>(used++);
+            }
+            Block& block = m_blocks[best];
+            block.bytes = std::max(block.bytes, bytes);
+            block.users = life.users;
+            m_resources[life.id].block = best;
+        }
+
+        m_blocks.resize(used);
+        for (Block& block : m_blocks) {
+            if (block.allocated < block.bytes) {
+                cl_int err = CL_SUCCESS;
+                block.buffer = cl::Buffer(m_ctx.getContext(), CL_MEM_READ_WRITE, block.bytes, nullptr, &err);
+                HWR_ASSERT_CL_OK(err, "FrameGraph::compile - transient allocation");
+                block.allocated = block.bytes;
+            }
+        }
+    }
+
+    void FrameGraph::execute() {
+        if (!m_compiled) {
+            HWR_FATAL("FrameGraph::execute - compile() the graph first");
+        }
+        static Histogram& frameLatency = metrics().histogram("frame_graph.execute.cpu_ms");
+        ScopedTimer frameTimer(frameLatency);
+
+        // Other queues must not start on this frame's memory while the
+        // default queue still runs the previous frame.
+        if (!m_joins.empty()) {
+            std::vector<cl::Event> start(1);
+            cl_int err = m_queues[0].enqueueMarkerWithWaitList(nullptr, &start[0]);
+            HWR_ASSERT_CL_OK(err, "FrameGraph::execute - start marker");
+            // Waits on another queue's event only progress once that
+            // queue has been flushed; the same goes for every marker below.
+            err = m_queues[0].flush();
+            HWR_ASSERT_CL_OK(err, "FrameGraph::execute - flush after start marker");
+            for (size_t q = 1; q < m_queues.size(); ++q) {
+                err = m_queues[q].enqueueBarrierWithWaitList(&start);
+                HWR_ASSERT_CL_OK(err, "FrameGraph::execute - start barrier");
+            }
+        }
+
+        for (uint32_t i : m_order) {
+            Pass& pass = m_passes[i];
+            const cl::CommandQueue& queue = m_queues[pass.queue];
+            if (!pass.waits.empty()) {
+                std::vector<cl::Event> events;
+                for (uint32_t w : pass.waits) {
+                    events.push_back(m_passes[w].done);
+                }
+                cl_int err = queue.enqueueBarrierWithWaitList(&events);
+                HWR_ASSERT_CL_OK(err, "FrameGraph::execute - barrier before " + pass.name);
+            }
+            ProfileScope scope(m_ctx, pass.name);
+            PassContext ctx(*this, queue);
+            {
+                ScopedTimer timer(*pass.latency);
+                pass.execute(ctx);
+            }
+            if (pass.signals) {
+                cl_int err = queue.enqueueMarkerWithWaitList(nullptr, &pass.done);
+                HWR_ASSERT_CL_OK(err, "FrameGraph::execute - marker after " + pass.name);
+                err = queue.flush();
+                HWR_ASSERT_CL_OK(err, "FrameGraph::execute - flush after " + pass.name);
+            }
+        }
+
+        if (!m_joins.empty()) {
+            std::vector<cl::Event> events;
+            for (uint32_t j : m_joins) {
+                events.push_back(m_passes[j].done);
+            }
+            for (size_t q = 1; q < m_queues.size(); ++q) {
+                cl_int err = m_queues[q].flush();
+                HWR_ASSERT_CL_OK(err, "FrameGraph::execute - flush");
+            }
+            cl_int err = m_queues[0].enqueueBarrierWithWaitList(&events);
+            HWR_ASSERT_CL_OK(err, "FrameGraph::execute - join");
+        }
+    }
+
+    void FrameGraph::reset() {
+        m_passes.clear();
+        m_resources.clear();
+        m_order.clear();
+        m_joins.clear();
+        m_compiled = false;
+    }
+
+    size_t FrameGraph::transientMemory() const {
+        size_t bytes = 0;
+        for (const Block& block : m_blocks) {
+            bytes += block.bytes;
+        }
+        return bytes;
+    }
+
+    std::vector<std::string> FrameGraph::scheduledPasses() const {
+        std::vector<std::string> names;
+        for (uint32_t i : m_order) {
+            names.push_back(m_passes[i].name);
+        }
+        return names;
+    }
+
+    uint32_t FrameGraph::passQueue(const std::string& name) const {
+        for (uint32_t i : m_order) {
+            if (m_passes[i].name == name) {
+                return m_passes[i].queue;
+            }
+        }
+        HWR_FATAL("FrameGraph::passQueue - no scheduled pass " + name);
+        return 0;
+    }
+
+    const FrameGraph::Resource& FrameGraph::resource(ResourceId id) const {
+        if (id >= m_resources.size()) {
+            HWR_FATAL("FrameGraph - unknown resource " + std::to_string(id));
+        }
+        return m_resources[id];
+    }
+
+    const cl::Buffer& FrameGraph::bufferOf(ResourceId id) const {
+        const Resource& res = resource(id);
+        if (res.imported) {
+            return res.buffer;
+        }
+        if (!m_compiled || res.block == NO_BLOCK) {
+            HWR_FATAL("FrameGraph - " + res.name + " has no memory, it is not used by a scheduled pass");
+        }
+        return m_blocks[res.block].buffer;
+    }
+
+} // namespace hwr
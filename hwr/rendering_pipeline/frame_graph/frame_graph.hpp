@@ -0,0 +1,155 @@
+#ifndef HWR_FRAME_GRAPH_HPP
+#define HWR_FRAME_GRAPH_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/context/gpu_context.hpp"
+#include "../../util/metrics/metrics.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace hwr {
+
+using ResourceId = uint32_t;
+
+class FrameGraph;
+
+// Handed to a pass's setup callback to declare what it touches.
+class PassBuilder {
+public:
+    void read(ResourceId id);
+    void write(ResourceId id);
+
+private:
+    friend class FrameGraph;
+    PassBuilder(FrameGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+    FrameGraph& m_graph;
+    uint32_t m_pass;
+};
+
+// Handed to a pass's execute callback. Work must be enqueued on queue(),
+// which may not be the context's default queue.
+class PassContext {
+public:
+    const cl::CommandQueue& queue() const { return m_queue; }
+    const cl::Buffer& buffer(ResourceId id) const;
+
+    // Typed view over a resource; the element count is bytes / sizeof(T).
+    template<typename T>
+    BufferView<T> view(ResourceId id) const;
+
+private:
+    friend class FrameGraph;
+    PassContext(const FrameGraph& graph, const cl::CommandQueue& queue)
+        : m_graph(graph), m_queue(queue) {}
+
+    const FrameGraph& m_graph;
+    const cl::CommandQueue& m_queue;
+};
+
+/**
+* \class FrameGraph
+* \brief Schedules passes from the buffers they declare to read and write.
+*
+* compile() derives dependencies in declaration order (read-after-write,
+* write-after-read, write-after-write), drops passes whose results are
+* never used, spreads independent passes over several in-order queues and
+* only places events where a pass waits on another queue. Transient
+* buffers whose lifetimes are ordered by those dependencies share memory.
+*
+* Imported buffers and passes that write nothing count as side effects
+* and are never dropped. Once compiled, execute() can run every frame;
+* adding passes or resources requires compiling again.
+*/
+class FrameGraph {
+public:
+    explicit FrameGraph(const GPUContext& ctx, uint32_t queueCount = 2);
+
+    ResourceId createTransient(const std::string& name, size_t bytes);
+    ResourceId importBuffer(const std::string& name, const cl::Buffer& buffer, size_t bytes);
+
+    void addPass(const std::string& name,
+                 const std::function<void(PassBuilder&)>& setup,
+                 std::function<void(PassContext&)> execute);
+
+    void compile();
+
+    // Runs the compiled passes. When it returns, everything is ordered
+    // before later work on the context's default queue.
+    void execute();
+
+    // Forgets passes and resources; transient memory is kept for reuse.
+    void reset();
+
+    // Device memory backing transient resources after aliasing.
+    size_t transientMemory() const;
+    // Passes left after culling, in execution order.
+    std::vector<std::string> scheduledPasses() const;
+    // Queue a pass was assigned to, 0 being the context's default queue.
+    uint32_t passQueue(const std::string& name) const;
+
+    const GPUContext& context() const { return m_ctx; }
+
+private:
+    friend class PassBuilder;
+    friend class PassContext;
+
+    struct Resource {
+        std::string name;
+        size_t bytes = 0;
+        bool imported = false;
+        cl::Buffer buffer;      // imported only
+        uint32_t block = 0;     // transient only
+        std::vector<uint32_t> users;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void(PassContext&)> execute;
+        Histogram* latency = nullptr; // host time spent in execute
+        std::vector<ResourceId> reads;
+        std::vector<ResourceId> writes;
+        std::vector<uint32_t> deps;
+        bool live = false;
+        uint32_t queue = 0;
+        std::vector<uint32_t> waits; // passes on other queues to wait for
+        bool signals = false;        // another queue waits for this pass
+        cl::Event done;
+    };
+
+    struct Block {
+        size_t bytes = 0;
+        size_t allocated = 0;
+        cl::Buffer buffer;
+        std::vector<uint32_t> users; // passes touching the current occupant
+    };
+
+    void buildDependencies();
+    void cullPasses();
+    void assignQueues(const std::vector<std::vector<bool>>& ancestors);
+    void aliasTransients(const std::vector<std::vector<bool>>& ancestors);
+    std::vector<std::vector<bool>> computeAncestors() const;
+
+    const Resource& resource(ResourceId id) const;
+    const cl::Buffer& bufferOf(ResourceId id) const;
+
+    const GPUContext& m_ctx;
+    std::vector<cl::CommandQueue> m_queues;
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_joins; // last pass of every other queue used
+    std::vector<Block> m_blocks;
+    bool m_compiled = false;
+};
+
+template<typename T>
+BufferView<T> PassContext::view(ResourceId id) const {
+    return BufferView<T>(m_graph.m_ctx, m_graph.bufferOf(id),
+                         m_graph.resource(id).bytes / sizeof(T));
+}
+
+} // namespace hwr
+
+#endif // HWR_FRAME_GRAPH_HPP
@@ -0,0 +1,144 @@
+#include "framebuffer.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace hwr {
+
+    namespace {
+
+        uint8_t toUnorm8(float v) {
+            return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+
+        // IEEE 754 binary32 -> binary16, round to nearest even.
+        uint16_t toHalf(float value) {
+            const auto bits = std::bit_cast<uint32_t>(value);
+            const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+            const uint32_t exponent = (bits >> 23) & 0xFFu;
+            uint32_t mantissa = bits & 0x7FFFFFu;
+
+            if (exponent == 0xFF) { // inf / nan
+                return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+            }
+            const int32_t e = static_cast<int32_t>(exponent) - 127 + 15;
+            if (e >= 0x1F) { // overflow
+                return static_cast<uint16_t>(sign | 0x7C00u);
+            }
+            if (e <= 0) { // subnormal or zero
+                if (e < -10) {
+                    return sign;
+                }
+                mantissa |= 0x800000u;
+                const auto shift = static_cast<uint32_t>(14 - e);
+                uint32_t half = mantissa >> shift;
+                const uint32_t rest = mantissa & ((1u << shift) - 1);
+                const uint32_t midpoint = 1u << (shift - 1);
+                if (rest > midpoint || (rest == midpoint && (half & 1u))) {
+                    ++half;
+                }
+                return static_cast<uint16_t>(sign | half);
+            }
+            uint32_t half = (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+            const uint32_t rest = mantissa & 0x1FFFu;
+            if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+                ++half; // may carry into the exponent, which is still correct
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        struct Float4Pattern { float v[4]; };
+
+    }
+
+    Framebuffer::Framebuffer(const GPUContext& ctx, const FramebufferDesc& desc)
+        : m_ctx(ctx)
+        , m_desc(desc)
+    {
+        if (desc.width == 0 || desc.height == 0) {
+            HWR_FATAL("Framebuffer - width and height must be non-zero");
+        }
+        cl_int err = CL_SUCCESS;
+        m_color = cl::Buffer(ctx.getContext(), CL_MEM_READ_WRITE, colorBytes(), nullptr, &err);
+        HWR_ASSERT_CL_OK(err, "Framebuffer - color attachment");
+        if (hasDepth()) {
+            m_depth = cl::Buffer(ctx.getContext(), CL_MEM_READ_WRITE, depthBytes(), nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "Framebuffer - depth attachment");
+        }
+    }
+
+    const cl::Buffer& Framebuffer::depth() const {
+        HWR_ASSERT(hasDepth(), "Framebuffer::depth - framebuffer has no depth attachment");
+        return m_depth;
+    }
+
+    void Framebuffer::clear(const std::array<float, 4>& rgba, float depth) {
+        cl::CommandQueue queue = m_ctx.getQueue();
+        cl_int err = CL_SUCCESS;
+        ProfiledCommand profiledColor(m_ctx, queue, "Framebuffer::clear color");
+        switch (m_desc.color) {
+            case ColorFormat::RGBA8: {
+                const uint32_t pattern = uint32_t{toUnorm8(rgba[0])}
+                                       | uint32_t{toUnorm8(rgba[1])} << 8
+                                       | uint32_t{toUnorm8(rgba[2])} << 16
+                                       | uint32_t{toUnorm8(rgba[3])} << 24;
+                err = queue.enqueueFillBuffer(m_color, pattern, 0, colorBytes(), nullptr, profiledColor.event());
+                break;
+            }
+            case ColorFormat::RGBA16F: {
+                const uint64_t pattern = uint64_t{toHalf(rgba[0])}
+                                       | uint64_t{toHalf(rgba[1])} << 16
+                                       | uint64_t{toHalf(rgba[2])} << 32
+                                       | uint64_t{toHalf(rgba[3])} << 48;
+                err = queue.enqueueFillBuffer(m_color, pattern, 0, colorBytes(), nullptr, profiledColor.event());
+                break;
+            }
+            case ColorFormat::RGBA32F: {
+                const Float4Pattern pattern{{rgba[0], rgba[1], rgba[2], rgba[3]}};
+                err = queue.enqueueFillBuffer(m_color, pattern, 0, colorBytes(), nullptr, profiledColor.event());
+                break;
+            }
+        }
+        HWR_ASSERT_CL_OK(err, "Framebuffer::clear - color");
+        if (hasDepth()) {
+            ProfiledCommand profiledDepth(m_ctx, queue, "Framebuffer::clear depth");
+            err = queue.enqueueFillBuffer(m_depth, depth, 0, depthBytes(), nullptr, profiledDepth.event());
+            HWR_ASSERT_CL_OK(err, "Framebuffer::clear - depth");
+        }
+    }
+
+    namespace detail {
+
+        const char* colorPointerType(ColorFormat format) {
+            switch (format) {
+                case ColorFormat::RGBA8:   return "__global uchar4*";
+                case ColorFormat::RGBA16F: return "__global half*";
+                case ColorFormat::RGBA32F: return "__global float4*";
+            }
+            return "";
+        }
+
+        const char* colorLoad(ColorFormat format) {
+            switch (format) {
+                case ColorFormat::RGBA8:   return "(convert_float4(hwr_target[hwr_pixel]) / 255.0f)";
+                case ColorFormat::RGBA16F: return "vload_half4(hwr_pixel, hwr_target)";
+                case ColorFormat::RGBA32F: return "hwr_target[hwr_pixel]";
+            }
+            return "";
+        }
+
+        const char* colorStore(ColorFormat format) {
+            switch (format) {
+                case ColorFormat::RGBA8:
+                    return "hwr_target[hwr_pixel] = convert_uchar4_sat_rte(hwr_color * 255.0f);\n";
+                case ColorFormat::RGBA16F:
+                    return "vstore_half4(hwr_color, hwr_pixel, hwr_target);\n";
+                case ColorFormat::RGBA32F:
+                    return "hwr_target[hwr_pixel] = hwr_color;\n";
+            }
+            return "";
+        }
+
+    } // namespace detail
+
+} // namespace hwr
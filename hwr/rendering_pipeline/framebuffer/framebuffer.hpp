@@ -0,0 +1,87 @@
+#ifndef HWR_FRAMEBUFFER_HPP
+#define HWR_FRAMEBUFFER_HPP
+
+#include "../gpu/context/gpu_context.hpp"
+#include "../../util/log/log.hpp"
+#include <array>
+#include <cstdint>
+
+namespace hwr {
+
+enum class ColorFormat {
+    RGBA8,    // 4 x unorm8, r in the lowest byte
+    RGBA16F,  // 4 x half
+    RGBA32F,  // 4 x float
+};
+
+enum class DepthFormat {
+    NONE,
+    FLOAT32,
+};
+
+constexpr size_t bytesPerPixel(ColorFormat format) {
+    switch (format) {
+        case ColorFormat::RGBA8:   return 4;
+        case ColorFormat::RGBA16F: return 8;
+        case ColorFormat::RGBA32F: return 16;
+    }
+    return 0;
+}
+
+constexpr size_t bytesPerPixel(DepthFormat format) {
+    return format == DepthFormat::FLOAT32 ? 4 : 0;
+}
+
+struct FramebufferDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ColorFormat color = ColorFormat::RGBA8;
+    DepthFormat depth = DepthFormat::FLOAT32;
+};
+
+namespace detail {
+
+    // For kernels that access a color attachment: the OpenCL C type of the
+    // hwr_target parameter, the float4 expression reading index hwr_pixel,
+    // and the statement storing float4 hwr_color there.
+    const char* colorPointerType(ColorFormat format);
+    const char* colorLoad(ColorFormat format);
+    const char* colorStore(ColorFormat format);
+
+} // namespace detail
+
+/**
+* \class Framebuffer
+* \brief Color (+ optional depth) attachments as linear device buffers,
+*        row-major, no padding between rows.
+*/
+class Framebuffer {
+public:
+    Framebuffer(const GPUContext& ctx, const FramebufferDesc& desc);
+
+    uint32_t width() const { return m_desc.width; }
+    uint32_t height() const { return m_desc.height; }
+    size_t pixelCount() const { return size_t{m_desc.width} * m_desc.height; }
+    const FramebufferDesc& desc() const { return m_desc; }
+
+    bool hasDepth() const { return m_desc.depth != DepthFormat::NONE; }
+    size_t colorBytes() const { return pixelCount() * bytesPerPixel(m_desc.color); }
+    size_t depthBytes() const { return pixelCount() * bytesPerPixel(m_desc.depth); }
+
+    // Pass these to kernels.
+    const cl::Buffer& color() const { return m_color; }
+    const cl::Buffer& depth() const;
+
+    /// Enqueues a clear of both attachments on the context's queue.
+    void clear(const std::array<float, 4>& rgba = {0, 0, 0, 1}, float depth = 1.0f);
+
+private:
+    const GPUContext& m_ctx;
+    FramebufferDesc m_desc;
+    cl::Buffer m_color;
+    cl::Buffer m_depth;
+};
+
+} // namespace hwr
+
+#endif // HWR_FRAMEBUFFER_HPP
@@ -0,0 +1,222 @@
+#include "readback.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+
+namespace hwr {
+
+    namespace {
+
+        cl::Buffer makePinned(const GPUContext& ctx, size_t bytes, std::byte*& mapped) {
+            cl_int err = CL_SUCCESS;
+            cl::Buffer buffer(ctx.getContext(),
+                              CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                              bytes, nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "FramebufferReadback - pinned buffer");
+            mapped = static_cast<std::byte*>(ctx.getQueue().enqueueMapBuffer(
+                buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes,
+                nullptr, nullptr, &err
+            ));
+            HWR_ASSERT_CL_OK(err, "FramebufferReadback - map pinned buffer");
+            return buffer;
+        }
+
+        cl::Buffer makeStaging(const GPUContext& ctx, size_t bytes) {
+            cl_int err = CL_SUCCESS;
+            cl::Buffer buffer(ctx.getContext(),
+                              CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
+                              bytes, nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "FramebufferReadback - staging buffer");
+            return buffer;
+        }
+
+    }
+
+    FramebufferReadback::FramebufferReadback(const GPUContext& ctx, const Framebuffer& fb,
+                                             Callback onFrame, uint32_t slotCount,
+                                             bool readDepth, ThreadPool* postProcess)
+        : m_ctx(ctx)
+        , m_fb(fb)
+        , m_onFrame(std::move(onFrame))
+        , m_readDepth(readDepth && fb.hasDepth())
+        , m_pool(postProcess)
+        , m_queue(ctx.createQueue())
+        , m_slots(std::max<uint32_t>(slotCount, 1))
+    {
+        if (readDepth && !fb.hasDepth()) {
+            HWR_ERR("FramebufferReadback - depth requested but framebuffer has none");
+        }
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            Slot& s = m_slots[i];
+            s.stagingColor = makeStaging(ctx, fb.colorBytes());
+            s.pinnedColor = makePinned(ctx, fb.colorBytes(), s.pinnedColorPtr);
+            if (m_readDepth) {
+                s.stagingDepth = makeStaging(ctx, fb.depthBytes());
+                s.pinnedDepth = makePinned(ctx, fb.depthBytes(), s.pinnedDepthPtr);
+            }
+            m_free.push_back(m_slots.size() - 1 - i); // hand out slot 0 first
+        }
+    }
+
+    FramebufferReadback::~FramebufferReadback() {
+        // Callback jobs still read the pinned memory.
+        while (!m_postProcessing.empty()) {
+            reclaim(true);
+        }
+        m_queue.finish();
+        cl::CommandQueue queue = m_ctx.getQueue();
+        for (Slot& s : m_slots) {
+            queue.enqueueUnmapMemObject(s.pinnedColor, s.pinnedColorPtr);
+            if (s.pinnedDepthPtr) {
+                queue.enqueueUnmapMemObject(s.pinnedDepth, s.pinnedDepthPtr);
+            }
+        }
+        queue.finish();
+    }
+
+    size_t FramebufferReadback::acquireSlot() {
+        poll();
+        // Every slot busy: these are the only waits.
+        while (m_free.empty()) {
+            if (!m_postProcessing.empty()) {
+                reclaim(true);
+            } else {
+                deliverOldest();
+            }
+        }
+        const size_t slot = m_free.back();
+        m_free.pop_back();
+        return slot;
+    }
+
+    uint64_t FramebufferReadback::capture() {
+        const size_t slot = acquireSlot();
+        Slot& s = m_slots[slot];
+        s.dstColor = { s.pinnedColorPtr, m_fb.colorBytes() };
+        s.dstDepth = m_readDepth ? std::span<std::byte>(s.pinnedDepthPtr, m_fb.depthBytes())
+                                 : std::span<std::byte>();
+        return enqueue(slot);
+    }
+
+    uint64_t FramebufferReadback::capture(std::span<std::byte> color, std::span<std::byte> depth) {
+        if (color.size() < m_fb.colorBytes()
+            || (m_readDepth && depth.size() < m_fb.depthBytes())) {
+            HWR_FATAL("FramebufferReadback::capture - destination too small");
+        }
+        const size_t slot = acquireSlot();
+        Slot& s = m_slots[slot];
+        s.dstColor = color.first(m_fb.colorBytes());
+        s.dstDepth = m_readDepth ? depth.first(m_fb.depthBytes()) : std::span<std::byte>();
+        return enqueue(slot);
+    }
+
+    uint64_t FramebufferReadback::enqueue(size_t slot) {
+        Slot& s = m_slots[slot];
+        s.frameIndex = m_nextFrame++;
+
+        // Snapshot on the main queue: ordered after the frame's rendering
+        // and before whatever renders into the framebuffer next.
+        cl::CommandQueue mainQueue = m_ctx.getQueue();
+        std::vector<cl::Event> snapshot(1);
+        cl_int err = mainQueue.enqueueCopyBuffer(
+            m_fb.color(), s.stagingColor, 0, 0, m_fb.colorBytes(), nullptr, &snapshot[0]
+        );
+        HWR_ASSERT_CL_OK(err, "FramebufferReadback - color snapshot");
+        GPUProfiler* profiler = m_ctx.profiler();
+        if (profiler) {
+            profiler->record("FramebufferReadback color snapshot", mainQueue(), snapshot[0]);
+        }
+        if (m_readDepth) {
+            snapshot.emplace_back();
+            err = mainQueue.enqueueCopyBuffer(
+                m_fb.depth(), s.stagingDepth, 0, 0, m_fb.depthBytes(), nullptr, &snapshot[1]
+            );
+            HWR_ASSERT_CL_OK(err, "FramebufferReadback - depth snapshot");
+            if (profiler) {
+                profiler->record("FramebufferReadback depth snapshot", mainQueue(), snapshot[1]);
+            }
+        }
+        mainQueue.flush();
+
+        // The transfer itself overlaps with the next frame.
+        err = m_queue.enqueueReadBuffer(
+            s.stagingColor, CL_FALSE, 0, s.dstColor.size(), s.dstColor.data(),
+            &snapshot, &s.done
+        );
+        HWR_ASSERT_CL_OK(err, "FramebufferReadback - color read");
+        if (profiler) {
+            profiler->record("FramebufferReadback color read", m_queue(), s.done);
+        }
+        if (m_readDepth) {
+            err = m_queue.enqueueReadBuffer(
+                s.stagingDepth, CL_FALSE, 0, s.dstDepth.size(), s.dstDepth.data(),
+                &snapshot, &s.done
+            );
+            HWR_ASSERT_CL_OK(err, "FramebufferReadback - depth read");
+            if (profiler) {
+                profiler->record("FramebufferReadback depth read", m_queue(), s.done);
+            }
+        }
+        m_queue.flush();
+
+        m_inFlight.push_back(slot);
+        return s.frameIndex;
+    }
+
+    void FramebufferReadback::deliverOldest() {
+        const size_t slot = m_inFlight.front();
+        m_inFlight.pop_front();
+        Slot& s = m_slots[slot];
+        // In-order queue: the last read of the slot finishing means all did.
+        cl_int err = s.done.wait();
+        HWR_ASSERT_CL_OK(err, "FramebufferReadback - wait for transfer");
+        if (m_pool && m_onFrame) {
+            m_pool->submit([this, &s] {
+                m_onFrame(ReadbackFrame{ s.frameIndex, s.dstColor, s.dstDepth });
+            }, s.postProcessing);
+            m_postProcessing.push_back(slot);
+            return;
+        }
+        if (m_onFrame) {
+            m_onFrame(ReadbackFrame{ s.frameIndex, s.dstColor, s.dstDepth });
+        }
+        m_free.push_back(slot);
+    }
+
+    void FramebufferReadback::reclaim(bool wait) {
+        if (wait && !m_postProcessing.empty()) {
+            // Runs other jobs meanwhile, possibly this slot's callback.
+            m_pool->wait(m_slots[m_postProcessing.front()].postProcessing);
+        }
+        for (auto it = m_postProcessing.begin(); it != m_postProcessing.end();) {
+            JobCounter& callback = m_slots[*it].postProcessing;
+            if (!callback.done()) {
+                ++it;
+                continue;
+            }
+            // Returns at once; makes sure the job is done with the counter.
+            m_pool->wait(callback);
+            m_free.push_back(*it);
+            it = m_postProcessing.erase(it);
+        }
+    }
+
+    void FramebufferReadback::poll() {
+        while (!m_inFlight.empty()) {
+            const Slot& s = m_slots[m_inFlight.front()];
+            if (s.done.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() != CL_COMPLETE) {
+                break;
+            }
+            deliverOldest();
+        }
+        reclaim(false);
+    }
+
+    void FramebufferReadback::flush() {
+        while (!m_inFlight.empty()) {
+            deliverOldest();
+        }
+        while (!m_postProcessing.empty()) {
+            reclaim(true);
+        }
+    }
+
+} // namespace hwr
@@ -0,0 +1,102 @@
+#ifndef HWR_READBACK_HPP
+#define HWR_READBACK_HPP
+
+#include "./framebuffer.hpp"
+#include "../../util/jobs/thread_pool.hpp"
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+struct ReadbackFrame {
+    uint64_t frameIndex;
+    std::span<const std::byte> color;
+    std::span<const std::byte> depth; // empty unless depth is read back
+};
+
+/**
+* \class FramebufferReadback
+* \brief Asynchronous, N-buffered copy of a Framebuffer into host memory.
+*
+* capture() snapshots the framebuffer with a device-side copy on the main
+* queue, so rendering of the next frame can start right away, then reads
+* the snapshot on a queue of its own into pinned host memory. Finished
+* frames are handed to the callback, in order, from capture() or flush()
+* on the calling thread. The spans are only valid during the callback.
+*
+* Given a ThreadPool, each finished frame is post-processed by a job of
+* its own instead: callbacks then run concurrently and in any order, and
+* the slot of a frame is reused once its callback has returned.
+*
+* capture() only waits if all slots are still in flight. Frames not
+* delivered by flush() before destruction are dropped.
+*/
+class FramebufferReadback {
+public:
+    using Callback = std::function<void(const ReadbackFrame&)>;
+
+    FramebufferReadback(const GPUContext& ctx, const Framebuffer& fb,
+                        Callback onFrame, uint32_t slotCount = 3,
+                        bool readDepth = false, ThreadPool* postProcess = nullptr);
+
+    FramebufferReadback(const FramebufferReadback&) = delete;
+    FramebufferReadback& operator=(const FramebufferReadback&) = delete;
+    ~FramebufferReadback();
+
+    /// Snapshots the framebuffer once all work already enqueued on the
+    /// main queue is done. Returns the frame index it will be delivered with.
+    uint64_t capture();
+
+    /// Same, but reads straight into caller memory (e.g. a mapped file)
+    /// instead of the pinned staging memory. The memory must stay valid
+    /// until the frame is delivered.
+    uint64_t capture(std::span<std::byte> color, std::span<std::byte> depth = {});
+
+    /// Delivers every frame whose transfer has already finished.
+    void poll();
+    /// Waits for and delivers every captured frame, and with a pool waits
+    /// for their callbacks to return.
+    void flush();
+
+    size_t framesInFlight() const { return m_inFlight.size(); }
+
+private:
+    struct Slot {
+        cl::Buffer stagingColor;  // device-side snapshot
+        cl::Buffer stagingDepth;
+        cl::Buffer pinnedColor;   // CL_MEM_ALLOC_HOST_PTR, mapped for good
+        cl::Buffer pinnedDepth;
+        std::byte* pinnedColorPtr = nullptr;
+        std::byte* pinnedDepthPtr = nullptr;
+        std::span<std::byte> dstColor;
+        std::span<std::byte> dstDepth;
+        cl::Event done;
+        uint64_t frameIndex = 0;
+        JobCounter postProcessing; // the callback job, with a pool
+    };
+
+    size_t acquireSlot();
+    uint64_t enqueue(size_t slot);
+    void deliverOldest();
+    // Frees the slots whose callback job has returned; with wait, the
+    // oldest one after waiting for it.
+    void reclaim(bool wait);
+
+    const GPUContext& m_ctx;
+    const Framebuffer& m_fb;
+    Callback m_onFrame;
+    bool m_readDepth;
+    ThreadPool* m_pool;
+    cl::CommandQueue m_queue;
+    std::vector<Slot> m_slots;
+    std::vector<size_t> m_free;
+    std::deque<size_t> m_inFlight;
+    std::deque<size_t> m_postProcessing;
+    uint64_t m_nextFrame = 0;
+};
+
+} // namespace hwr
+
+#endif // HWR_READBACK_HPP
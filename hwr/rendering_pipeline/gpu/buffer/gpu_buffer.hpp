@@ -2,7 +2,9 @@
 #define HWR_GPU_BUFFER_HPP
 
 #include "../context/gpu_context.hpp"
+#include "../profiling/gpu_profiler.hpp"
 #include "../../../util/log/log.hpp"
+#include "../../../util/metrics/metrics.hpp"
 #include <vector>
 #include <stdexcept>
 #include <type_traits>
@@ -11,6 +13,23 @@
 
 namespace hwr {
 
+namespace detail {
+    // Looked up once; the registry keeps them alive.
+    struct BufferMetrics {
+        Counter& allocations = metrics().counter("gpu.buffer.allocations");
+        Counter& allocatedBytes = metrics().counter("gpu.buffer.allocated_bytes");
+        Counter& uploadedBytes = metrics().counter("gpu.buffer.uploaded_bytes");
+        Counter& downloadedBytes = metrics().counter("gpu.buffer.downloaded_bytes");
+        Counter& maps = metrics().counter("gpu.mapped_buffer.maps");
+        Counter& unmaps = metrics().counter("gpu.mapped_buffer.unmaps");
+    };
+
+    inline BufferMetrics& bufferMetrics() {
+        static BufferMetrics m;
+        return m;
+    }
+}
+
 // Base class holds the common state.
 template<typename T>
 class BaseBuffer {
@@ -107,6 +126,8 @@ public:
             // OpenCL wants void* anyway.
             const_cast<void*>(static_cast<const void*>(hostPtr))
         );
+        detail::bufferMetrics().allocations.add();
+        detail::bufferMetrics().allocatedBytes.add(sizeof(T) * elementCount);
     }
 
     GeneralBuffer(const GPUContext& ctx, size_t elementCount, 
@@ -130,6 +151,8 @@ public:
         // OpenCL wants void* anyway.
         const_cast<void*>(static_cast<const void*>(hostPtr))
         );
+        detail::bufferMetrics().allocations.add();
+        detail::bufferMetrics().allocatedBytes.add(sizeof(T) * elementCount);
     }
 
     // copies data from a host vector to the device buffer.
@@ -140,18 +163,21 @@ public:
         if (data.size() != this->m_size) {
             HWR_FATAL("GeneralBuffer::writeFrom size mismatch");
         }
+        const cl::CommandQueue queue = this->m_ctx.getQueue();
+        ProfiledCommand profiled(this->m_ctx, queue, "GeneralBuffer::writeFrom");
+        detail::bufferMetrics().uploadedBytes.add(sizeof(T) * this->m_size);
         #ifndef NDEBUG
-            cl_int err = this->m_ctx.getQueue().enqueueWriteBuffer(
+            cl_int err = queue.enqueueWriteBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                data.data()
+                data.data(), nullptr, profiled.event()
             );
             HWR_ASSERT_CL_OK(err, "GeneralBuffer::writeFrom");
         #else // to prevent warning about unused err
-            this->m_ctx.getQueue().enqueueWriteBuffer(
+            queue.enqueueWriteBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                data.data()
+                data.data(), nullptr, profiled.event()
             );
         #endif
     }
@@ -164,18 +190,52 @@ public:
         if (data.size() != this->m_size) {
             HWR_FATAL("GeneralBuffer::writeFrom(span) size mismatch");
         }
+        const cl::CommandQueue queue = this->m_ctx.getQueue();
+        ProfiledCommand profiled(this->m_ctx, queue, "GeneralBuffer::writeFrom(span)");
+        detail::bufferMetrics().uploadedBytes.add(sizeof(T) * this->m_size);
         #ifndef NDEBUG
-            cl_int err = this->m_ctx.getQueue().enqueueWriteBuffer(
+            cl_int err = queue.enqueueWriteBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                data.data()
+                data.data(), nullptr, profiled.event()
             );
             HWR_ASSERT_CL_OK(err, "GeneralBuffer::writeFrom(span)");
         #else
-            this->m_ctx.getQueue().enqueueWriteBuffer(
+            queue.enqueueWriteBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                data.data()
+                data.data(), nullptr, profiled.event()
+            );
+        #endif
+    }
+
+    // copies data into elements [offset, offset + data.size()), leaving
+    // the rest of the buffer as it is.
+    void writeFrom(std::span<const T> data, size_t offset) {
+        static_assert(has_flag<BufferFlag::HOST_WRITE, Flags...>(),
+                    "writeFrom(span, offset) called, but BufferFlag::HOST_WRITE not set.");
+
+        if (offset > this->m_size || data.size() > this->m_size - offset) {
+            HWR_FATAL("GeneralBuffer::writeFrom(span, offset) out of range");
+        }
+        if (data.empty()) {
+            return;
+        }
+        const cl::CommandQueue queue = this->m_ctx.getQueue();
+        ProfiledCommand profiled(this->m_ctx, queue, "GeneralBuffer::writeFrom(span, offset)");
+        detail::bufferMetrics().uploadedBytes.add(sizeof(T) * data.size());
+        #ifndef NDEBUG
+            cl_int err = queue.enqueueWriteBuffer(
+                this->m_buffer, CL_TRUE, sizeof(T) * offset,
+                sizeof(T) * data.size(),
+                data.data(), nullptr, profiled.event()
+            );
+            HWR_ASSERT_CL_OK(err, "GeneralBuffer::writeFrom(span, offset)");
+        #else
+            queue.enqueueWriteBuffer(
+                this->m_buffer, CL_TRUE, sizeof(T) * offset,
+                sizeof(T) * data.size(),
+                data.data(), nullptr, profiled.event()
             );
         #endif
     }
@@ -186,18 +246,21 @@ public:
                       "readTo() called, but BufferFlag::HOST_READ not set.");
 
         out.resize(this->m_size);
+        const cl::CommandQueue queue = this->m_ctx.getQueue();
+        ProfiledCommand profiled(this->m_ctx, queue, "GeneralBuffer::readTo");
+        detail::bufferMetrics().downloadedBytes.add(sizeof(T) * this->m_size);
         #ifndef NDEBUG
-            cl_int err = this->m_ctx.getQueue().enqueueReadBuffer(
+            cl_int err = queue.enqueueReadBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                out.data()
+                out.data(), nullptr, profiled.event()
             );
             HWR_ASSERT_CL_OK(err, "GeneralBuffer::readTo");
         #else
-            this->m_ctx.getQueue().enqueueReadBuffer(
+            queue.enqueueReadBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                out.data()
+                out.data(), nullptr, profiled.event()
             );
         #endif
     }
@@ -209,18 +272,21 @@ public:
         if (out.size() != this->m_size) {
             HWR_FATAL("GeneralBuffer::readTo(span) size mismatch");
         }
+        const cl::CommandQueue queue = this->m_ctx.getQueue();
+        ProfiledCommand profiled(this->m_ctx, queue, "GeneralBuffer::readTo(span)");
+        detail::bufferMetrics().downloadedBytes.add(sizeof(T) * this->m_size);
         #ifndef NDEBUG
-            cl_int err = this->m_ctx.getQueue().enqueueReadBuffer(
+            cl_int err = queue.enqueueReadBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                out.data()
+                out.data(), nullptr, profiled.event()
             );
             HWR_ASSERT_CL_OK(err, "GeneralBuffer::readTo(span)");
         #else
-            this->m_ctx.getQueue().enqueueReadBuffer(
+            queue.enqueueReadBuffer(
                 this->m_buffer, CL_TRUE, 0,
                 sizeof(T) * this->m_size,
-                out.data()
+                out.data(), nullptr, profiled.event()
             );
         #endif
     }
@@ -251,6 +317,18 @@ template<typename T>
 using HostProducedAndReadBuffer = GeneralBuffer<T, HOST_READ, HOST_WRITE, GPU_READ>;
 
 
+// Typed handle to a cl::Buffer created elsewhere (e.g. by a streamer).
+// cl::Buffer is reference counted, so the view keeps the memory alive.
+template<typename T>
+class BufferView : public BaseBuffer<T> {
+public:
+    BufferView(const GPUContext& ctx, const cl::Buffer& buffer, size_t elementCount)
+        : BaseBuffer<T>(ctx, elementCount)
+    {
+        this->m_buffer = buffer;
+    }
+};
+
 template<typename T>
 class HostMappedBuffer; // Forward declaration
 
@@ -319,6 +397,8 @@ public:
             CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
             sizeof(T) * count
         );
+        detail::bufferMetrics().allocations.add();
+        detail::bufferMetrics().allocatedBytes.add(sizeof(T) * count);
     }
 
     MappedPtr<T> map(cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE) {
@@ -333,6 +413,7 @@ public:
             nullptr, nullptr, &err
         ));
         HWR_ASSERT_CL_OK(err, "HostMappedBuffer::map - enqueueMapBuffer");
+        detail::bufferMetrics().maps.add();
 
         MappedPtr<T> res(m_ptr, this);
         m_isMapped = true;
@@ -351,6 +432,7 @@ public:
             m_ptr = nullptr; 
             m_isMapped = false; // if user tries to use the pointer, they'll get error.
             HWR_ASSERT_CL_OK(err, "HostMappedBuffer::unmap - enqueueUnmapMemObject");
+            detail::bufferMetrics().unmaps.add();
         } else {
             HWR_ERR("Attempted to unmap an already unmapped buffer.");
         }
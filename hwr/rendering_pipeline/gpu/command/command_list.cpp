@@ -0,0 +1,223 @@
+#include "command_list.hpp"
+#include "../profiling/gpu_profiler.hpp"
+#include <CL/cl_ext.h>
+
+// The recording entry points took their current shape (a properties
+// argument on every command) in revision 0.9.5 of the extension.
+#if defined(cl_khr_command_buffer) && defined(CL_KHR_COMMAND_BUFFER_EXTENSION_VERSION)
+#if CL_KHR_COMMAND_BUFFER_EXTENSION_VERSION >= CL_MAKE_VERSION(0, 9, 5)
+#define HWR_HAS_KHR_COMMAND_BUFFER 1
+#endif
+#endif
+
+namespace hwr {
+
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+
+struct CommandList::NativeCommandBuffer {
+    clCreateCommandBufferKHR_fn createBuffer = nullptr;
+    clFinalizeCommandBufferKHR_fn finalizeBuffer = nullptr;
+    clReleaseCommandBufferKHR_fn releaseBuffer = nullptr;
+    clEnqueueCommandBufferKHR_fn enqueue = nullptr;
+    clCommandNDRangeKernelKHR_fn ndrange = nullptr;
+    clCommandCopyBufferKHR_fn copy = nullptr;
+    clCommandFillBufferKHR_fn fill = nullptr;
+
+    cl_command_buffer_khr buffer = nullptr;
+    cl::Event lastReplay;
+
+    static std::unique_ptr<NativeCommandBuffer> create(const GPUContext& ctx,
+                                                       cl::CommandQueue& queue);
+
+    ~NativeCommandBuffer() {
+        if (buffer) {
+            releaseBuffer(buffer);
+        }
+    }
+};
+
+namespace {
+
+    template<typename Fn>
+    bool loadEntryPoint(const GPUContext& ctx, const char* name, Fn& fn) {
+        fn = reinterpret_cast<Fn>(
+            clGetExtensionFunctionAddressForPlatform(ctx.getPlatform()(), name));
+        return fn != nullptr;
+    }
+
+}
+
+#else
+
+struct CommandList::NativeCommandBuffer {};
+
+#endif
+
+CommandList::CommandList(const GPUContext& ctx)
+    : CommandList(ctx, ctx.getQueue())
+{}
+
+CommandList::CommandList([[maybe_unused]] const GPUContext& ctx, const cl::CommandQueue& queue)
+    : m_queue(queue)
+    , m_profiler(ctx.profiler())
+{
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    const std::string extensions = ctx.getDevice().getInfo<CL_DEVICE_EXTENSIONS>();
+    if (extensions.find("cl_khr_command_buffer") != std::string::npos) {
+        m_native = NativeCommandBuffer::create(ctx, m_queue);
+    }
+#endif
+    if (!m_native) {
+        HWR_DEBUG_IN(LogModule::GPU, "CommandList - cl_khr_command_buffer unavailable, using host replay");
+    }
+}
+
+CommandList::~CommandList() = default;
+
+void CommandList::checkRecording(const char* what) const {
+    if (m_finalized) {
+        HWR_FATAL(std::string("CommandList::") + what + " - list is already finalized");
+    }
+}
+
+void CommandList::dispatch(const Kernel& kernel, const cl::NDRange& global, const cl::NDRange& local) {
+    checkRecording("dispatch");
+    // The snapshot keeps the arguments as they are now.
+    Command cmd{CommandKind::DISPATCH, kernel.snapshot(), global, local, {}, {}, 0, 0, 0, {}};
+
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    if (m_native) {
+        cl_int err = m_native->ndrange(m_native->buffer, nullptr, nullptr, cmd.kernel(),
+                                static_cast<cl_uint>(global.dimensions()), nullptr,
+                                global.get(), local.dimensions() > 0 ? local.get() : nullptr,
+                                0, nullptr, nullptr, nullptr);
+        HWR_ASSERT_CL_OK(err, "CommandList::dispatch - record " + kernel.name());
+    }
+#endif
+    m_commands.push_back(std::move(cmd));
+}
+
+void CommandList::copy(const cl::Buffer& src, const cl::Buffer& dst, size_t bytes,
+                       size_t srcOffset, size_t dstOffset)
+{
+    checkRecording("copy");
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    if (m_native) {
+        cl_int err = m_native->copy(m_native->buffer, nullptr, nullptr, src(), dst(),
+                                    srcOffset, dstOffset, bytes, 0, nullptr, nullptr, nullptr);
+        HWR_ASSERT_CL_OK(err, "CommandList::copy - record");
+    }
+#endif
+    m_commands.push_back({CommandKind::COPY, {}, {}, {}, src, dst, srcOffset, dstOffset, bytes, {}});
+}
+
+void CommandList::fillBytes(const cl::Buffer& buffer, std::vector<std::byte> pattern,
+                            size_t offset, size_t bytes)
+{
+    checkRecording("fill");
+    if (bytes % pattern.size() != 0 || offset % pattern.size() != 0) {
+        HWR_FATAL("CommandList::fill - offset and size must be multiples of the pattern size");
+    }
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    if (m_native) {
+        cl_int err = m_native->fill(m_native->buffer, nullptr, nullptr, buffer(),
+                                    pattern.data(), pattern.size(), offset, bytes,
+                                    0, nullptr, nullptr, nullptr);
+        HWR_ASSERT_CL_OK(err, "CommandList::fill - record");
+    }
+#endif
+    m_commands.push_back({CommandKind::FILL, {}, {}, {}, {}, buffer, 0, offset, bytes, std::move(pattern)});
+}
+
+void CommandList::finalize() {
+    checkRecording("finalize");
+    m_finalized = true;
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    if (m_native) {
+        cl_int err = m_native->finalizeBuffer(m_native->buffer);
+        if (err != CL_SUCCESS) {
+            HWR_ERR("CommandList::finalize - command buffer rejected (" + std::to_string(err)
+                    + "), using host replay");
+            m_native.reset();
+        }
+    }
+#endif
+}
+
+void CommandList::replay() {
+    if (!m_finalized) {
+        HWR_FATAL("CommandList::replay - finalize() the list first");
+    }
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+    if (m_native) {
+        // Without simultaneous use a command buffer may not be enqueued
+        // while its previous submission is still pending.
+        if (m_native->lastReplay() != nullptr
+            && m_native->lastReplay.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() != CL_COMPLETE) {
+            m_native->lastReplay.wait();
+        }
+        m_native->lastReplay = cl::Event();
+        cl_int err = m_native->enqueue(0, nullptr, m_native->buffer, 0, nullptr,
+                                       &m_native->lastReplay());
+        HWR_ASSERT_CL_OK(err, "CommandList::replay - enqueue command buffer");
+        if (m_profiler) {
+            m_profiler->record("CommandList::replay", m_queue(), m_native->lastReplay);
+        }
+        return;
+    }
+#endif
+    cl::Event profiled;
+    cl::Event* event = m_profiler ? &profiled : nullptr;
+    for (const Command& cmd : m_commands) {
+        cl_int err = CL_SUCCESS;
+        switch (cmd.kind) {
+            case CommandKind::DISPATCH:
+                err = m_queue.enqueueNDRangeKernel(cmd.kernel, cl::NullRange, cmd.global, cmd.local,
+                                                   nullptr, event);
+                break;
+            case CommandKind::COPY:
+                err = m_queue.enqueueCopyBuffer(cmd.src, cmd.dst, cmd.srcOffset, cmd.dstOffset, cmd.bytes,
+                                                nullptr, event);
+                break;
+            case CommandKind::FILL:
+                profiled = cl::Event();
+                err = clEnqueueFillBuffer(m_queue(), cmd.dst(), cmd.pattern.data(), cmd.pattern.size(),
+                                          cmd.dstOffset, cmd.bytes, 0, nullptr,
+                                          event ? &profiled() : nullptr);
+                break;
+        }
+        HWR_ASSERT_CL_OK(err, "CommandList::replay");
+        if (m_profiler) {
+            m_profiler->record("CommandList::replay", m_queue(), profiled);
+        }
+    }
+}
+
+#ifdef HWR_HAS_KHR_COMMAND_BUFFER
+
+std::unique_ptr<CommandList::NativeCommandBuffer>
+CommandList::NativeCommandBuffer::create(const GPUContext& ctx, cl::CommandQueue& queue) {
+    auto native = std::make_unique<NativeCommandBuffer>();
+    const bool loaded = loadEntryPoint(ctx, "clCreateCommandBufferKHR", native->createBuffer)
+        && loadEntryPoint(ctx, "clFinalizeCommandBufferKHR", native->finalizeBuffer)
+        && loadEntryPoint(ctx, "clReleaseCommandBufferKHR", native->releaseBuffer)
+        && loadEntryPoint(ctx, "clEnqueueCommandBufferKHR", native->enqueue)
+        && loadEntryPoint(ctx, "clCommandNDRangeKernelKHR", native->ndrange)
+        && loadEntryPoint(ctx, "clCommandCopyBufferKHR", native->copy)
+        && loadEntryPoint(ctx, "clCommandFillBufferKHR", native->fill);
+    if (!loaded) {
+        return nullptr;
+    }
+    cl_int err = CL_SUCCESS;
+    cl_command_queue handle = queue();
+    native->buffer = native->createBuffer(1, &handle, nullptr, &err);
+    if (err != CL_SUCCESS || native->buffer == nullptr) {
+        native->buffer = nullptr;
+        return nullptr;
+    }
+    return native;
+}
+
+#endif
+
+} // namespace hwr
@@ -0,0 +1,92 @@
+#ifndef HWR_COMMAND_LIST_HPP
+#define HWR_COMMAND_LIST_HPP
+
+#include "../context/gpu_context.hpp"
+#include "../kernel/kernel.hpp"
+#include "../../../util/log/log.hpp"
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace hwr {
+
+/**
+* \class CommandList
+* \brief Records a fixed sequence of dispatches and transfers once and
+*        replays it every frame.
+*
+* Kernel arguments are captured when a dispatch is recorded, so the kernel
+* can be reconfigured afterwards without affecting the list. When the
+* device exposes cl_khr_command_buffer the list is baked into a command
+* buffer and replay() is a single enqueue; otherwise it replays from a
+* flat array of pre-built commands with no argument setting.
+*
+* Commands run in recording order, like on an in-order queue.
+*/
+class CommandList {
+public:
+    explicit CommandList(const GPUContext& ctx);
+    CommandList(const GPUContext& ctx, const cl::CommandQueue& queue);
+    ~CommandList();
+
+    CommandList(const CommandList&) = delete;
+    CommandList& operator=(const CommandList&) = delete;
+
+    void dispatch(const Kernel& kernel,
+                  const cl::NDRange& global,
+                  const cl::NDRange& local = cl::NullRange);
+
+    void copy(const cl::Buffer& src, const cl::Buffer& dst, size_t bytes,
+              size_t srcOffset = 0, size_t dstOffset = 0);
+
+    template<typename T>
+    void fill(const cl::Buffer& buffer, const T& pattern, size_t offset, size_t bytes) {
+        static_assert(std::is_trivially_copyable_v<T>, "Fill pattern must be trivially copyable");
+        std::vector<std::byte> bytesOfPattern(sizeof(T));
+        std::memcpy(bytesOfPattern.data(), &pattern, sizeof(T));
+        fillBytes(buffer, std::move(bytesOfPattern), offset, bytes);
+    }
+
+    // Ends recording. Must be called once before replay().
+    void finalize();
+
+    void replay();
+
+    // True when replay() goes through a cl_khr_command_buffer.
+    bool isNative() const { return m_native != nullptr; }
+    size_t commandCount() const { return m_commands.size(); }
+
+private:
+    enum class CommandKind { DISPATCH, COPY, FILL };
+
+    struct Command {
+        CommandKind kind;
+        cl::Kernel kernel;          // DISPATCH, a snapshot holding the arguments
+        cl::NDRange global;
+        cl::NDRange local;
+        cl::Buffer src;             // COPY
+        cl::Buffer dst;             // COPY, FILL
+        size_t srcOffset = 0;
+        size_t dstOffset = 0;
+        size_t bytes = 0;
+        std::vector<std::byte> pattern; // FILL
+    };
+
+    struct NativeCommandBuffer; // cl_khr_command_buffer state, if available
+
+    void fillBytes(const cl::Buffer& buffer, std::vector<std::byte> pattern,
+                   size_t offset, size_t bytes);
+    void checkRecording(const char* what) const;
+
+    cl::CommandQueue m_queue;
+    GPUProfiler* m_profiler;
+    std::vector<Command> m_commands;
+    std::unique_ptr<NativeCommandBuffer> m_native;
+    bool m_finalized = false;
+};
+
+} // namespace hwr
+
+#endif // HWR_COMMAND_LIST_HPP
@@ -1,5 +1,6 @@
 #include "../../../util/log/log.hpp"
 #include "gpu_context.hpp"
+#include "../profiling/gpu_profiler.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -10,7 +11,7 @@
 
 namespace hwr{
 
-std::optional<GPUContext> initGPUContext()
+std::optional<GPUContext> initGPUContext(bool enableProfiling)
 {
     std::vector<cl::Platform> platforms;
     cl::Platform::get(&platforms);
@@ -40,7 +41,8 @@ std::optional<GPUContext> initGPUContext()
         return std::nullopt;
     }
 
-    cl::CommandQueue queue(context, device, 0, &err);
+    const cl_command_queue_properties props = enableProfiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+    cl::CommandQueue queue(context, device, props, &err);
     if(err != CL_SUCCESS)
     {
         HWR_ERR("Failed to create CommandQueue. Error code: " + std::to_string(err));
@@ -48,6 +50,9 @@ std::optional<GPUContext> initGPUContext()
     }
 
     GPUContext contextObj(platform, device, context, queue);
+    if (enableProfiling) {
+        contextObj.m_profiler = std::make_shared<GPUProfiler>();
+    }
     return contextObj;
 }
 
@@ -73,4 +78,15 @@ GPUContext::GPUContext(const cl::Platform&    platform,
     , m_queue(queue)
 {} 
 
+cl::CommandQueue GPUContext::createQueue(cl_command_queue_properties props) const
+{
+    cl_int err = CL_SUCCESS;
+    if (m_profiler) {
+        props |= CL_QUEUE_PROFILING_ENABLE;
+    }
+    cl::CommandQueue queue(m_context, m_device, props, &err);
+    HWR_ASSERT_CL_OK(err, "GPUContext::createQueue");
+    return queue;
+}
+
 } // namespace hwr
\ No newline at end of file
@@ -5,21 +5,25 @@
 #include <vector>
 #include <optional>
 #include <stdexcept>
+#include <memory>
 
 
 namespace hwr{
 
     // Forward declaration of GPUContext
     class GPUContext;
+    class GPUProfiler;
 
     /**
     * \brief Create and initialize a GPUContext.
     *
     * \param kernelSource The kernel source string you want to build into the program.
     * \param errorMsg If an error occurs, an error message is written to this string.
+    * \param enableProfiling Create queues with CL_QUEUE_PROFILING_ENABLE and
+    *        record an event for every kernel and transfer (see GPUProfiler).
     * \return A GPUContext if successful; otherwise, std::nullopt.
     */
-    std::optional<hwr::GPUContext> initGPUContext();
+    std::optional<hwr::GPUContext> initGPUContext(bool enableProfiling = false);
 
     /**
     * \class GPUContext
@@ -33,6 +37,14 @@ namespace hwr{
         cl::Context     getContext()  const  { return m_context;  }
         cl::CommandQueue getQueue()   const  { return m_queue;    }
 
+        /// Additional queue on the same device, for work that should
+        /// overlap with the main queue (uploads, readbacks...).
+        /// Profiling is added to props when the context profiles.
+        cl::CommandQueue createQueue(cl_command_queue_properties props = 0) const;
+
+        /// nullptr unless the context was created with profiling enabled.
+        GPUProfiler* profiler() const { return m_profiler.get(); }
+
     private:
         // Make constructor private so only friend (initGPUContext) can call it.
         GPUContext(const cl::Platform&    platform,
@@ -46,9 +58,11 @@ namespace hwr{
         cl::Context     m_context;
         cl::CommandQueue m_queue;
         cl::Program     m_program;
+        // Shared by copies of the context
+        std::shared_ptr<GPUProfiler> m_profiler;
 
         // Allow our free function to construct GPUContext
-        friend std::optional<GPUContext> initGPUContext();
+        friend std::optional<GPUContext> initGPUContext(bool enableProfiling);
     };
 
     std::string getFileContent(const std::string filename);
@@ -0,0 +1,157 @@
+#include "gpu_image.hpp"
+#include "../profiling/gpu_profiler.hpp"
+#include <algorithm>
+#include <array>
+
+namespace hwr {
+
+    size_t bytesPerTexel(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::R8:      return 1;
+            case TextureFormat::RG8:     return 2;
+            case TextureFormat::RGBA8:   return 4;
+            case TextureFormat::R16F:    return 2;
+            case TextureFormat::RGBA16F: return 8;
+            case TextureFormat::R32F:    return 4;
+            case TextureFormat::RGBA32F: return 16;
+        }
+        return 0;
+    }
+
+    cl::ImageFormat toCLImageFormat(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::R8:      return cl::ImageFormat(CL_R, CL_UNORM_INT8);
+            case TextureFormat::RG8:     return cl::ImageFormat(CL_RG, CL_UNORM_INT8);
+            case TextureFormat::RGBA8:   return cl::ImageFormat(CL_RGBA, CL_UNORM_INT8);
+            case TextureFormat::R16F:    return cl::ImageFormat(CL_R, CL_HALF_FLOAT);
+            case TextureFormat::RGBA16F: return cl::ImageFormat(CL_RGBA, CL_HALF_FLOAT);
+            case TextureFormat::R32F:    return cl::ImageFormat(CL_R, CL_FLOAT);
+            case TextureFormat::RGBA32F: return cl::ImageFormat(CL_RGBA, CL_FLOAT);
+        }
+        return cl::ImageFormat();
+    }
+
+    uint32_t fullMipCount(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+            ++levels;
+        }
+        return levels;
+    }
+
+    Texture2D::Texture2D(const GPUContext& ctx, uint32_t width, uint32_t height,
+                         TextureFormat format, uint32_t mipLevels)
+        : m_ctx(ctx)
+        , m_width(width)
+        , m_height(height)
+        , m_format(format)
+    {
+        if (width == 0 || height == 0) {
+            HWR_FATAL("Texture2D - width and height must be non-zero");
+        }
+        if (mipLevels == 0 || mipLevels > fullMipCount(width, height)) {
+            HWR_FATAL("Texture2D - invalid mip level count");
+        }
+        for (uint32_t level = 0; level < mipLevels; ++level) {
+            cl_int err = CL_SUCCESS;
+            m_levels.emplace_back(ctx.getContext(), CL_MEM_READ_WRITE,
+                                  toCLImageFormat(format),
+                                  this->width(level), this->height(level),
+                                  0, nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "Texture2D - level " + std::to_string(level));
+        }
+    }
+
+    void Texture2D::writeBytes(std::span<const std::byte> bytes, uint32_t level) {
+        if (level >= mipLevels() || bytes.size() != levelBytes(level)) {
+            HWR_FATAL("Texture2D::write - level or size mismatch");
+        }
+        const cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiled(m_ctx, queue, "Texture2D::write");
+        cl_int err = queue.enqueueWriteImage(
+            m_levels[level], CL_TRUE, {0, 0, 0}, {width(level), height(level), 1},
+            0, 0, bytes.data(), nullptr, profiled.event()
+        );
+        HWR_ASSERT_CL_OK(err, "Texture2D::write");
+    }
+
+    void Texture2D::readBytes(std::span<std::byte> bytes, uint32_t level) const {
+        if (level >= mipLevels() || bytes.size() != levelBytes(level)) {
+            HWR_FATAL("Texture2D::read - level or size mismatch");
+        }
+        const cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiled(m_ctx, queue, "Texture2D::read");
+        cl_int err = queue.enqueueReadImage(
+            m_levels[level], CL_TRUE, {0, 0, 0}, {width(level), height(level), 1},
+            0, 0, bytes.data(), nullptr, profiled.event()
+        );
+        HWR_ASSERT_CL_OK(err, "Texture2D::read");
+    }
+
+    Texture2DArray::Texture2DArray(const GPUContext& ctx, uint32_t width, uint32_t height,
+                                   uint32_t layers, TextureFormat format)
+        : m_ctx(ctx)
+        , m_width(width)
+        , m_height(height)
+        , m_layers(layers)
+        , m_format(format)
+    {
+        if (width == 0 || height == 0 || layers == 0) {
+            HWR_FATAL("Texture2DArray - width, height and layers must be non-zero");
+        }
+        cl_int err = CL_SUCCESS;
+        m_image = cl::Image2DArray(ctx.getContext(), CL_MEM_READ_WRITE,
+                                   toCLImageFormat(format), layers, width, height,
+                                   0, 0, nullptr, &err);
+        HWR_ASSERT_CL_OK(err, "Texture2DArray - allocation");
+    }
+
+    void Texture2DArray::writeBytes(std::span<const std::byte> bytes, uint32_t layer) {
+        if (layer >= m_layers || bytes.size() != layerBytes()) {
+            HWR_FATAL("Texture2DArray::write - layer or size mismatch");
+        }
+        const cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiled(m_ctx, queue, "Texture2DArray::write");
+        cl_int err = queue.enqueueWriteImage(
+            m_image, CL_TRUE, {0, 0, layer}, {m_width, m_height, 1},
+            0, 0, bytes.data(), nullptr, profiled.event()
+        );
+        HWR_ASSERT_CL_OK(err, "Texture2DArray::write");
+    }
+
+    void Texture2DArray::readBytes(std::span<std::byte> bytes, uint32_t layer) const {
+        if (layer >= m_layers || bytes.size() != layerBytes()) {
+            HWR_FATAL("Texture2DArray::read - layer or size mismatch");
+        }
+        const cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiled(m_ctx, queue, "Texture2DArray::read");
+        cl_int err = queue.enqueueReadImage(
+            m_image, CL_TRUE, {0, 0, layer}, {m_width, m_height, 1},
+            0, 0, bytes.data(), nullptr, profiled.event()
+        );
+        HWR_ASSERT_CL_OK(err, "Texture2DArray::read");
+    }
+
+    Sampler::Sampler(const GPUContext& ctx, FilterMode filter,
+                     AddressMode address, bool normalizedCoords)
+    {
+        cl_addressing_mode clAddress = CL_ADDRESS_CLAMP_TO_EDGE;
+        switch (address) {
+            case AddressMode::CLAMP_TO_EDGE:   clAddress = CL_ADDRESS_CLAMP_TO_EDGE; break;
+            case AddressMode::CLAMP:           clAddress = CL_ADDRESS_CLAMP; break;
+            case AddressMode::REPEAT:          clAddress = CL_ADDRESS_REPEAT; break;
+            case AddressMode::MIRRORED_REPEAT: clAddress = CL_ADDRESS_MIRRORED_REPEAT; break;
+        }
+        if (!normalizedCoords
+            && (address == AddressMode::REPEAT || address == AddressMode::MIRRORED_REPEAT)) {
+            HWR_FATAL("Sampler - repeat modes need normalized coordinates");
+        }
+        cl_int err = CL_SUCCESS;
+        m_sampler = cl::Sampler(ctx.getContext(), normalizedCoords ? CL_TRUE : CL_FALSE,
+                                clAddress,
+                                filter == FilterMode::LINEAR ? CL_FILTER_LINEAR : CL_FILTER_NEAREST,
+                                &err);
+        HWR_ASSERT_CL_OK(err, "Sampler - creation");
+    }
+
+} // namespace hwr
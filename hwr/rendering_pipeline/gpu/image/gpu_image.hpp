@@ -0,0 +1,145 @@
+#ifndef HWR_GPU_IMAGE_HPP
+#define HWR_GPU_IMAGE_HPP
+
+#include "../context/gpu_context.hpp"
+#include "../../../util/log/log.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+enum class TextureFormat {
+    R8,       // unorm
+    RG8,      // unorm
+    RGBA8,    // unorm
+    R16F,
+    RGBA16F,
+    R32F,
+    RGBA32F,
+};
+
+size_t bytesPerTexel(TextureFormat format);
+cl::ImageFormat toCLImageFormat(TextureFormat format);
+
+// Number of levels in a full mip chain down to 1x1.
+uint32_t fullMipCount(uint32_t width, uint32_t height);
+
+/**
+* \class Texture2D
+* \brief 2D image with an optional mip chain.
+*
+* Mipmapped OpenCL images (cl_khr_mipmap_image) are rarely supported, so
+* each level is an image of its own; bind level(i) to sample a specific
+* one. Host transfers are blocking, like GeneralBuffer's, and expect
+* tightly packed rows.
+*/
+class Texture2D {
+public:
+    Texture2D(const GPUContext& ctx, uint32_t width, uint32_t height,
+              TextureFormat format, uint32_t mipLevels = 1);
+
+    uint32_t width(uint32_t level = 0) const { return std::max(m_width >> level, 1u); }
+    uint32_t height(uint32_t level = 0) const { return std::max(m_height >> level, 1u); }
+    uint32_t mipLevels() const { return static_cast<uint32_t>(m_levels.size()); }
+    TextureFormat format() const { return m_format; }
+    size_t levelBytes(uint32_t level) const {
+        return size_t{width(level)} * height(level) * bytesPerTexel(m_format);
+    }
+
+    const cl::Image2D& level(uint32_t level) const { return m_levels.at(level); }
+    // Level 0, for Kernel::setArg().
+    const cl::Image2D& getCLImage() const { return m_levels.front(); }
+
+    template<typename T>
+    void write(std::span<const T> texels, uint32_t level = 0) {
+        writeBytes(std::as_bytes(texels), level);
+    }
+
+    template<typename T>
+    void read(std::span<T> out, uint32_t level = 0) const {
+        readBytes(std::as_writable_bytes(out), level);
+    }
+
+private:
+    void writeBytes(std::span<const std::byte> bytes, uint32_t level);
+    void readBytes(std::span<std::byte> bytes, uint32_t level) const;
+
+    const GPUContext& m_ctx;
+    uint32_t m_width;
+    uint32_t m_height;
+    TextureFormat m_format;
+    std::vector<cl::Image2D> m_levels;
+};
+
+/**
+* \class Texture2DArray
+* \brief Layers of equally sized 2D images, sampled with a layer index.
+*/
+class Texture2DArray {
+public:
+    Texture2DArray(const GPUContext& ctx, uint32_t width, uint32_t height,
+                   uint32_t layers, TextureFormat format);
+
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    uint32_t layers() const { return m_layers; }
+    TextureFormat format() const { return m_format; }
+    size_t layerBytes() const { return size_t{m_width} * m_height * bytesPerTexel(m_format); }
+
+    const cl::Image2DArray& getCLImage() const { return m_image; }
+
+    template<typename T>
+    void write(std::span<const T> texels, uint32_t layer) {
+        writeBytes(std::as_bytes(texels), layer);
+    }
+
+    template<typename T>
+    void read(std::span<T> out, uint32_t layer) const {
+        readBytes(std::as_writable_bytes(out), layer);
+    }
+
+private:
+    void writeBytes(std::span<const std::byte> bytes, uint32_t layer);
+    void readBytes(std::span<std::byte> bytes, uint32_t layer) const;
+
+    const GPUContext& m_ctx;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_layers;
+    TextureFormat m_format;
+    cl::Image2DArray m_image;
+};
+
+enum class AddressMode {
+    CLAMP_TO_EDGE,
+    CLAMP,           // outside reads give the border color
+    REPEAT,          // normalized coordinates only
+    MIRRORED_REPEAT, // normalized coordinates only
+};
+
+enum class FilterMode {
+    NEAREST,
+    LINEAR,
+};
+
+/**
+* \class Sampler
+* \brief Host-created sampler, bound to a DSL hwr::sampler() parameter.
+*/
+class Sampler {
+public:
+    Sampler(const GPUContext& ctx,
+            FilterMode filter = FilterMode::LINEAR,
+            AddressMode address = AddressMode::REPEAT,
+            bool normalizedCoords = true);
+
+    const cl::Sampler& getCLSampler() const { return m_sampler; }
+
+private:
+    cl::Sampler m_sampler;
+};
+
+} // namespace hwr
+
+#endif // HWR_GPU_IMAGE_HPP
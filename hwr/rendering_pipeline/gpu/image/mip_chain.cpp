@@ -0,0 +1,42 @@
+#include "mip_chain.hpp"
+
+namespace hwr {
+
+    namespace {
+
+        const char* MIP_DOWNSAMPLE_SOURCE = R"CLC(
+__kernel void hwr_mip_downsample(read_only image2d_t src, write_only image2d_t dst)
+{
+    const int2 dstSize = get_image_dim(dst);
+    const int x = (int)get_global_id(0);
+    const int y = (int)get_global_id(1);
+    if (x >= dstSize.x || y >= dstSize.y) return;
+
+    const int2 last = get_image_dim(src) - (int2)(1, 1);
+    const int x0 = min(2 * x, last.x);
+    const int y0 = min(2 * y, last.y);
+    const int x1 = min(2 * x + 1, last.x);
+    const int y1 = min(2 * y + 1, last.y);
+    const float4 sum = read_imagef(src, (int2)(x0, y0)) + read_imagef(src, (int2)(x1, y0))
+                     + read_imagef(src, (int2)(x0, y1)) + read_imagef(src, (int2)(x1, y1));
+    write_imagef(dst, (int2)(x, y), sum * 0.25f);
+}
+)CLC";
+
+    }
+
+    MipGenerator::MipGenerator(const GPUContext& ctx)
+        : m_kernel(ctx, MIP_DOWNSAMPLE_SOURCE, "hwr_mip_downsample")
+    {}
+
+    void MipGenerator::generate(Texture2D& texture, uint32_t firstLevel) {
+        if (firstLevel >= texture.mipLevels()) {
+            HWR_FATAL("MipGenerator::generate - first level out of range");
+        }
+        for (uint32_t level = firstLevel + 1; level < texture.mipLevels(); ++level) {
+            m_kernel.setArgs(texture.level(level - 1), texture.level(level));
+            m_kernel.dispatch(cl::NDRange(texture.width(level), texture.height(level)));
+        }
+    }
+
+} // namespace hwr
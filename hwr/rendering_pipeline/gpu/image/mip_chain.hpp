@@ -0,0 +1,30 @@
+#ifndef HWR_MIP_CHAIN_HPP
+#define HWR_MIP_CHAIN_HPP
+
+#include "gpu_image.hpp"
+#include "../kernel/kernel.hpp"
+
+namespace hwr {
+
+/**
+* \class MipGenerator
+* \brief Builds a texture's mip chain on the device from its top level.
+*
+* Each level is a 2x2 box filter of the previous one, one dispatch per
+* level. For odd sizes the last row/column is clamped rather than
+* weighted, which is the usual cheap approximation.
+*/
+class MipGenerator {
+public:
+    explicit MipGenerator(const GPUContext& ctx);
+
+    // Rebuilds levels firstLevel + 1 .. mipLevels() - 1 from firstLevel.
+    void generate(Texture2D& texture, uint32_t firstLevel = 0);
+
+private:
+    Kernel m_kernel;
+};
+
+} // namespace hwr
+
+#endif // HWR_MIP_CHAIN_HPP
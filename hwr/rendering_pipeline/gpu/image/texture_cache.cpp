@@ -0,0 +1,178 @@
+#include "texture_cache.hpp"
+#include "../../../util/metrics/metrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace hwr {
+
+    namespace {
+
+        struct CacheMetrics {
+            Counter& hits = metrics().counter("texture_cache.hits");
+            Counter& misses = metrics().counter("texture_cache.misses");
+            Counter& evictions = metrics().counter("texture_cache.evictions");
+            Counter& uploadedBytes = metrics().counter("texture_cache.uploaded_bytes");
+            Gauge& residentBytes = metrics().gauge("texture_cache.resident_bytes");
+        };
+
+        CacheMetrics& cacheMetrics() {
+            static CacheMetrics m;
+            return m;
+        }
+
+    }
+
+    size_t mipChainBytes(uint32_t width, uint32_t height, TextureFormat format, uint32_t level) {
+        size_t bytes = 0;
+        for (uint32_t l = level; l < fullMipCount(width, height); ++l) {
+            bytes += size_t{std::max(width >> l, 1u)} * std::max(height >> l, 1u);
+        }
+        return bytes * bytesPerTexel(format);
+    }
+
+    uint32_t mipLevelForFootprint(uint32_t width, uint32_t height,
+                                  float screenWidth, float screenHeight) {
+        const float ratio = std::max(static_cast<float>(width) / std::max(screenWidth, 1.0f),
+                                     static_cast<float>(height) / std::max(screenHeight, 1.0f));
+        if (ratio <= 1.0f) {
+            return 0;
+        }
+        const auto level = static_cast<uint32_t>(std::floor(std::log2(ratio)));
+        return std::min(level, fullMipCount(width, height) - 1);
+    }
+
+    TextureCache::TextureCache(const GPUContext& ctx, size_t budgetBytes)
+        : m_ctx(ctx)
+        , m_mips(ctx)
+        , m_budget(budgetBytes)
+    {}
+
+    TextureId TextureCache::add(TextureSource source) {
+        if (source.width == 0 || source.height == 0 || !source.load) {
+            HWR_FATAL("TextureCache::add - source needs a size and a loader");
+        }
+        Entry entry;
+        entry.source = std::move(source);
+        entry.residentLevel = fullMipCount(entry.source.width, entry.source.height);
+        entry.lru = m_lru.end();
+        m_entries.push_back(std::move(entry));
+        return static_cast<TextureId>(m_entries.size() - 1);
+    }
+
+    const Texture2D& TextureCache::request(TextureId id, uint32_t level) {
+        Entry& entry = m_entries.at(id);
+        const uint32_t levels = fullMipCount(entry.source.width, entry.source.height);
+        level = std::min(level, levels - 1);
+
+        if (!entry.texture || entry.residentLevel > level) {
+            const size_t current = entry.bytes;
+            while (level + 1 < levels) {
+                const size_t needed = mipChainBytes(entry.source.width, entry.source.height,
+                                                    entry.source.format, level);
+                if (needed <= current || makeRoom(needed - current, id)) {
+                    break;
+                }
+                ++level;
+            }
+            // The coarsest level is always served, even over budget.
+            if (!entry.texture || entry.residentLevel > level) {
+                cacheMetrics().misses.add();
+                upload(id, level);
+            } else {
+                cacheMetrics().hits.add();
+            }
+        } else {
+            cacheMetrics().hits.add();
+        }
+        touch(id);
+        return *entry.texture;
+    }
+
+    void TextureCache::evict(TextureId id) {
+        Entry& entry = m_entries.at(id);
+        if (!entry.texture) {
+            return;
+        }
+        m_residentBytes -= entry.bytes;
+        cacheMetrics().evictions.add();
+        cacheMetrics().residentBytes.add(-static_cast<int64_t>(entry.bytes));
+        entry.texture.reset();
+        entry.bytes = 0;
+        entry.residentLevel = fullMipCount(entry.source.width, entry.source.height);
+        m_lru.erase(entry.lru);
+        entry.lru = m_lru.end();
+    }
+
+    void TextureCache::setBudget(size_t budgetBytes) {
+        m_budget = budgetBytes;
+        while (m_residentBytes > m_budget && !m_lru.empty()
+               && m_entries[m_lru.back()].lastFrame != m_frame) {
+            evict(m_lru.back());
+        }
+    }
+
+    bool TextureCache::makeRoom(size_t needed, TextureId keep) {
+        if (m_budget >= m_residentBytes && m_budget - m_residentBytes >= needed) {
+            return true;
+        }
+        // Only evict if it is going to be enough; otherwise the caller
+        // tries a coarser level first.
+        size_t reclaimable = 0;
+        for (TextureId id : m_lru) {
+            if (id != keep && m_entries[id].lastFrame != m_frame) {
+                reclaimable += m_entries[id].bytes;
+            }
+        }
+        if (m_residentBytes - reclaimable + needed > m_budget) {
+            return false;
+        }
+        for (auto it = m_lru.end(); m_residentBytes + needed > m_budget;) {
+            --it;
+            const TextureId id = *it;
+            if (id == keep || m_entries[id].lastFrame == m_frame) {
+                continue;
+            }
+            // Erase-safe: step past the entry before evict() unlinks it.
+            ++it;
+            evict(id);
+        }
+        return true;
+    }
+
+    void TextureCache::touch(TextureId id) {
+        Entry& entry = m_entries[id];
+        entry.lastFrame = m_frame;
+        if (entry.lru != m_lru.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+        } else {
+            m_lru.push_front(id);
+            entry.lru = m_lru.begin();
+        }
+    }
+
+    void TextureCache::upload(TextureId id, uint32_t level) {
+        Entry& entry = m_entries[id];
+        const TextureSource& src = entry.source;
+        const uint32_t width = std::max(src.width >> level, 1u);
+        const uint32_t height = std::max(src.height >> level, 1u);
+
+        std::vector<std::byte> texels(size_t{width} * height * bytesPerTexel(src.format));
+        src.load(level, texels);
+
+        Texture2D texture(m_ctx, width, height, src.format, fullMipCount(width, height));
+        texture.write(std::span<const std::byte>(texels));
+        m_mips.generate(texture);
+
+        cacheMetrics().uploadedBytes.add(texels.size());
+        cacheMetrics().residentBytes.add(-static_cast<int64_t>(entry.bytes));
+
+        m_residentBytes -= entry.bytes;
+        entry.texture.emplace(std::move(texture));
+        entry.residentLevel = level;
+        entry.bytes = mipChainBytes(src.width, src.height, src.format, level);
+        m_residentBytes += entry.bytes;
+        cacheMetrics().residentBytes.add(static_cast<int64_t>(entry.bytes));
+    }
+
+} // namespace hwr
@@ -0,0 +1,93 @@
+#ifndef HWR_TEXTURE_CACHE_HPP
+#define HWR_TEXTURE_CACHE_HPP
+
+#include "gpu_image.hpp"
+#include "mip_chain.hpp"
+#include <functional>
+#include <list>
+#include <optional>
+
+namespace hwr {
+
+using TextureId = uint32_t;
+
+// Host-side description of a streamable texture. load() fills one level,
+// tightly packed, and is only called for the finest level made resident;
+// coarser levels are generated on the device.
+struct TextureSource {
+    uint32_t width;
+    uint32_t height;
+    TextureFormat format;
+    std::function<void(uint32_t level, std::span<std::byte> out)> load;
+};
+
+// Bytes of a mip chain from level down to 1x1.
+size_t mipChainBytes(uint32_t width, uint32_t height, TextureFormat format, uint32_t level = 0);
+
+// Finest level worth having when the texture covers about
+// screenWidth x screenHeight pixels (one texel per pixel).
+uint32_t mipLevelForFootprint(uint32_t width, uint32_t height,
+                              float screenWidth, float screenHeight);
+
+/**
+* \class TextureCache
+* \brief Keeps the needed mip levels of many textures under a device memory
+*        budget.
+*
+* Each resident texture holds its chain from the finest requested level
+* down to 1x1. Asking for a finer level re-uploads only that level and
+* regenerates the rest on the device. When the budget is exceeded, least
+* recently used textures not requested in the current frame are evicted;
+* if that is still not enough, the request is served at a coarser level.
+*/
+class TextureCache {
+public:
+    TextureCache(const GPUContext& ctx, size_t budgetBytes);
+
+    TextureId add(TextureSource source);
+
+    // Marks the start of a frame; textures requested from now on are
+    // protected from eviction until the next call.
+    void beginFrame() { ++m_frame; }
+
+    // Makes level (or a finer one already resident, or a coarser one under
+    // memory pressure) resident and returns the texture to bind.
+    const Texture2D& request(TextureId id, uint32_t level);
+
+    bool isResident(TextureId id) const { return m_entries.at(id).texture.has_value(); }
+    // Finest resident level of id, which is level 0 of the returned texture.
+    uint32_t residentLevel(TextureId id) const { return m_entries.at(id).residentLevel; }
+
+    void evict(TextureId id);
+    void setBudget(size_t budgetBytes);
+
+    size_t budget() const { return m_budget; }
+    size_t residentBytes() const { return m_residentBytes; }
+
+private:
+    struct Entry {
+        TextureSource source;
+        std::optional<Texture2D> texture;
+        uint32_t residentLevel = 0;
+        size_t bytes = 0;
+        uint64_t lastFrame = 0;
+        std::list<TextureId>::iterator lru;
+    };
+
+    // Evicts LRU textures other than keep until `needed` more bytes fit.
+    bool makeRoom(size_t needed, TextureId keep);
+    void touch(TextureId id);
+    void upload(TextureId id, uint32_t level);
+
+    const GPUContext& m_ctx;
+    MipGenerator m_mips;
+    std::vector<Entry> m_entries;
+    std::list<TextureId> m_lru; // front = most recently used, resident only
+    size_t m_budget;
+    size_t m_residentBytes = 0;
+    uint64_t m_frame = 1;
+};
+
+} // namespace hwr
+
+#endif // HWR_TEXTURE_CACHE_HPP
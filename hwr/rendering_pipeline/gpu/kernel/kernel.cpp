@@ -0,0 +1,97 @@
+#include "kernel.hpp"
+#include "../profiling/gpu_profiler.hpp"
+#include "../../../util/metrics/metrics.hpp"
+#include <cstdio>
+
+namespace hwr {
+
+Kernel::Kernel(const GPUContext& ctx,
+               const std::string& source,
+               const std::string& entryPoint)
+    : m_ctx(ctx)
+    , m_name(entryPoint)
+{
+    static Counter& builds = metrics().counter("gpu.kernel.builds");
+    static Histogram& buildLatency = metrics().histogram("gpu.kernel.build_ms");
+    builds.add();
+
+    cl_int err = CL_SUCCESS;
+    m_program = cl::Program(ctx.getContext(), source, false, &err);
+    HWR_ASSERT_CL_OK(err, "Kernel - cl::Program for " + m_name);
+
+    {
+        ScopedTimer timer(buildLatency);
+        err = m_program.build({ ctx.getDevice() });
+    }
+    if (err != CL_SUCCESS) {
+        HWR_ERR_IN(LogModule::GPU, "Build log of {}:\n{}", m_name,
+                   m_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(ctx.getDevice()));
+        HWR_DEBUG_IN(LogModule::GPU, "Source of {}:\n{}", m_name, source);
+        HWR_FATAL("Kernel - failed to build " + m_name);
+    }
+
+    m_kernel = cl::Kernel(m_program, m_name.c_str(), &err);
+    HWR_ASSERT_CL_OK(err, "Kernel - cl::Kernel for " + m_name);
+}
+
+void Kernel::declareParams(cl_uint firstIndex, const std::vector<std::string>& names) {
+    m_params.clear();
+    for (const std::string& name : names) {
+        m_params.emplace_back(name, firstIndex++);
+    }
+}
+
+namespace {
+
+    // clCloneKernel is OpenCL 2.1. CL_DEVICE_VERSION reads
+    // "OpenCL <major>.<minor> <vendor-specific information>".
+    bool canCloneKernels(const cl::Device& device) {
+        const std::string version = device.getInfo<CL_DEVICE_VERSION>();
+        int major = 0;
+        int minor = 0;
+        if (std::sscanf(version.c_str(), "OpenCL %d.%d", &major, &minor) != 2) {
+            return false;
+        }
+        return major > 2 || (major == 2 && minor >= 1);
+    }
+
+}
+
+cl::Kernel Kernel::snapshot() const {
+    cl_int err = CL_SUCCESS;
+    if (canCloneKernels(m_ctx.getDevice())) {
+        cl::Kernel source = m_kernel;
+        cl::Kernel copy = source.clone();
+        if (copy() == nullptr) {
+            HWR_FATAL("Kernel::snapshot - could not clone " + m_name);
+        }
+        return copy;
+    }
+    cl::Kernel copy(m_program, m_name.c_str(), &err);
+    HWR_ASSERT_CL_OK(err, "Kernel::snapshot - cl::Kernel for " + m_name);
+    for (size_t i = 0; i < m_args.size(); ++i) {
+        const ArgValue& arg = m_args[i];
+        if (arg.size == 0) {
+            continue; // never set, left for the enqueue to report
+        }
+        err = copy.setArg(static_cast<cl_uint>(i), arg.size,
+                          arg.value.empty() ? nullptr : arg.value.data());
+        HWR_ASSERT_CL_OK(err, "Kernel::snapshot - argument of " + m_name);
+    }
+    return copy;
+}
+
+void Kernel::dispatch(const cl::NDRange& global, const cl::NDRange& local) {
+    dispatch(m_ctx.getQueue(), global, local);
+}
+
+void Kernel::dispatch(const cl::CommandQueue& queue,
+                      const cl::NDRange& global, const cl::NDRange& local) {
+    ProfiledCommand profiled(m_ctx, queue, m_name);
+    cl_int err = queue.enqueueNDRangeKernel(
+        m_kernel, cl::NullRange, global, local, nullptr, profiled.event()
+    );
+    HWR_ASSERT_CL_OK(err, "Kernel::dispatch - " + m_name);
+}
+
+} // namespace hwr
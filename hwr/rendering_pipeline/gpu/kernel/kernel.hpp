@@ -0,0 +1,133 @@
+#ifndef HWR_KERNEL_HPP
+#define HWR_KERNEL_HPP
+
+#include "../context/gpu_context.hpp"
+#include "../../../util/log/log.hpp"
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace hwr {
+
+/**
+* \class Kernel
+* \brief A single OpenCL kernel built from source, bound to a GPUContext.
+*
+* Buffers, images and samplers (anything exposing getCLBuffer(),
+* getCLImage() or getCLSampler()) can be passed to setArg() directly,
+* everything else is forwarded to cl::Kernel::setArg().
+*/
+class Kernel {
+public:
+    Kernel(const GPUContext& ctx,
+           const std::string& source,
+           const std::string& entryPoint);
+
+    template<typename T>
+    void setArg(cl_uint index, const T& value) {
+        cl_int err;
+        if constexpr (requires { value.getCLBuffer(); }) {
+            err = bindArg(index, value.getCLBuffer());
+        } else if constexpr (requires { value.getCLImage(); }) {
+            err = bindArg(index, value.getCLImage());
+        } else if constexpr (requires { value.getCLSampler(); }) {
+            err = bindArg(index, value.getCLSampler());
+        } else {
+            err = bindArg(index, value);
+        }
+        HWR_ASSERT_CL_OK(err, "Kernel::setArg - " + m_name);
+    }
+
+    // Sets arguments 0..N-1 in order.
+    template<typename... Args>
+    void setArgs(const Args&... args) {
+        cl_uint index = 0;
+        (setArg(index++, args), ...);
+    }
+
+    // Names the trailing arguments, starting at firstIndex, so they can be
+    // set by name (e.g. textures declared inside a shader body).
+    void declareParams(cl_uint firstIndex, const std::vector<std::string>& names);
+
+    // An SoABuffer sets one parameter per column, name_field.
+    template<typename T>
+    void setParam(const std::string& name, const T& value) {
+        if constexpr (requires { value.columnCount(); value.columnName(0); value.column(0); }) {
+            for (size_t i = 0; i < value.columnCount(); ++i) {
+                setParam(name + "_" + value.columnName(i), value.column(i));
+            }
+        } else {
+            for (const auto& [paramName, index] : m_params) {
+                if (paramName == name) {
+                    setArg(index, value);
+                    return;
+                }
+            }
+            HWR_FATAL("Kernel::setParam - " + m_name + " has no parameter " + name);
+        }
+    }
+
+    void dispatch(const cl::NDRange& global,
+                  const cl::NDRange& local = cl::NullRange);
+
+    // Same, on a queue other than the context's (e.g. a FrameGraph pass queue).
+    void dispatch(const cl::CommandQueue& queue,
+                  const cl::NDRange& global,
+                  const cl::NDRange& local = cl::NullRange);
+
+    const std::string& name() const { return m_name; }
+    const cl::Kernel& getCLKernel() const { return m_kernel; }
+
+    // A separate cl::Kernel with the arguments set so far; setArg() calls
+    // made afterwards do not affect it. Cloned where the device has
+    // clCloneKernel (OpenCL 2.1), else created anew from the program with
+    // the recorded arguments applied.
+    cl::Kernel snapshot() const;
+
+private:
+    // Last value set for an argument, as passed to clSetKernelArg.
+    struct ArgValue {
+        size_t size = 0;
+        std::vector<std::byte> value; // empty for __local arrays
+    };
+
+    template<typename A>
+    cl_int bindArg(cl_uint index, const A& arg) {
+        const cl_int err = m_kernel.setArg(index, arg);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+        if (m_args.size() <= index) {
+            m_args.resize(index + 1);
+        }
+        ArgValue& recorded = m_args[index];
+        if constexpr (std::is_same_v<A, cl::LocalSpaceArg>) {
+            recorded.size = arg.size_;
+            recorded.value.clear();
+        } else if constexpr (std::is_base_of_v<cl::Memory, A> || std::is_same_v<A, cl::Sampler>) {
+            const auto handle = arg();
+            recorded.size = sizeof(handle);
+            recorded.value.resize(sizeof(handle));
+            std::memcpy(recorded.value.data(), &handle, sizeof(handle));
+        } else {
+            static_assert(std::is_trivially_copyable_v<A>, "Kernel arguments must be trivially copyable");
+            recorded.size = sizeof(A);
+            recorded.value.resize(sizeof(A));
+            std::memcpy(recorded.value.data(), &arg, sizeof(A));
+        }
+        return err;
+    }
+
+    const GPUContext& m_ctx;
+    std::string m_name;
+    cl::Program m_program;
+    cl::Kernel m_kernel;
+    std::vector<std::pair<std::string, cl_uint>> m_params;
+    std::vector<ArgValue> m_args;
+};
+
+} // namespace hwr
+
+#endif // HWR_KERNEL_HPP
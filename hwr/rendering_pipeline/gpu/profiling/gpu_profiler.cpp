@@ -0,0 +1,191 @@
+#include "gpu_profiler.hpp"
+#include "../../../util/log/log.hpp"
+#include "../../../util/json/json.hpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <utility>
+
+namespace hwr {
+
+    namespace {
+
+        double toMs(cl_ulong ns) { return static_cast<double>(ns) * 1e-6; }
+        double toUs(cl_ulong ns) { return static_cast<double>(ns) * 1e-3; }
+
+        // Open ProfileScopes of this thread, of every profiler, innermost last.
+        thread_local std::vector<std::pair<const GPUProfiler*, std::string>> tl_scopes;
+
+    }
+
+    void GPUProfiler::record(std::string_view name, cl_command_queue queue, const cl::Event& event) {
+        std::string pass;
+        for (auto it = tl_scopes.rbegin(); it != tl_scopes.rend(); ++it) {
+            if (it->first == this) {
+                pass = it->second;
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back({
+            std::string(name),
+            std::move(pass),
+            queueIndex(queue),
+            m_frame,
+            event
+        });
+    }
+
+    void GPUProfiler::pushScope(std::string_view name) {
+        tl_scopes.emplace_back(this, std::string(name));
+    }
+
+    void GPUProfiler::popScope() {
+        for (auto it = tl_scopes.rbegin(); it != tl_scopes.rend(); ++it) {
+            if (it->first == this) {
+                tl_scopes.erase(std::next(it).base());
+                return;
+            }
+        }
+        HWR_ASSERT(false, "GPUProfiler::popScope - no open scope on this thread");
+    }
+
+    void GPUProfiler::beginFrame() {
+        collect();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_frame;
+    }
+
+    void GPUProfiler::collect(bool waitAll) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Keeps the commands still queued or running; negative statuses
+        // are errors and final.
+        auto done = std::stable_partition(m_pending.begin(), m_pending.end(), [&](const Pending& p) {
+            if (waitAll) {
+                p.event.wait();
+                return false;
+            }
+            const cl_int status = p.event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+            return status != CL_COMPLETE && status >= 0;
+        });
+        for (auto it = done; it != m_pending.end(); ++it) {
+            const cl_int status = it->event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+            if (status < 0) {
+                HWR_ERR_IN(LogModule::GPU, "GPUProfiler::collect - {} failed with status {}", it->name, status);
+                continue;
+            }
+            cl_int err = CL_SUCCESS;
+            ProfileSample sample{it->name, it->pass, it->queue, it->frame, 0, 0, 0, 0};
+            sample.queued = it->event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>(&err);
+            if (err == CL_SUCCESS) sample.submit = it->event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>(&err);
+            if (err == CL_SUCCESS) sample.start = it->event.getProfilingInfo<CL_PROFILING_COMMAND_START>(&err);
+            if (err == CL_SUCCESS) sample.end = it->event.getProfilingInfo<CL_PROFILING_COMMAND_END>(&err);
+            if (err != CL_SUCCESS) {
+                // e.g. a queue created without CL_QUEUE_PROFILING_ENABLE
+                HWR_DEBUG_IN(LogModule::GPU, "GPUProfiler::collect - no profiling info for {}", it->name);
+                continue;
+            }
+            m_samples.push_back(std::move(sample));
+        }
+        m_pending.erase(done, m_pending.end());
+        while (m_samples.size() > m_maxSamples) {
+            m_samples.pop_front();
+        }
+    }
+
+    std::vector<ProfileSample> GPUProfiler::samples() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return {m_samples.begin(), m_samples.end()};
+    }
+
+    std::vector<ProfileStats> GPUProfiler::groupBy(std::string ProfileSample::* key) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::string, ProfileStats> groups;
+        for (const ProfileSample& s : m_samples) {
+            const double ms = toMs(s.end - s.start);
+            ProfileStats& stats = groups[s.*key];
+            if (stats.count == 0) {
+                stats.name = s.*key;
+                stats.minMs = ms;
+                stats.maxMs = ms;
+            }
+            ++stats.count;
+            stats.totalMs += ms;
+            stats.minMs = std::min(stats.minMs, ms);
+            stats.maxMs = std::max(stats.maxMs, ms);
+        }
+        std::vector<ProfileStats> res;
+        for (auto& [name, stats] : groups) {
+            res.push_back(std::move(stats));
+        }
+        std::sort(res.begin(), res.end(), [](const ProfileStats& a, const ProfileStats& b) {
+            return a.totalMs > b.totalMs;
+        });
+        return res;
+    }
+
+    std::vector<ProfileStats> GPUProfiler::passStats() const {
+        return groupBy(&ProfileSample::pass);
+    }
+
+    std::vector<ProfileStats> GPUProfiler::commandStats() const {
+        return groupBy(&ProfileSample::name);
+    }
+
+    bool GPUProfiler::exportChromeTrace(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            HWR_ERR("GPUProfiler::exportChromeTrace - cannot open " + path);
+            return false;
+        }
+
+        cl_ulong origin = std::numeric_limits<cl_ulong>::max();
+        for (const ProfileSample& s : m_samples) {
+            origin = std::min(origin, s.queued);
+        }
+
+        out << std::fixed;
+        out.precision(3);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        for (uint32_t q = 0; q < m_queues.size(); ++q) {
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << q
+                << ",\"args\":{\"name\":\"queue " << q << "\"}}";
+            first = false;
+        }
+        for (const ProfileSample& s : m_samples) {
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"" << jsonEscape(s.name) << "\""
+                << ",\"cat\":\"" << jsonEscape(s.pass.empty() ? std::string("gpu") : s.pass) << "\""
+                << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << s.queue
+                << ",\"ts\":" << toUs(s.start - origin)
+                << ",\"dur\":" << toUs(s.end - s.start)
+                << ",\"args\":{\"frame\":" << s.frame
+                << ",\"queued_to_submit_us\":" << toUs(s.submit - s.queued)
+                << ",\"submit_to_start_us\":" << toUs(s.start - s.submit) << "}}";
+            first = false;
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+    void GPUProfiler::clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.clear();
+        m_samples.clear();
+    }
+
+    uint32_t GPUProfiler::queueIndex(cl_command_queue queue) {
+        for (uint32_t i = 0; i < m_queues.size(); ++i) {
+            if (m_queues[i] == queue) {
+                return i;
+            }
+        }
+        m_queues.push_back(queue);
+        return static_cast<uint32_t>(m_queues.size() - 1);
+    }
+
+} // namespace hwr
@@ -0,0 +1,151 @@
+#ifndef HWR_GPU_PROFILER_HPP
+#define HWR_GPU_PROFILER_HPP
+
+#include "../context/gpu_context.hpp"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hwr {
+
+// One finished command. Times are device nanoseconds.
+struct ProfileSample {
+    std::string name;   // kernel or transfer
+    std::string pass;   // innermost ProfileScope, empty outside any
+    uint32_t queue;     // order in which the profiler first saw the queue
+    uint64_t frame;
+    cl_ulong queued;
+    cl_ulong submit;
+    cl_ulong start;
+    cl_ulong end;
+};
+
+struct ProfileStats {
+    std::string name;
+    uint64_t count = 0;
+    double totalMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+
+    double averageMs() const { return count ? totalMs / static_cast<double>(count) : 0.0; }
+};
+
+/**
+* \class GPUProfiler
+* \brief Collects per-command OpenCL profiling info of a profiling
+*        GPUContext.
+*
+* Every kernel and transfer issued through hwr records its event here.
+* Events are resolved lazily by collect() (called from beginFrame()), so
+* recording never stalls the host. Only the newest maxSamples samples are
+* kept.
+*/
+class GPUProfiler {
+public:
+    explicit GPUProfiler(size_t maxSamples = 1 << 16) : m_maxSamples(maxSamples) {}
+
+    void record(std::string_view name, cl_command_queue queue, const cl::Event& event);
+
+    // Scopes are per thread: commands are attributed to the innermost
+    // scope the recording thread has open on this profiler.
+    void pushScope(std::string_view name);
+    void popScope();
+
+    // Collects finished commands and starts a new frame.
+    void beginFrame();
+    uint64_t frame() const { return m_frame; }
+
+    // Moves finished commands to the samples; waitAll blocks until every
+    // recorded command is done. Failed commands are logged and dropped.
+    void collect(bool waitAll = false);
+
+    std::vector<ProfileSample> samples() const;
+    // Device time (end - start) grouped by pass / by command name.
+    std::vector<ProfileStats> passStats() const;
+    std::vector<ProfileStats> commandStats() const;
+
+    // Chrome trace event format, loadable in chrome://tracing and Perfetto.
+    // One track per queue; returns false if the file cannot be written.
+    bool exportChromeTrace(const std::string& path) const;
+
+    void clear();
+
+private:
+    struct Pending {
+        std::string name;
+        std::string pass;
+        uint32_t queue;
+        uint64_t frame;
+        cl::Event event;
+    };
+
+    uint32_t queueIndex(cl_command_queue queue);
+    std::vector<ProfileStats> groupBy(std::string ProfileSample::* key) const;
+
+    mutable std::mutex m_mutex;
+    size_t m_maxSamples;
+    uint64_t m_frame = 0;
+    std::vector<cl_command_queue> m_queues;
+    std::vector<Pending> m_pending;
+    std::deque<ProfileSample> m_samples;
+};
+
+/**
+* \brief Out-event for one enqueue call: event() is nullptr when the
+*        context does not profile, otherwise the event is recorded when
+*        this object goes out of scope.
+*/
+class ProfiledCommand {
+public:
+    ProfiledCommand(const GPUContext& ctx, const cl::CommandQueue& queue, std::string_view name)
+        : m_profiler(ctx.profiler()), m_queue(queue()), m_name(name) {}
+
+    ~ProfiledCommand() {
+        if (m_profiler && m_event() != nullptr) {
+            m_profiler->record(m_name, m_queue, m_event);
+        }
+    }
+
+    ProfiledCommand(const ProfiledCommand&) = delete;
+    ProfiledCommand& operator=(const ProfiledCommand&) = delete;
+
+    cl::Event* event() { return m_profiler ? &m_event : nullptr; }
+
+private:
+    GPUProfiler* m_profiler;
+    cl_command_queue m_queue;
+    std::string_view m_name;
+    cl::Event m_event;
+};
+
+// Attributes the commands the calling thread records during its lifetime
+// to a pass.
+class ProfileScope {
+public:
+    ProfileScope(const GPUContext& ctx, std::string_view pass)
+        : m_profiler(ctx.profiler())
+    {
+        if (m_profiler) {
+            m_profiler->pushScope(pass);
+        }
+    }
+
+    ~ProfileScope() {
+        if (m_profiler) {
+            m_profiler->popScope();
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    GPUProfiler* m_profiler;
+};
+
+} // namespace hwr
+
+#endif // HWR_GPU_PROFILER_HPP
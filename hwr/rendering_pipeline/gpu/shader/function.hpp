@@ -0,0 +1,220 @@
+#ifndef HWR_SHADER_FUNCTION_HPP
+#define HWR_SHADER_FUNCTION_HPP
+
+#include "./shader.hpp"
+#include <cctype>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+
+// Functions shared between shader bodies.
+//
+//     hwr::ShaderFunction<float(float, float)> lambert{"lambert",
+//         [](const Float& ndotl, const Float& albedo) { return ndotl * albedo; }};
+//     ...
+//     hwr::shading::color(0) = lambert(n, hwr::shading::attribute<float>("r"));
+//
+// Calling one from a body registers its definition on the Program; the
+// wrapper emits every function the body needs once, ahead of the kernel
+// (detail::makeBodyPrelude). The definition itself is generated the first
+// time the function is called and reused by every kernel built afterwards.
+
+namespace hwr {
+
+enum class Inlining {
+    CALL,   // emitted as an OpenCL function, calls left to the device compiler
+    INLINE, // body expanded at every call site, nothing emitted
+};
+
+namespace detail {
+
+    template<typename R, typename X>
+    std::string return_expr(const X& value) {
+        static_assert(is_shader_convertible_v<shader_value_type_t<X>, R>,
+                      "ShaderFunction body returns a type its signature does not allow");
+        return expr(value);
+    }
+
+    inline bool is_identifier(const std::string& name) {
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+            return false;
+        }
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Definition of a CALL function and everything it pulls into a body.
+    struct CompiledFunction {
+        FunctionDef definition;
+        std::vector<FunctionDef> dependencies;
+        std::vector<std::string> extensions;
+    };
+
+} // namespace detail
+
+template<typename Signature>
+class ShaderFunction;
+
+/**
+* \class ShaderFunction
+* \brief A DSL function with typed parameters and result, callable from any
+*        shader body.
+*
+* The body gets one const ShaderValue<Arg>& per parameter and returns an
+* expression or value convertible to R (nothing when R is void). Arguments
+* are checked like assignments: an int32_t converts to float, a double
+* does not.
+*
+* CALL functions may call other functions but cannot declare kernel
+* parameters (textures, buffers, local arrays): those belong to a kernel,
+* not to a function shared by several. INLINE functions run in the caller's
+* body, so anything a body can do they can do too.
+*
+* Function names are global to the kernels they end up in: two different
+* functions with one name in the same body are a fatal error.
+*/
+template<typename R, typename... Args>
+class ShaderFunction<R(Args...)> {
+    static_assert((is_allowed_type_v<Args> && ...), "Parameters must be valid shader types");
+    static_assert(std::is_void_v<R> || is_allowed_type_v<R>, "Result must be void or a valid shader type");
+
+public:
+    template<typename Lambda>
+    requires std::is_invocable_v<const Lambda&, const ShaderValue<Args>&...>
+    ShaderFunction(std::string name, Lambda&& body, Inlining inlining = Inlining::CALL)
+        : m_name(std::move(name))
+        , m_inlining(inlining)
+        , m_body([fn = std::forward<Lambda>(body)](const ShaderValue<Args>&... args) -> std::string {
+            if constexpr (std::is_void_v<R>) {
+                fn(args...);
+                return "";
+            } else {
+                return detail::return_expr<R>(fn(args...));
+            }
+        })
+    {
+        if (!detail::is_identifier(m_name)) {
+            HWR_FATAL("ShaderFunction - " + m_name + " is not a valid OpenCL identifier");
+        }
+    }
+
+    ShaderFunction(const ShaderFunction&) = delete;
+    ShaderFunction& operator=(const ShaderFunction&) = delete;
+
+    template<typename... Vs>
+    requires (sizeof...(Vs) == sizeof...(Args))
+          && (is_shader_convertible_v<detail::shader_value_type_t<Vs>, Args> && ...)
+    auto operator()(const Vs&... values) const {
+        if constexpr (std::is_void_v<R>) {
+            if (m_inlining == Inlining::INLINE) {
+                expand(std::index_sequence_for<Args...>{}, values...);
+            } else {
+                detail::program_context::appendToProgramCode(call(values...) + ";");
+            }
+        } else {
+            if (m_inlining == Inlining::INLINE) {
+                return ShaderRValue<R>(expand(std::index_sequence_for<Args...>{}, values...));
+            }
+            return ShaderRValue<R>(call(values...));
+        }
+    }
+
+    const std::string& name() const { return m_name; }
+    Inlining inlining() const { return m_inlining; }
+
+private:
+    std::string m_name;
+    Inlining m_inlining;
+    std::function<std::string(const ShaderValue<Args>&...)> m_body;
+
+    mutable std::once_flag m_compileOnce;
+    mutable detail::CompiledFunction m_compiled;
+
+    static std::string parameterName(size_t index) {
+        return "hwr_arg" + std::to_string(index);
+    }
+
+    template<typename... Vs>
+    std::string call(const Vs&... values) const {
+        const detail::CompiledFunction& f = compiled();
+        for (const FunctionDef& dep : f.dependencies) {
+            detail::program_context::require_function(dep);
+        }
+        detail::program_context::require_function(f.definition);
+        for (const std::string& e : f.extensions) {
+            detail::program_context::require_extension(e);
+        }
+        std::string args;
+        ((args += (args.empty() ? "" : ", ") + detail::expr(values)), ...);
+        return m_name + "(" + args + ")";
+    }
+
+    // Copies the arguments into fresh variables, in order, so the body can
+    // neither see them evaluated twice nor assign to the caller's values.
+    template<size_t... I, typename... Vs>
+    std::string expand(std::index_sequence<I...>, const Vs&... values) const {
+        std::tuple<std::unique_ptr<ShaderValue<Args>>...> args{
+            std::make_unique<ShaderValue<Args>>(ShaderRValue<Args>(detail::expr(values)))...
+        };
+        return m_body(*std::get<I>(args)...);
+    }
+
+    template<size_t... I>
+    std::string signature(std::index_sequence<I...>) const {
+        std::string params;
+        ((params += (I == 0 ? "" : ", ") + std::string(opencl_type_name_v<Args>)
+                    + " " + parameterName(I)), ...);
+        if (params.empty()) {
+            params = "void";
+        }
+        std::string result = "void";
+        if constexpr (!std::is_void_v<R>) {
+            result = opencl_type_name_v<R>;
+        }
+        return result + " " + m_name + "(" + params + ")";
+    }
+
+    const detail::CompiledFunction& compiled() const {
+        std::call_once(m_compileOnce, [this]() {
+            Program body([this]() {
+                const std::string result = invoke(std::index_sequence_for<Args...>{});
+                if (!result.empty()) {
+                    detail::program_context::appendToProgramCode("return " + result + ";");
+                }
+            });
+            // May be first called from a loop header; the definition is
+            // generated as ordinary statements all the same.
+            const bool inLoopHeader = detail::program_context::is_forloop_header_being_generated();
+            detail::program_context::unset_forloop_header_generation();
+            const std::string code = body.compile();
+            if (inLoopHeader) {
+                detail::program_context::set_forloop_header_generation();
+            }
+            if (!body.parameters().empty()) {
+                HWR_FATAL("ShaderFunction - " + m_name + " declares kernel parameter "
+                          + body.parameters().front().name + "; only INLINE functions may");
+            }
+            m_compiled.definition = {
+                m_name, signature(std::index_sequence_for<Args...>{}) + "\n{\n" + code + "}\n"
+            };
+            m_compiled.dependencies = body.functions();
+            m_compiled.extensions = body.extensions();
+        });
+        return m_compiled;
+    }
+
+    template<size_t... I>
+    std::string invoke(std::index_sequence<I...>) const {
+        return m_body(ShaderValue<Args>(detail::bind_existing, parameterName(I))...);
+    }
+};
+
+} // namespace hwr
+
+#endif // HWR_SHADER_FUNCTION_HPP
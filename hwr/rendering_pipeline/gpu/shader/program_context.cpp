@@ -6,12 +6,14 @@
 
 namespace hwr::detail::program_context {
 
+    // All generation state is per thread, so Programs can be compiled on
+    // several threads at once (each Program on one thread).
     namespace {
 
-        int32_t counter=0;
-        std::vector<Program*> s_program_stack;
-        std::vector<std::string> s_type_stack;
-        std::vector<std::string> s_rvalue_expr_stack;
+        thread_local int32_t counter=0;
+        thread_local std::vector<Program*> s_program_stack;
+        thread_local std::vector<std::string> s_type_stack;
+        thread_local std::vector<std::string> s_rvalue_expr_stack;
 
     }
         
@@ -72,7 +74,7 @@ namespace hwr::detail::program_context {
         return res;
     }
 
-    static bool _is_forloop_header_being_generated = false;
+    static thread_local bool _is_forloop_header_being_generated = false;
 
     void set_forloop_header_generation(){
         _is_forloop_header_being_generated = true;
@@ -103,7 +105,7 @@ namespace hwr::detail::program_context {
     }
 
     namespace {
-        bool _is_first_def = false;
+        thread_local bool _is_first_def = false;
     }
 
     bool is_first_def(){
@@ -132,8 +134,33 @@ namespace hwr::detail::program_context {
         }
     }
 
+    void declare_kernel_param(const std::string& name, const std::string& declaration,
+                              size_t localBytes){
+        if(s_program_stack.empty()){
+            HWR_FATAL("Empty program stack");
+        }else{
+            s_program_stack.back()->declare_param(name, declaration, localBytes);
+        }
+    }
+
+    void require_extension(const std::string& name){
+        if(s_program_stack.empty()){
+            HWR_FATAL("Empty program stack");
+        }else{
+            s_program_stack.back()->require_extension(name);
+        }
+    }
+
+    void require_function(const FunctionDef& f){
+        if(s_program_stack.empty()){
+            HWR_FATAL("Empty program stack");
+        }else{
+            s_program_stack.back()->require_function(f);
+        }
+    }
+
     namespace{
-        int32_t temp_counter = 0;
+        thread_local int32_t temp_counter = 0;
     }
 
     std::string make_temp_name() {
@@ -147,7 +174,7 @@ namespace hwr::detail::program_context {
     }
 
     namespace{
-        bool _is_struct_being_defined = false;
+        thread_local bool _is_struct_being_defined = false;
     }
 
     void set_struct_def(){
@@ -161,7 +188,7 @@ namespace hwr::detail::program_context {
     }
 
     namespace{
-        std::vector<std::string> names;
+        thread_local std::vector<std::string> names;
     }
 
     void push_field_name(const std::string& name){
@@ -1,11 +1,13 @@
 #ifndef HWR_PROGRAM_CONTEXT_HPP
 #define HWR_PROGRAM_CONTEXT_HPP
 
+#include <cstddef>
 #include <stack>
 #include <string>
 
 namespace hwr {
     class Program;
+    struct FunctionDef;
 }
 
 namespace hwr::detail::program_context {
@@ -44,6 +46,11 @@ namespace hwr::detail::program_context {
 
     void rollback_name_counter(int32_t k);
 
+    void declare_kernel_param(const std::string& name, const std::string& declaration,
+                              size_t localBytes = 0);
+    void require_extension(const std::string& name);
+    void require_function(const FunctionDef& f);
+
     std::string make_temp_name();
 
     void set_struct_def();
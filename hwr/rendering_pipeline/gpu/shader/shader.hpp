@@ -4,6 +4,11 @@
 #include <string>
 #include <functional>
 #include <stack>
+#include <string_view>
+#include <concepts>
+#include <utility>
+#include <cassert>
+#include <optional>
 
 #include "./shader_types_util.hpp"
 #include "./static_string.hpp"
@@ -145,11 +150,29 @@ namespace detail {
 }  // namespace detail
 
 
+// Extra kernel argument requested by the program body (texture, sampler...),
+// appended to the signature by whoever wraps the body into a kernel.
+struct KernelParam {
+    std::string name;
+    std::string declaration; // e.g. "read_only image2d_t albedo"
+    size_t localBytes = 0;   // __local buffers: size the wrapper binds
+};
+
+// OpenCL function called by the program body (see ShaderFunction), emitted
+// ahead of the kernel by whoever wraps the body.
+struct FunctionDef {
+    std::string name;
+    std::string source;
+};
+
 class Program {
 
 private:
     int32_t _remaining_to_ignore = 0;
     std::vector<std::string> code_;
+    std::vector<KernelParam> params_;
+    std::vector<std::string> extensions_;
+    std::vector<FunctionDef> functions_;
     std::function<void()> compilable_fn_;
     bool compiled_ = false;
 
@@ -202,6 +225,38 @@ private:
         }
     }
 
+    void declare_param(const std::string& name, const std::string& declaration,
+                       size_t localBytes){
+        for(const KernelParam& p : params_){
+            if(p.name == name){
+                if(p.declaration != declaration || p.localBytes != localBytes){
+                    HWR_FATAL("Kernel parameter " + name + " declared twice with different types");
+                }
+                return;
+            }
+        }
+        params_.push_back({name, declaration, localBytes});
+    }
+
+    void require_extension(const std::string& name){
+        for(const std::string& e : extensions_){
+            if(e == name) return;
+        }
+        extensions_.push_back(name);
+    }
+
+    void require_function(const FunctionDef& f){
+        for(const FunctionDef& g : functions_){
+            if(g.name == f.name){
+                if(g.source != f.source){
+                    HWR_FATAL("Shader function " + f.name + " defined twice with different bodies");
+                }
+                return;
+            }
+        }
+        functions_.push_back(f);
+    }
+
 public:
 
     template<typename Lambda, 
@@ -211,6 +266,14 @@ public:
 
 
     std::string compile() {
+        // Start from scratch so the same Program can be compiled repeatedly
+        // (e.g. a struct definition shared by several kernels).
+        code_.clear();
+        params_.clear();
+        extensions_.clear();
+        functions_.clear();
+        _remaining_to_ignore = 0;
+
         // Push before generating code
         detail::program_context::push_program(*this);
 
@@ -227,6 +290,13 @@ public:
         return res;
     }
 
+    // Valid after compile().
+    const std::vector<KernelParam>& parameters() const { return params_; }
+    // OpenCL extensions the body uses; the wrapper enables them.
+    const std::vector<std::string>& extensions() const { return extensions_; }
+    // Functions the body calls, each after the ones it calls itself.
+    const std::vector<FunctionDef>& functions() const { return functions_; }
+
     // Accessor for ProgramContext
     friend void detail::program_context::push_program(Program& p);
     friend void detail::program_context::appendToProgramCode(
@@ -236,6 +306,11 @@ public:
 
     friend void detail::program_context::ignore_next_k_appends(int32_t k);
     friend void detail::program_context::undo_last_k_appends(int32_t k);
+    friend void detail::program_context::declare_kernel_param(
+                        const std::string& name, const std::string& declaration,
+                        size_t localBytes);
+    friend void detail::program_context::require_extension(const std::string& name);
+    friend void detail::program_context::require_function(const FunctionDef& f);
 
 }; 
 
@@ -244,6 +319,11 @@ namespace detail {
 
     const inline std::string COMMON_RVALUE_NAME = "";
     const inline std::string COMMON_RVALUE_DEFINITION = "";
+
+    // Tag for ShaderValues that refer to an lvalue already present
+    // in the generated code (buffer elements, kernel built-ins etc.)
+    struct bind_existing_t { explicit bind_existing_t() = default; };
+    inline constexpr bind_existing_t bind_existing{};
     
     
     template<typename T>
@@ -292,6 +372,13 @@ public:
         }
     }
 
+    // Binds to an existing OpenCL lvalue. Emits no code by itself.
+    ShaderValue(detail::bind_existing_t, const std::string& lvalue)
+        : type_(std::string(opencl_type_name_v<T>)), expression_(lvalue),
+        name_(lvalue),
+        def_("")
+    {}
+
     ShaderValue(const std::string &name)
         : type_(std::string(opencl_type_name_v<T>)), expression_(""),
         name_(name),
@@ -355,7 +442,7 @@ public:
             detail::program_context::appendToProgramCode(name_ + ";");
             detail::program_context::replace_possible_comma_with_semicolon();
         }
-        HWR_INFO("counter: " + std::to_string(res));
+        HWR_DEBUG_IN(LogModule::SHADER, "counter: {}", res);
         if (res > 0) detail::program_context::decr_counter();
         detail::program_context::unset_first_def();
         return res > 0;
@@ -367,7 +454,7 @@ protected:
           name_(detail::program_context::make_temp_name()),
           def_(type_ + " " + name_ + " = " + expression_ + ";") {
               
-        HWR_DEBUG("Appending code to program: " + def_);
+        HWR_DEBUG_IN(LogModule::SHADER, "Appending code to program: {}", def_);
 
         if (detail::program_context::is_forloop_header_being_generated()) {
             if (detail::program_context::is_first_def()) {
@@ -446,7 +533,7 @@ public:
             );
             detail::program_context::replace_possible_comma_with_semicolon();
         }
-        HWR_INFO("counter: "+std::to_string(res));
+        HWR_DEBUG_IN(LogModule::SHADER, "counter: {}", res);
         if(res>0){
             detail::program_context::decr_counter();
         }
@@ -489,6 +576,14 @@ namespace hwr::detail
          return toOpenCLCode(v); 
     }
 
+    // Shader type of a DSL value or of a plain literal.
+    template<typename U> U shader_value_type_of(const ShaderValue<U>&);
+    template<typename U> U shader_value_type_of(const ShaderRValue<U>&);
+    template<AllowedShaderType U> U shader_value_type_of(const U&);
+
+    template<typename X>
+    using shader_value_type_t = decltype(shader_value_type_of(std::declval<const X&>()));
+
     // Tiny helper that actually assembles "(lhs OP rhs)"
     inline std::string make_expr(const std::string& lhs,
                                  const char*        op,
@@ -615,33 +710,70 @@ inline ShaderRValue<bool> operator!(const ShaderRValue<T>& v) {
 
 #define HWR_STRINGIFY(x) #x
 
-#define HWR_FOR(...) \
-auto HWR_CONCAT(_hwr_for_parsed_, __LINE__) = hwr::detail::parseForHeader(HWR_STRINGIFY(__VA_ARGS__));  \
-if(!HWR_CONCAT(_hwr_for_parsed_, __LINE__)){    \
-    HWR_FATAL("Invalid forloop header"); \
-} \
-auto [HWR_CONCAT(_hwr_for_init_, __LINE__),HWR_CONCAT(_hwr_for_cond_, __LINE__),HWR_CONCAT(_hwr_for_upd_, __LINE__)] = HWR_CONCAT(_hwr_for_parsed_, __LINE__).value().tie(); \
-{ \
-    hwr::detail::program_context::appendToProgramCode(std::string("for(")); \
-    hwr::detail::program_context::set_forloop_header_generation(); \
-    hwr::detail::program_context::incr_counter();                  \
-    hwr::detail::program_context::set_first_def();                      \
-    for (__VA_ARGS__) {} \
-    hwr::detail::program_context::remove_last_char();                  \
-    hwr::detail::program_context::appendToProgramCode(std::string("){")); \
-    hwr::detail::program_context::unset_forloop_header_generation(); \
-} \
-hwr::detail::program_context::incr_counter();                  \
-int32_t HWR_CONCAT(_hwr_for_declcount_, __LINE__) = hwr::detail::countInitDeclarations(HWR_CONCAT(_hwr_for_init_, __LINE__)); \
-hwr::detail::program_context::rollback_name_counter(HWR_CONCAT(_hwr_for_declcount_, __LINE__)); \
-int32_t HWR_CONCAT(_hwr_for_updcount_, __LINE__) = hwr::detail::countUpdateOperations(HWR_CONCAT(_hwr_for_upd_, __LINE__)); \
-assert(HWR_CONCAT(_hwr_for_declcount_, __LINE__)!=-1); \
-assert(HWR_CONCAT(_hwr_for_updcount_, __LINE__)!=-1); \
-hwr::detail::program_context::ignore_next_k_appends(HWR_CONCAT(_hwr_for_declcount_, __LINE__)); \
-for (__VA_ARGS__,hwr::detail::program_context::undo_last_k_appends(HWR_CONCAT(_hwr_for_updcount_, __LINE__)), hwr::detail::program_context::appendToProgramCode(std::string("}")))  \
-
-
-         
+namespace hwr {
+
+// Asks the device compiler to unroll the runtime loop that follows: fully
+// when count is 0, count times otherwise (1 keeps it rolled).
+inline void unroll_hint(uint32_t count = 0) {
+    detail::program_context::appendToProgramCode(
+        count == 0 ? std::string("#pragma unroll") : "#pragma unroll " + std::to_string(count));
+}
+
+namespace detail {
+
+    // State of one HWR_FOR. The constructor emits the optional unroll
+    // pragma and the loop header; the loop the macro runs afterwards
+    // generates the body, so HWR_FOR stays a single statement.
+    class ForLoopScope {
+    public:
+        template<typename GenerateHeader>
+        ForLoopScope(const char* header, std::optional<uint32_t> unroll, GenerateHeader&& generateHeader) {
+            auto parsed = parseForHeader(header);
+            if (!parsed) {
+                HWR_FATAL("Invalid forloop header");
+            }
+            auto [init, cond, upd] = parsed.value().tie();
+            if (unroll) {
+                unroll_hint(*unroll);
+            }
+            program_context::appendToProgramCode(std::string("for("));
+            program_context::set_forloop_header_generation();
+            program_context::incr_counter();
+            program_context::set_first_def();
+            generateHeader();
+            program_context::remove_last_char();
+            program_context::appendToProgramCode(std::string("){"));
+            program_context::unset_forloop_header_generation();
+            program_context::incr_counter();
+            const int32_t declCount = countInitDeclarations(init);
+            program_context::rollback_name_counter(declCount);
+            m_updateCount = countUpdateOperations(upd);
+            assert(declCount != -1);
+            assert(m_updateCount != -1);
+            program_context::ignore_next_k_appends(declCount);
+        }
+
+        bool active() const { return m_active; }
+        void finish() { m_active = false; }
+        int32_t updateCount() const { return m_updateCount; }
+
+    private:
+        int32_t m_updateCount = 0;
+        bool m_active = true;
+    };
+
+} // namespace detail
+
+} // namespace hwr
+
+#define HWR_FOR_IMPL(unroll, ...) \
+for (hwr::detail::ForLoopScope HWR_CONCAT(_hwr_for_, __LINE__)(HWR_STRINGIFY(__VA_ARGS__), unroll, [&]() { for (__VA_ARGS__) {} }); \
+     HWR_CONCAT(_hwr_for_, __LINE__).active(); \
+     HWR_CONCAT(_hwr_for_, __LINE__).finish()) \
+for (__VA_ARGS__,hwr::detail::program_context::undo_last_k_appends(HWR_CONCAT(_hwr_for_, __LINE__).updateCount()), hwr::detail::program_context::appendToProgramCode(std::string("}")))
+
+#define HWR_FOR(...) HWR_FOR_IMPL(std::nullopt, __VA_ARGS__)
+
 // C++-style while loop
 #define HWR_WHILE(cond)                                                         \
     for (bool HWR_CONCAT(_hwr_while_once_, __LINE__) =                          \
@@ -685,6 +817,57 @@ for (__VA_ARGS__,hwr::detail::program_context::undo_last_k_appends(HWR_CONCAT(_h
              std::string("}")                                                 \
          ), HWR_CONCAT(_hwr_else_once_, __LINE__) = false)
 
+// ---- Unrolling ----
+
+namespace hwr {
+
+namespace detail {
+
+    template<std::integral I>
+    uint32_t unroll_bound(I v) {
+        if constexpr (std::is_signed_v<I>) {
+            HWR_ASSERT(v >= 0, "Unrolled loop bounds must not be negative");
+        }
+        return static_cast<uint32_t>(v);
+    }
+
+    template<typename Body, uint32_t... I>
+    void static_for_impl(Body& body, std::integer_sequence<uint32_t, I...>) {
+        (body(std::integral_constant<uint32_t, I>{}), ...);
+    }
+
+} // namespace detail
+
+// Generates body once per index in [0, N), with no loop in the generated
+// code. The index is a std::integral_constant: usable as a plain uint32_t
+// and in constant expressions (template arguments, array sizes).
+template<uint32_t N, typename Body>
+void static_for(Body&& body) {
+    detail::static_for_impl(body, std::make_integer_sequence<uint32_t, N>{});
+}
+
+// Same for [begin, end) known only when the body is generated.
+template<typename Body>
+requires std::is_invocable_v<Body&, uint32_t>
+void static_for(uint32_t begin, uint32_t end, Body&& body) {
+    for (uint32_t i = begin; i < end; ++i) {
+        body(i);
+    }
+}
+
+} // namespace hwr
+
+// Loop run at generation time: the body is emitted once per value of var,
+// a C++ uint32_t, so HWR_UNROLL(i, 0, 4) { ... } gives straight-line code.
+// Bounds must be C++ integers, not shader values.
+#define HWR_UNROLL(var, begin, end)                                             \
+    for (uint32_t var = hwr::detail::unroll_bound(begin),                       \
+                  HWR_CONCAT(_hwr_unroll_end_, __LINE__) = hwr::detail::unroll_bound(end); \
+         var < HWR_CONCAT(_hwr_unroll_end_, __LINE__); ++var)
+
+// HWR_FOR preceded by unroll_hint(count), as a single statement.
+#define HWR_FOR_UNROLL(count, ...) HWR_FOR_IMPL(std::optional<uint32_t>(count), __VA_ARGS__)
+
 
 
 // Disable strict pedantic and unused warnings
@@ -701,6 +884,29 @@ for (__VA_ARGS__,hwr::detail::program_context::undo_last_k_appends(HWR_CONCAT(_h
 #endif
 
 
+namespace hwr {
+
+    // HWR_STRUCT fields are copied verbatim into OpenCL, so the fixed-width
+    // integer names used on the host side have to exist there too.
+    inline constexpr std::string_view OPENCL_STDINT_PRELUDE =
+        "typedef char int8_t;\n"
+        "typedef short int16_t;\n"
+        "typedef int int32_t;\n"
+        "typedef long int64_t;\n"
+        "typedef uchar uint8_t;\n"
+        "typedef ushort uint16_t;\n"
+        "typedef uint uint32_t;\n"
+        "typedef ulong uint64_t;\n";
+
+    // Anything declared with HWR_STRUCT.
+    template<typename T>
+    concept ShaderStruct = requires {
+        { T::opencl_name } -> std::convertible_to<std::string_view>;
+        T::opencl_def.compile();
+    };
+
+} // namespace hwr
+
 #define HWR_STRUCT(name, fields)                           \
     HWR_DISABLE_ANON_STRUCT_WARNINGS                       \
     struct HWR_CONCAT(name, _internal_sized) { fields };    \
@@ -710,6 +916,8 @@ for (__VA_ARGS__,hwr::detail::program_context::undo_last_k_appends(HWR_CONCAT(_h
             char raw[sizeof(HWR_CONCAT(name, _internal_sized))]; \
         };                                                  \
         static ::hwr::Program opencl_def;                   \
+        static constexpr const char* opencl_name = #name;   \
+        static constexpr const char* opencl_fields = HWR_STRINGIFY(fields); \
     };                                                      \
     ::hwr::Program name::opencl_def{[](){                   \
         ::hwr::detail::program_context::appendToProgramCode("struct " #name " {"); \
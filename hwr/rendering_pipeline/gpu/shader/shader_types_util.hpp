@@ -60,6 +60,21 @@ namespace hwr {
         return std::to_string(what);
     }
 
+    template<>
+    inline std::string toOpenCLCode(uint32_t what){
+        return std::to_string(what) + "u";
+    }
+
+    template<>
+    inline std::string toOpenCLCode(int64_t what){
+        return std::to_string(what) + "L";
+    }
+
+    template<>
+    inline std::string toOpenCLCode(uint64_t what){
+        return std::to_string(what) + "UL";
+    }
+
     template<>
     inline std::string toOpenCLCode(double what){
         return std::to_string(what);
@@ -0,0 +1,95 @@
+#ifndef HWR_SHADER_TEXTURE_HPP
+#define HWR_SHADER_TEXTURE_HPP
+
+#include "./shader.hpp"
+#include <string>
+
+// Image and sampler access inside shader bodies.
+//
+// texture2d("albedo") and friends declare an extra kernel parameter on the
+// program being generated; the wrapper that turns the body into a kernel
+// appends it to the signature, and the host binds the matching Texture2D /
+// Sampler by name (InstancedDraw::bind, VisibilityShading::bind).
+
+namespace hwr {
+
+struct ShaderTexture2D { std::string name; };
+struct ShaderTexture2DArray { std::string name; };
+struct ShaderSampler { std::string name; };
+
+// Result of a texture read, channels as float (unorm formats in [0, 1]).
+struct Texel {
+    ShaderValue<float> r;
+    ShaderValue<float> g;
+    ShaderValue<float> b;
+    ShaderValue<float> a;
+};
+
+inline ShaderTexture2D texture2d(const std::string& name) {
+    detail::program_context::declare_kernel_param(name, "read_only image2d_t " + name);
+    return {name};
+}
+
+inline ShaderTexture2DArray texture2d_array(const std::string& name) {
+    detail::program_context::declare_kernel_param(name, "read_only image2d_array_t " + name);
+    return {name};
+}
+
+inline ShaderSampler sampler(const std::string& name) {
+    detail::program_context::declare_kernel_param(name, "sampler_t " + name);
+    return {name};
+}
+
+namespace detail {
+
+    inline Texel read_texel(const std::string& call) {
+        const std::string tmp = program_context::make_temp_name();
+        program_context::appendToProgramCode("float4 " + tmp + " = " + call + ";");
+        return Texel{
+            ShaderValue<float>(bind_existing, tmp + ".s0"),
+            ShaderValue<float>(bind_existing, tmp + ".s1"),
+            ShaderValue<float>(bind_existing, tmp + ".s2"),
+            ShaderValue<float>(bind_existing, tmp + ".s3"),
+        };
+    }
+
+} // namespace detail
+
+// Filtered read at (u, v); coordinates follow the sampler's normalization.
+template<typename U, typename V>
+Texel sample(const ShaderTexture2D& tex, const ShaderSampler& smp,
+             const U& u, const V& v)
+{
+    return detail::read_texel(
+        "read_imagef(" + tex.name + ", " + smp.name + ", (float2)("
+        + detail::expr(u) + ", " + detail::expr(v) + "))"
+    );
+}
+
+// Filtered read from one layer of an array texture. The layer is not
+// interpolated, it is rounded to the nearest integer.
+template<typename U, typename V, typename L>
+Texel sample(const ShaderTexture2DArray& tex, const ShaderSampler& smp,
+             const U& u, const V& v, const L& layer)
+{
+    return detail::read_texel(
+        "read_imagef(" + tex.name + ", " + smp.name + ", (float4)("
+        + detail::expr(u) + ", " + detail::expr(v) + ", (float)("
+        + detail::expr(layer) + "), 0.0f))"
+    );
+}
+
+// Unfiltered read of texel (x, y), no sampler needed. Out-of-range
+// coordinates give undefined results.
+template<typename X, typename Y>
+Texel fetch(const ShaderTexture2D& tex, const X& x, const Y& y)
+{
+    return detail::read_texel(
+        "read_imagef(" + tex.name + ", (int2)((int)(" + detail::expr(x)
+        + "), (int)(" + detail::expr(y) + ")))"
+    );
+}
+
+} // namespace hwr
+
+#endif // HWR_SHADER_TEXTURE_HPP
@@ -0,0 +1,330 @@
+#ifndef HWR_SHADER_WORK_GROUP_HPP
+#define HWR_SHADER_WORK_GROUP_HPP
+
+#include "./shader.hpp"
+#include <string>
+#include <utility>
+
+// Work-item queries, local and global arrays, barriers and atomics inside
+// shader bodies.
+//
+// local_array() and global_buffer() declare extra kernel parameters, like
+// texture2d() does. Local arrays get their size here and the wrapper binds
+// them (detail::declareBodyParams); global buffers are bound by name.
+//
+// barrier() has to be reached by every work-item of the group. Bodies of
+// passes that return early for some items (pixels outside the target...)
+// must not use it; ComputeKernel never does that.
+
+namespace hwr {
+
+enum class AddressSpace {
+    GLOBAL,
+    LOCAL,
+};
+
+// Element of a local or global array. Reads and writes like any other
+// value; atomics only accept these.
+template<AllowedShaderType T, AddressSpace Space>
+class ShaderElement : public ShaderValue<T> {
+public:
+    explicit ShaderElement(const std::string& lvalue)
+        : ShaderValue<T>(detail::bind_existing, lvalue) {}
+
+    using ShaderValue<T>::operator=;
+
+    // Hides the base's deleted copy assignment, which would otherwise win
+    // for elements of another array.
+    void operator=(const ShaderValue<T>& rhs) {
+        detail::program_context::appendToProgramCode(
+            detail::expr(static_cast<const ShaderValue<T>&>(*this)) + " = " + detail::expr(rhs) + ";");
+    }
+
+    void operator=(const ShaderElement& rhs) {
+        *this = static_cast<const ShaderValue<T>&>(rhs);
+    }
+};
+
+namespace detail {
+
+    // Otherwise the bare-scalar fallback would be the better match.
+    template<typename T, AddressSpace Space>
+    std::string expr(const ShaderElement<T, Space>& e) {
+        return expr(static_cast<const ShaderValue<T>&>(e));
+    }
+
+    template<typename T>
+    ShaderValue<T> call_into_temp(const std::string& call) {
+        const std::string tmp = program_context::make_temp_name();
+        program_context::appendToProgramCode(
+            std::string(opencl_type_name_v<T>) + " " + tmp + " = " + call + ";");
+        return ShaderValue<T>(bind_existing, tmp);
+    }
+
+} // namespace detail
+
+// Integer value or literal, usable as an array index.
+template<typename I>
+concept ShaderIndex = requires { typename detail::shader_value_type_t<I>; }
+                   && IntegerType<detail::shader_value_type_t<I>>;
+
+// Types the 32-bit OpenCL atomics work on.
+template<typename T>
+concept AtomicIntegerType = std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>;
+
+template<AllowedShaderType T, AddressSpace Space>
+class ShaderArray {
+public:
+    explicit ShaderArray(std::string name) : m_name(std::move(name)) {}
+
+    template<ShaderIndex I>
+    ShaderElement<T, Space> operator[](const I& index) const {
+        return ShaderElement<T, Space>(m_name + "[" + detail::expr(index) + "]");
+    }
+
+    const std::string& name() const { return m_name; }
+
+private:
+    std::string m_name;
+};
+
+template<AllowedShaderType T>
+using LocalArray = ShaderArray<T, AddressSpace::LOCAL>;
+
+template<AllowedShaderType T>
+using GlobalBuffer = ShaderArray<T, AddressSpace::GLOBAL>;
+
+// count elements of work-group shared memory. bool has no fixed size in
+// OpenCL, so it is not allowed here.
+template<AllowedShaderType T>
+requires(!std::is_same_v<T, bool>)
+LocalArray<T> local_array(const std::string& name, size_t count) {
+    detail::program_context::declare_kernel_param(
+        name, "__local " + std::string(opencl_type_name_v<T>) + "* " + name, count * sizeof(T));
+    return LocalArray<T>(name);
+}
+
+// Device buffer of T, bound by name (e.g. a BaseBuffer<uint32_t>).
+template<AllowedShaderType T>
+requires(!std::is_same_v<T, bool>)
+GlobalBuffer<T> global_buffer(const std::string& name) {
+    detail::program_context::declare_kernel_param(
+        name, "__global " + std::string(opencl_type_name_v<T>) + "* " + name);
+    return GlobalBuffer<T>(name);
+}
+
+// ---- Work-item queries, dimension 0, 1 or 2 ----
+
+namespace detail {
+
+    inline ShaderRValue<uint32_t> work_item_query(const char* fn, uint32_t dim) {
+        HWR_ASSERT(dim < 3, "Work-item queries take dimension 0, 1 or 2");
+        return ShaderRValue<uint32_t>("((uint)" + std::string(fn) + "(" + std::to_string(dim) + "))");
+    }
+
+} // namespace detail
+
+inline ShaderRValue<uint32_t> global_id(uint32_t dim = 0) {
+    return detail::work_item_query("get_global_id", dim);
+}
+
+inline ShaderRValue<uint32_t> local_id(uint32_t dim = 0) {
+    return detail::work_item_query("get_local_id", dim);
+}
+
+inline ShaderRValue<uint32_t> group_id(uint32_t dim = 0) {
+    return detail::work_item_query("get_group_id", dim);
+}
+
+inline ShaderRValue<uint32_t> global_size(uint32_t dim = 0) {
+    return detail::work_item_query("get_global_size", dim);
+}
+
+inline ShaderRValue<uint32_t> local_size(uint32_t dim = 0) {
+    return detail::work_item_query("get_local_size", dim);
+}
+
+inline ShaderRValue<uint32_t> num_groups(uint32_t dim = 0) {
+    return detail::work_item_query("get_num_groups", dim);
+}
+
+// ---- Synchronization ----
+
+enum class MemoryFence {
+    LOCAL,
+    GLOBAL,
+    LOCAL_AND_GLOBAL,
+};
+
+namespace detail {
+
+    inline const char* fence_flags(MemoryFence fence) {
+        switch (fence) {
+            case MemoryFence::LOCAL:            return "CLK_LOCAL_MEM_FENCE";
+            case MemoryFence::GLOBAL:           return "CLK_GLOBAL_MEM_FENCE";
+            case MemoryFence::LOCAL_AND_GLOBAL: return "CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE";
+        }
+        return "";
+    }
+
+} // namespace detail
+
+// Waits for the whole work-group; writes to the fenced memory made before
+// it are visible to the group after it.
+inline void barrier(MemoryFence fence = MemoryFence::LOCAL) {
+    detail::program_context::appendToProgramCode(
+        "barrier(" + std::string(detail::fence_flags(fence)) + ");");
+}
+
+// Orders this work-item's own loads and stores, does not wait for others.
+inline void mem_fence(MemoryFence fence = MemoryFence::LOCAL) {
+    detail::program_context::appendToProgramCode(
+        "mem_fence(" + std::string(detail::fence_flags(fence)) + ");");
+}
+
+// ---- Atomics on array elements. Each returns the element's old value. ----
+
+namespace detail {
+
+    template<AtomicIntegerType T, AddressSpace Space, typename V>
+    requires IntegerType<shader_value_type_t<V>>
+    ShaderValue<T> atomic_op(const char* fn, const ShaderElement<T, Space>& e, const V& value) {
+        return call_into_temp<T>(std::string(fn) + "(&" + expr(e) + ", ("
+            + std::string(opencl_type_name_v<T>) + ")(" + expr(value) + "))");
+    }
+
+} // namespace detail
+
+#define HWR_DEFINE_SHADER_ATOMIC(NAME)                                           \
+template<hwr::AtomicIntegerType T, hwr::AddressSpace Space, typename V>          \
+requires hwr::IntegerType<hwr::detail::shader_value_type_t<V>>                   \
+hwr::ShaderValue<T> NAME(const hwr::ShaderElement<T, Space>& e, const V& value)  \
+{                                                                                \
+    return hwr::detail::atomic_op(#NAME, e, value);                              \
+}
+
+HWR_DEFINE_SHADER_ATOMIC(atomic_add)
+HWR_DEFINE_SHADER_ATOMIC(atomic_sub)
+HWR_DEFINE_SHADER_ATOMIC(atomic_min)
+HWR_DEFINE_SHADER_ATOMIC(atomic_max)
+HWR_DEFINE_SHADER_ATOMIC(atomic_and)
+HWR_DEFINE_SHADER_ATOMIC(atomic_or)
+HWR_DEFINE_SHADER_ATOMIC(atomic_xor)
+
+#undef HWR_DEFINE_SHADER_ATOMIC
+
+template<AtomicIntegerType T, AddressSpace Space, typename V>
+requires IntegerType<detail::shader_value_type_t<V>>
+ShaderValue<T> atomic_xchg(const ShaderElement<T, Space>& e, const V& value) {
+    return detail::atomic_op("atomic_xchg", e, value);
+}
+
+// Float exchange is the one float atomic in core OpenCL.
+template<AddressSpace Space, typename V>
+requires is_shader_convertible_v<detail::shader_value_type_t<V>, float>
+ShaderValue<float> atomic_xchg(const ShaderElement<float, Space>& e, const V& value) {
+    return detail::call_into_temp<float>("atomic_xchg(&" + detail::expr(e) + ", (float)("
+                                         + detail::expr(value) + "))");
+}
+
+template<AtomicIntegerType T, AddressSpace Space>
+ShaderValue<T> atomic_inc(const ShaderElement<T, Space>& e) {
+    return detail::call_into_temp<T>("atomic_inc(&" + detail::expr(e) + ")");
+}
+
+template<AtomicIntegerType T, AddressSpace Space>
+ShaderValue<T> atomic_dec(const ShaderElement<T, Space>& e) {
+    return detail::call_into_temp<T>("atomic_dec(&" + detail::expr(e) + ")");
+}
+
+// Stores value if the element equals expected.
+template<AtomicIntegerType T, AddressSpace Space, typename C, typename V>
+requires IntegerType<detail::shader_value_type_t<C>> && IntegerType<detail::shader_value_type_t<V>>
+ShaderValue<T> atomic_cmpxchg(const ShaderElement<T, Space>& e, const C& expected, const V& value) {
+    const std::string type(opencl_type_name_v<T>);
+    return detail::call_into_temp<T>("atomic_cmpxchg(&" + detail::expr(e) + ", (" + type + ")("
+                                     + detail::expr(expected) + "), (" + type + ")("
+                                     + detail::expr(value) + "))");
+}
+
+// ---- Sub-groups (cl_khr_subgroups) ----
+// The items of a work-group the device runs in lockstep. Using any of
+// these makes the body require the extension.
+
+namespace detail {
+
+    inline ShaderRValue<uint32_t> sub_group_query(const char* fn) {
+        program_context::require_extension("cl_khr_subgroups");
+        return ShaderRValue<uint32_t>("((uint)" + std::string(fn) + "())");
+    }
+
+    template<typename V>
+    using sub_group_operand_t = shader_value_type_t<V>;
+
+    template<typename T>
+    concept SubGroupType = std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>
+                        || std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t>
+                        || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+    template<typename V>
+    ShaderRValue<sub_group_operand_t<V>> sub_group_collective(const char* fn, const V& value) {
+        program_context::require_extension("cl_khr_subgroups");
+        return ShaderRValue<sub_group_operand_t<V>>(std::string(fn) + "(" + expr(value) + ")");
+    }
+
+} // namespace detail
+
+inline ShaderRValue<uint32_t> sub_group_size() {
+    return detail::sub_group_query("get_sub_group_size");
+}
+
+inline ShaderRValue<uint32_t> sub_group_id() {
+    return detail::sub_group_query("get_sub_group_id");
+}
+
+inline ShaderRValue<uint32_t> sub_group_local_id() {
+    return detail::sub_group_query("get_sub_group_local_id");
+}
+
+inline void sub_group_barrier(MemoryFence fence = MemoryFence::LOCAL) {
+    detail::program_context::require_extension("cl_khr_subgroups");
+    detail::program_context::appendToProgramCode(
+        "sub_group_barrier(" + std::string(detail::fence_flags(fence)) + ");");
+}
+
+template<typename V>
+requires detail::SubGroupType<detail::shader_value_type_t<V>>
+ShaderRValue<detail::shader_value_type_t<V>> sub_group_reduce_add(const V& value) {
+    return detail::sub_group_collective("sub_group_reduce_add", value);
+}
+
+template<typename V>
+requires detail::SubGroupType<detail::shader_value_type_t<V>>
+ShaderRValue<detail::shader_value_type_t<V>> sub_group_reduce_min(const V& value) {
+    return detail::sub_group_collective("sub_group_reduce_min", value);
+}
+
+template<typename V>
+requires detail::SubGroupType<detail::shader_value_type_t<V>>
+ShaderRValue<detail::shader_value_type_t<V>> sub_group_reduce_max(const V& value) {
+    return detail::sub_group_collective("sub_group_reduce_max", value);
+}
+
+template<typename V>
+requires detail::SubGroupType<detail::shader_value_type_t<V>>
+ShaderRValue<detail::shader_value_type_t<V>> sub_group_scan_inclusive_add(const V& value) {
+    return detail::sub_group_collective("sub_group_scan_inclusive_add", value);
+}
+
+// Value of the item at sub-group index lane, the same for every item.
+template<typename V, ShaderIndex L>
+requires detail::SubGroupType<detail::shader_value_type_t<V>>
+ShaderRValue<detail::shader_value_type_t<V>> sub_group_broadcast(const V& value, const L& lane) {
+    detail::program_context::require_extension("cl_khr_subgroups");
+    return ShaderRValue<detail::shader_value_type_t<V>>(
+        "sub_group_broadcast(" + detail::expr(value) + ", (uint)(" + detail::expr(lane) + "))");
+}
+
+} // namespace hwr
+
+#endif // HWR_SHADER_WORK_GROUP_HPP
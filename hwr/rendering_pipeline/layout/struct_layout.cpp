@@ -0,0 +1,376 @@
+#include "struct_layout.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+
+namespace hwr {
+
+    namespace {
+
+        struct ScalarType {
+            std::string_view spelling;   // as written in the C++ field list
+            std::string_view opencl;
+            size_t size;
+            size_t alignment;
+        };
+
+        // Longer spellings first, so "unsigned int" is not read as "unsigned".
+        // bool is missing on purpose: its size on the device is up to the
+        // implementation, and it cannot live in a buffer.
+        constexpr std::array<ScalarType, 20> SCALAR_TYPES{{
+            { "unsigned long long", "ulong",  sizeof(unsigned long long), alignof(unsigned long long) },
+            { "unsigned short",     "ushort", sizeof(unsigned short),     alignof(unsigned short) },
+            { "unsigned char",      "uchar",  sizeof(unsigned char),      alignof(unsigned char) },
+            { "unsigned int",       "uint",   sizeof(unsigned int),       alignof(unsigned int) },
+            { "signed char",        "char",   sizeof(signed char),        alignof(signed char) },
+            { "long long",          "long",   sizeof(long long),          alignof(long long) },
+            { "unsigned",           "uint",   sizeof(unsigned),           alignof(unsigned) },
+            { "uint64_t",           "ulong",  sizeof(uint64_t),           alignof(uint64_t) },
+            { "uint32_t",           "uint",   sizeof(uint32_t),           alignof(uint32_t) },
+            { "uint16_t",           "ushort", sizeof(uint16_t),           alignof(uint16_t) },
+            { "uint8_t",            "uchar",  sizeof(uint8_t),            alignof(uint8_t) },
+            { "int64_t",            "long",   sizeof(int64_t),            alignof(int64_t) },
+            { "int32_t",            "int",    sizeof(int32_t),            alignof(int32_t) },
+            { "int16_t",            "short",  sizeof(int16_t),            alignof(int16_t) },
+            { "int8_t",             "char",   sizeof(int8_t),             alignof(int8_t) },
+            { "double",             "double", sizeof(double),             alignof(double) },
+            { "float",              "float",  sizeof(float),              alignof(float) },
+            { "short",              "short",  sizeof(short),              alignof(short) },
+            { "char",               "char",   sizeof(char),               alignof(char) },
+            { "int",                "int",    sizeof(int),                alignof(int) },
+        }};
+
+        std::string_view trim(std::string_view s) {
+            while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+            while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+            return s;
+        }
+
+        bool isIdentifierChar(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        // Collapses runs of whitespace, so "unsigned   int" matches.
+        std::string normalize(std::string_view s) {
+            std::string res;
+            for (char c : s) {
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    if (!res.empty() && res.back() != ' ') res += ' ';
+                } else {
+                    res += c;
+                }
+            }
+            return std::string(trim(res));
+        }
+
+        void unsupported(std::string_view declaration, std::string_view why) {
+            HWR_FATAL("HWR_STRUCT layout - can't reflect '" + std::string(declaration) + "': "
+                      + std::string(why));
+        }
+
+        FieldLayout parseDeclaration(std::string_view declaration) {
+            std::string d = normalize(declaration);
+            if (d.starts_with("std::")) {
+                d.erase(0, 5);
+            }
+            const ScalarType* type = nullptr;
+            for (const ScalarType& t : SCALAR_TYPES) {
+                if (d.starts_with(t.spelling) && d.size() > t.spelling.size()
+                    && !isIdentifierChar(d[t.spelling.size()])) {
+                    type = &t;
+                    break;
+                }
+            }
+            if (type == nullptr) {
+                unsupported(declaration, "only scalar fields and arrays of them are supported");
+                return {};
+            }
+
+            FieldLayout f;
+            f.type = type->opencl;
+            f.elementSize = type->size;
+            f.alignment = type->alignment;
+
+            std::string_view rest = trim(std::string_view(d).substr(type->spelling.size()));
+            size_t n = 0;
+            while (n < rest.size() && isIdentifierChar(rest[n])) ++n;
+            if (n == 0 || std::isdigit(static_cast<unsigned char>(rest[0]))) {
+                unsupported(declaration, "expected a field name");
+                return {};
+            }
+            f.name = std::string(rest.substr(0, n));
+            rest = trim(rest.substr(n));
+
+            // Array extents, [4] or [4][4], integer literals only.
+            while (!rest.empty()) {
+                const size_t close = rest.find(']');
+                if (rest.front() != '[' || close == std::string_view::npos) {
+                    unsupported(declaration, "one field per declaration, arrays with literal sizes");
+                    return {};
+                }
+                const std::string_view extent = trim(rest.substr(1, close - 1));
+                if (extent.empty() || !std::all_of(extent.begin(), extent.end(),
+                        [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; })) {
+                    unsupported(declaration, "array sizes must be integer literals");
+                    return {};
+                }
+                f.count *= std::stoul(std::string(extent));
+                rest = trim(rest.substr(close + 1));
+            }
+            if (f.count == 0) {
+                unsupported(declaration, "zero-sized array");
+            }
+            return f;
+        }
+
+        size_t alignUp(size_t v, size_t alignment) {
+            return (v + alignment - 1) / alignment * alignment;
+        }
+
+        std::string describe(const StructLayout& layout) {
+            std::string res = layout.name + " (" + std::to_string(layout.size) + " bytes):";
+            for (const FieldLayout& f : layout.fields) {
+                res += " " + f.name + "@" + std::to_string(f.offset);
+            }
+            return res;
+        }
+
+        constexpr const char* PROBE_ENTRY = "hwr_layout_probe";
+
+    }
+
+    const FieldLayout* StructLayout::field(std::string_view fieldName) const {
+        for (const FieldLayout& f : fields) {
+            if (f.name == fieldName) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t StructLayout::padding() const {
+        size_t used = 0;
+        for (const FieldLayout& f : fields) {
+            used += f.size();
+        }
+        return size - std::min(used, size);
+    }
+
+    size_t StructLayout::packedSize() const {
+        std::vector<const FieldLayout*> sorted;
+        size_t maxAlignment = 1;
+        for (const FieldLayout& f : fields) {
+            sorted.push_back(&f);
+            maxAlignment = std::max(maxAlignment, f.alignment);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const FieldLayout* a, const FieldLayout* b) { return a->alignment > b->alignment; });
+        size_t offset = 0;
+        for (const FieldLayout* f : sorted) {
+            offset = alignUp(offset, f->alignment) + f->size();
+        }
+        return alignUp(offset, maxAlignment);
+    }
+
+    namespace detail {
+
+        std::vector<FieldLayout> parseStructFields(std::string_view fields) {
+            std::vector<FieldLayout> res;
+            size_t start = 0;
+            while (start < fields.size()) {
+                size_t end = fields.find(';', start);
+                if (end == std::string_view::npos) {
+                    end = fields.size();
+                }
+                const std::string_view declaration = trim(fields.substr(start, end - start));
+                if (!declaration.empty()) {
+                    FieldLayout f = parseDeclaration(declaration);
+                    for (const FieldLayout& g : res) {
+                        if (g.name == f.name) {
+                            unsupported(declaration, "duplicate field name");
+                        }
+                    }
+                    res.push_back(std::move(f));
+                }
+                start = end + 1;
+            }
+            return res;
+        }
+
+        StructLayout hostStructLayout(std::string_view name, std::string_view fields,
+                                      size_t size, size_t alignment)
+        {
+            StructLayout layout;
+            layout.name = std::string(name);
+            layout.size = size;
+            layout.fields = parseStructFields(fields);
+
+            size_t offset = 0;
+            size_t maxAlignment = 1;
+            for (FieldLayout& f : layout.fields) {
+                f.offset = alignUp(offset, f.alignment);
+                offset = f.offset + f.size();
+                maxAlignment = std::max(maxAlignment, f.alignment);
+            }
+            if (alignUp(offset, maxAlignment) != size || maxAlignment != alignment) {
+                HWR_FATAL("HWR_STRUCT layout - reflected " + describe(layout)
+                          + " disagrees with the compiler: sizeof " + std::to_string(size)
+                          + ", alignof " + std::to_string(alignment));
+            }
+            return layout;
+        }
+
+        std::string makeLayoutProbeSource(const std::string& structDefs,
+                                          const std::vector<const StructLayout*>& hostLayouts)
+        {
+            // Per struct: its size, then one offset per field, as uints.
+            bool fp64 = false;
+            size_t slot = 0;
+            std::string body;
+            for (const StructLayout* layout : hostLayouts) {
+                const std::string S = "struct " + layout->name;
+                body += "    {\n"
+                        "        " + S + " s;\n"
+                        "        __private const char* base = (__private const char*)&s;\n"
+                        "        out[" + std::to_string(slot++) + "] = (uint)sizeof(" + S + ");\n";
+                for (const FieldLayout& f : layout->fields) {
+                    body += "        out[" + std::to_string(slot++) + "] = (uint)((__private const char*)&s."
+                            + f.name + " - base);\n";
+                    fp64 = fp64 || f.type == "double";
+                }
+                body += "    }\n";
+            }
+
+            std::string src = fp64 ? "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n" : "";
+            src += OPENCL_STDINT_PRELUDE;
+            src += structDefs;
+            src += "__kernel void " + std::string(PROBE_ENTRY) + "(__global uint* out)\n"
+                   "{\n"
+                   "    if (get_global_id(0) != 0) return;\n";
+            src += body;
+            src += "}\n";
+            return src;
+        }
+
+        std::vector<StructLayout> probeDeviceLayouts(const GPUContext& ctx,
+                                                     const std::string& structDefs,
+                                                     const std::vector<const StructLayout*>& hostLayouts)
+        {
+            size_t slots = 0;
+            for (const StructLayout* layout : hostLayouts) {
+                slots += 1 + layout->fields.size();
+            }
+            Kernel probe(ctx, makeLayoutProbeSource(structDefs, hostLayouts), PROBE_ENTRY);
+            cl_int err = CL_SUCCESS;
+            cl::Buffer out(ctx.getContext(), CL_MEM_WRITE_ONLY, slots * sizeof(cl_uint), nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "probeDeviceLayouts - allocation");
+            probe.setArg(0, out);
+            probe.dispatch(cl::NDRange(1));
+
+            std::vector<cl_uint> measured(slots);
+            err = ctx.getQueue().enqueueReadBuffer(out, CL_TRUE, 0, slots * sizeof(cl_uint), measured.data());
+            HWR_ASSERT_CL_OK(err, "probeDeviceLayouts - readback");
+
+            std::vector<StructLayout> res;
+            size_t slot = 0;
+            for (const StructLayout* layout : hostLayouts) {
+                StructLayout device = *layout;
+                device.size = measured[slot++];
+                for (FieldLayout& f : device.fields) {
+                    f.offset = measured[slot++];
+                }
+                res.push_back(std::move(device));
+            }
+            return res;
+        }
+
+        void verifyLayouts(const GPUContext& ctx, const std::string& structDefs,
+                           const std::vector<const StructLayout*>& hostLayouts)
+        {
+            const std::vector<StructLayout> device = probeDeviceLayouts(ctx, structDefs, hostLayouts);
+            for (size_t i = 0; i < hostLayouts.size(); ++i) {
+                const StructLayout& host = *hostLayouts[i];
+                bool same = host.size == device[i].size;
+                for (size_t k = 0; k < host.fields.size(); ++k) {
+                    same = same && host.fields[k].offset == device[i].fields[k].offset;
+                }
+                if (!same) {
+                    HWR_FATAL("HWR_STRUCT layout mismatch. Host " + describe(host)
+                              + "; device " + describe(device[i]));
+                }
+                const size_t packed = host.packedSize();
+                if (packed < host.size) {
+                    HWR_INFO_IN(LogModule::GPU,
+                                "{} has {} bytes of padding; fields ordered by decreasing alignment would take {} bytes instead of {}",
+                                host.name, host.padding(), packed, host.size);
+                }
+            }
+        }
+
+        SoAColumns::SoAColumns(const GPUContext& ctx, const StructLayout& layout, size_t elementCount)
+            : m_ctx(ctx)
+            , m_layout(layout)
+            , m_size(elementCount)
+        {
+            if (elementCount == 0) {
+                HWR_FATAL("SoABuffer - element count must be non-zero");
+            }
+            for (const FieldLayout& f : layout.fields) {
+                const size_t bytes = f.size() * elementCount;
+                cl_int err = CL_SUCCESS;
+                m_columns.emplace_back(ctx.getContext(), CL_MEM_READ_WRITE, bytes, nullptr, &err);
+                HWR_ASSERT_CL_OK(err, "SoABuffer - allocation of " + f.name);
+                bufferMetrics().allocations.add();
+                bufferMetrics().allocatedBytes.add(bytes);
+            }
+        }
+
+        const cl::Buffer& SoAColumns::column(std::string_view fieldName) const {
+            for (size_t i = 0; i < m_columns.size(); ++i) {
+                if (m_layout.fields[i].name == fieldName) {
+                    return m_columns[i];
+                }
+            }
+            HWR_FATAL("SoABuffer - " + m_layout.name + " has no field " + std::string(fieldName));
+            return m_columns.front();
+        }
+
+        void SoAColumns::write(const std::byte* elements) {
+            const cl::CommandQueue queue = m_ctx.getQueue();
+            std::vector<std::byte> staging;
+            for (size_t c = 0; c < m_columns.size(); ++c) {
+                const FieldLayout& f = m_layout.fields[c];
+                staging.resize(f.size() * m_size);
+                for (size_t i = 0; i < m_size; ++i) {
+                    std::memcpy(staging.data() + i * f.size(), elements + i * m_layout.size + f.offset, f.size());
+                }
+                ProfiledCommand profiled(m_ctx, queue, "SoABuffer::writeFrom");
+                const cl_int err = queue.enqueueWriteBuffer(m_columns[c], CL_TRUE, 0, staging.size(),
+                                                            staging.data(), nullptr, profiled.event());
+                HWR_ASSERT_CL_OK(err, "SoABuffer::writeFrom - " + f.name);
+                bufferMetrics().uploadedBytes.add(staging.size());
+            }
+        }
+
+        void SoAColumns::read(std::byte* elements) const {
+            const cl::CommandQueue queue = m_ctx.getQueue();
+            std::vector<std::byte> staging;
+            for (size_t c = 0; c < m_columns.size(); ++c) {
+                const FieldLayout& f = m_layout.fields[c];
+                staging.resize(f.size() * m_size);
+                ProfiledCommand profiled(m_ctx, queue, "SoABuffer::readTo");
+                const cl_int err = queue.enqueueReadBuffer(m_columns[c], CL_TRUE, 0, staging.size(),
+                                                           staging.data(), nullptr, profiled.event());
+                HWR_ASSERT_CL_OK(err, "SoABuffer::readTo - " + f.name);
+                bufferMetrics().downloadedBytes.add(staging.size());
+                for (size_t i = 0; i < m_size; ++i) {
+                    std::memcpy(elements + i * m_layout.size + f.offset, staging.data() + i * f.size(), f.size());
+                }
+            }
+        }
+
+    } // namespace detail
+
+} // namespace hwr
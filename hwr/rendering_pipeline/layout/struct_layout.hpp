@@ -0,0 +1,202 @@
+#ifndef HWR_STRUCT_LAYOUT_HPP
+#define HWR_STRUCT_LAYOUT_HPP
+
+#include "../draw/instanced_draw.hpp"
+#include "../gpu/shader/work_group.hpp"
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hwr {
+
+// One member of an HWR_STRUCT, arrays included.
+struct FieldLayout {
+    std::string name;
+    std::string type;        // OpenCL spelling, e.g. "uint" for uint32_t
+    size_t elementSize = 0;  // one scalar
+    size_t alignment = 0;
+    size_t count = 1;        // array elements, 1 for scalars
+    size_t offset = 0;
+
+    size_t size() const { return elementSize * count; }
+};
+
+// Where the fields of an HWR_STRUCT sit, on the host or on a device.
+struct StructLayout {
+    std::string name;
+    size_t size = 0;
+    std::vector<FieldLayout> fields;
+
+    // nullptr if there is no such field.
+    const FieldLayout* field(std::string_view fieldName) const;
+
+    // Bytes not covered by any field.
+    size_t padding() const;
+
+    // Size with the same fields ordered by decreasing alignment, which
+    // leaves no padding between them.
+    size_t packedSize() const;
+};
+
+namespace detail {
+
+    // Reads the field list of an HWR_STRUCT. Only scalar members and arrays
+    // of them with constant sizes are supported; anything else is fatal.
+    std::vector<FieldLayout> parseStructFields(std::string_view fields);
+
+    // Offsets as the host compiler lays the fields out. Checked against
+    // the real size and alignment, so a field list the parser got wrong
+    // is fatal rather than silently misreported.
+    StructLayout hostStructLayout(std::string_view name, std::string_view fields,
+                                  size_t size, size_t alignment);
+
+    // Kernel writing, for each struct in turn, its size and then the offset
+    // of each of its fields.
+    std::string makeLayoutProbeSource(const std::string& structDefs,
+                                      const std::vector<const StructLayout*>& hostLayouts);
+
+    // Builds one kernel that measures every struct in hostLayouts on the
+    // device; structDefs must define all of them.
+    std::vector<StructLayout> probeDeviceLayouts(const GPUContext& ctx,
+                                                 const std::string& structDefs,
+                                                 const std::vector<const StructLayout*>& hostLayouts);
+
+    void verifyLayouts(const GPUContext& ctx, const std::string& structDefs,
+                       const std::vector<const StructLayout*>& hostLayouts);
+
+} // namespace detail
+
+template<ShaderStruct T>
+const StructLayout& hostLayout() {
+    static const StructLayout layout =
+        detail::hostStructLayout(T::opencl_name, T::opencl_fields, sizeof(T), alignof(T));
+    return layout;
+}
+
+template<ShaderStruct... Ts>
+std::vector<StructLayout> deviceLayouts(const GPUContext& ctx) {
+    return detail::probeDeviceLayouts(ctx, detail::compileStructDefs<Ts...>(),
+                                      { &hostLayout<Ts>()... });
+}
+
+/// Checks that every field of each struct has the same offset, and each
+/// struct the same size, on the host and on the context's device. Fatal on
+/// the first mismatch, with both layouts in the message. Structs that
+/// would shrink with their fields reordered are logged.
+/// Call it once at startup with the structs the renderer uploads.
+template<ShaderStruct... Ts>
+void verifyStructLayouts(const GPUContext& ctx) {
+    detail::verifyLayouts(ctx, detail::compileStructDefs<Ts...>(), { &hostLayout<Ts>()... });
+}
+
+namespace detail {
+
+    // Untyped storage of SoABuffer: one device buffer per field.
+    class SoAColumns {
+    public:
+        SoAColumns(const GPUContext& ctx, const StructLayout& layout, size_t elementCount);
+
+        size_t size() const { return m_size; }
+        size_t columnCount() const { return m_columns.size(); }
+        const std::string& columnName(size_t i) const { return m_layout.fields[i].name; }
+        const cl::Buffer& column(size_t i) const { return m_columns[i]; }
+        const cl::Buffer& column(std::string_view fieldName) const;
+
+        // elements is elementCount structs laid out as on the host.
+        void write(const std::byte* elements);
+        void read(std::byte* elements) const;
+
+    private:
+        const GPUContext& m_ctx;
+        const StructLayout& m_layout;
+        size_t m_size;
+        std::vector<cl::Buffer> m_columns;
+    };
+
+} // namespace detail
+
+/**
+* \class SoABuffer
+* \brief Device copy of an array of HWR_STRUCTs stored one field per
+*        buffer (structure of arrays).
+*
+* Each column is tightly packed: the padding of the struct is not
+* uploaded, and work-items reading the same field of consecutive elements
+* read consecutive addresses. Array fields keep their elements together,
+* column "color" of a float color[4] holds 4 floats per element.
+*
+* Bodies read it through soa_buffer<T>(name); binding it by that name
+* binds every column.
+*/
+template<ShaderStruct T>
+class SoABuffer {
+public:
+    SoABuffer(const GPUContext& ctx, size_t elementCount)
+        : m_columns(ctx, hostLayout<T>(), elementCount) {}
+
+    size_t size() const { return m_columns.size(); }
+    size_t columnCount() const { return m_columns.columnCount(); }
+    const std::string& columnName(size_t i) const { return m_columns.columnName(i); }
+    const cl::Buffer& column(size_t i) const { return m_columns.column(i); }
+    const cl::Buffer& column(std::string_view fieldName) const { return m_columns.column(fieldName); }
+
+    /// Splits data into the columns and uploads them. Blocking.
+    void writeFrom(std::span<const T> data) {
+        if (data.size() != size()) {
+            HWR_FATAL("SoABuffer::writeFrom - size mismatch");
+        }
+        m_columns.write(reinterpret_cast<const std::byte*>(data.data()));
+    }
+
+    /// Downloads the columns and interleaves them back. Blocking; bytes
+    /// of data that no field covers are left as they were.
+    void readTo(std::span<T> data) const {
+        if (data.size() != size()) {
+            HWR_FATAL("SoABuffer::readTo - size mismatch");
+        }
+        m_columns.read(reinterpret_cast<std::byte*>(data.data()));
+    }
+
+private:
+    detail::SoAColumns m_columns;
+};
+
+// Access to an SoABuffer<T> inside a shader body: field<F>("x")[i] is field
+// x of element i. Array fields are indexed i * count + k.
+template<ShaderStruct T>
+class SoAView {
+public:
+    explicit SoAView(std::string name) : m_name(std::move(name)) {}
+
+    template<AllowedShaderType F>
+    GlobalBuffer<F> field(const std::string& fieldName) const {
+        const FieldLayout* f = hostLayout<T>().field(fieldName);
+        if (f == nullptr) {
+            HWR_FATAL(std::string("SoAView - ") + T::opencl_name + " has no field " + fieldName);
+        } else if (f->type != opencl_type_name_v<F>) {
+            HWR_FATAL("SoAView - field " + fieldName + " is " + f->type + ", not "
+                      + std::string(opencl_type_name_v<F>));
+        }
+        return GlobalBuffer<F>(m_name + "_" + fieldName);
+    }
+
+private:
+    std::string m_name;
+};
+
+// Declares one __global parameter per field of T, named name_field, all
+// bound at once by binding an SoABuffer<T> to name.
+template<ShaderStruct T>
+SoAView<T> soa_buffer(const std::string& name) {
+    for (const FieldLayout& f : hostLayout<T>().fields) {
+        detail::program_context::declare_kernel_param(
+            name + "_" + f.name, "__global " + f.type + "* " + name + "_" + f.name);
+    }
+    return SoAView<T>(name);
+}
+
+} // namespace hwr
+
+#endif // HWR_STRUCT_LAYOUT_HPP
@@ -0,0 +1,69 @@
+#ifndef HWR_MESH_HPP
+#define HWR_MESH_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "./mesh_optimizer.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace hwr {
+
+/**
+* \class IndexedMesh
+* \brief Device-resident vertex buffer + triangle list index buffer.
+*
+* Vertices are meant to be transformed once each (e.g. with InstancedDraw,
+* which runs per vertex, not per index), after which later stages read the
+* transformed results through the index buffer. Optimizing on load keeps
+* both the index stream and those per-vertex reads local.
+*/
+template<typename Vertex>
+class IndexedMesh {
+public:
+    IndexedMesh(const GPUContext& ctx,
+                std::vector<Vertex> vertices,
+                std::vector<uint32_t> indices,
+                bool optimize = true,
+                uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE)
+        : IndexedMesh(ctx, prepare(std::move(vertices), std::move(indices),
+                                   optimize, cacheSize))
+    {}
+
+    size_t vertexCount() const { return m_vertices.size(); }
+    size_t indexCount() const { return m_indices.size(); }
+    size_t triangleCount() const { return m_indices.size() / 3; }
+
+    const ConstBuffer<Vertex>& vertices() const { return m_vertices; }
+    const ConstBuffer<uint32_t>& indices() const { return m_indices; }
+
+private:
+    struct HostData {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    IndexedMesh(const GPUContext& ctx, HostData data)
+        : m_vertices(ctx, data.vertices.size(), data.vertices)
+        , m_indices(ctx, data.indices.size(), data.indices)
+    {}
+
+    static HostData prepare(std::vector<Vertex> vertices,
+                            std::vector<uint32_t> indices,
+                            bool optimize, uint32_t cacheSize) {
+        if (vertices.empty() || indices.empty()) {
+            HWR_FATAL("IndexedMesh - mesh has no vertices or no indices");
+        }
+        if (optimize) {
+            // Also validates the indices.
+            optimizeMesh(vertices, indices, cacheSize);
+        }
+        return { std::move(vertices), std::move(indices) };
+    }
+
+    ConstBuffer<Vertex> m_vertices;
+    ConstBuffer<uint32_t> m_indices;
+};
+
+} // namespace hwr
+
+#endif // HWR_MESH_HPP
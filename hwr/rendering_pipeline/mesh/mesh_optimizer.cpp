@@ -0,0 +1,171 @@
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <deque>
+
+namespace hwr {
+
+    namespace {
+
+        constexpr uint32_t NO_VERTEX = UINT32_MAX;
+
+        // Vertex -> triangles adjacency, stored as one flat array.
+        struct Adjacency {
+            std::vector<uint32_t> offsets;   // vertexCount + 1
+            std::vector<uint32_t> triangles;
+        };
+
+        Adjacency buildAdjacency(std::span<const uint32_t> indices,
+                                 size_t vertexCount) {
+            Adjacency adj;
+            adj.offsets.assign(vertexCount + 1, 0);
+            for (uint32_t v : indices) {
+                ++adj.offsets[v + 1];
+            }
+            for (size_t v = 0; v < vertexCount; ++v) {
+                adj.offsets[v + 1] += adj.offsets[v];
+            }
+            adj.triangles.resize(indices.size());
+            std::vector<uint32_t> cursor(adj.offsets.begin(), adj.offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i) {
+                adj.triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+            return adj;
+        }
+
+        void validate(std::span<const uint32_t> indices, size_t vertexCount,
+                      const char* where) {
+            if (indices.size() % 3 != 0) {
+                HWR_FATAL(std::string(where) + " - index count is not a multiple of 3");
+            }
+            if (vertexCount >= NO_VERTEX) {
+                HWR_FATAL(std::string(where) + " - too many vertices");
+            }
+            for (uint32_t v : indices) {
+                if (v >= vertexCount) {
+                    HWR_FATAL(std::string(where) + " - index out of range");
+                }
+            }
+        }
+
+    }
+
+    void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount,
+                             uint32_t cacheSize) {
+        validate(indices, vertexCount, "optimizeVertexCache");
+        if (indices.empty()) {
+            return;
+        }
+        const Adjacency adj = buildAdjacency(indices, vertexCount);
+        const size_t triangleCount = indices.size() / 3;
+
+        std::vector<uint32_t> live(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            live[v] = adj.offsets[v + 1] - adj.offsets[v];
+        }
+        // A vertex is in the cache iff stamp - cacheTime[v] <= cacheSize.
+        std::vector<uint64_t> cacheTime(vertexCount, 0);
+        uint64_t stamp = cacheSize + 1;
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> out;
+        out.reserve(indices.size());
+        size_t cursor = 0; // next vertex to try when everything else is dead
+
+        uint32_t fanning = 0;
+        while (fanning != NO_VERTEX) {
+            candidates.clear();
+            for (uint32_t a = adj.offsets[fanning]; a < adj.offsets[fanning + 1]; ++a) {
+                const uint32_t t = adj.triangles[a];
+                if (emitted[t]) continue;
+                emitted[t] = true;
+                for (size_t c = 0; c < 3; ++c) {
+                    const uint32_t v = indices[3 * t + c];
+                    out.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    --live[v];
+                    if (stamp - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = stamp++;
+                    }
+                }
+            }
+
+            // Prefer a candidate still in cache after its remaining
+            // triangles are emitted; the oldest such one wins.
+            uint32_t best = NO_VERTEX;
+            uint64_t bestPriority = 0;
+            for (uint32_t v : candidates) {
+                if (live[v] == 0) continue;
+                uint64_t priority = 0;
+                const uint64_t age = stamp - cacheTime[v];
+                if (age + 2 * uint64_t{live[v]} <= cacheSize) {
+                    priority = age;
+                }
+                if (best == NO_VERTEX || priority > bestPriority) {
+                    best = v;
+                    bestPriority = priority;
+                }
+            }
+
+            if (best == NO_VERTEX) {
+                while (!deadEnd.empty() && best == NO_VERTEX) {
+                    const uint32_t v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (live[v] > 0) best = v;
+                }
+                while (best == NO_VERTEX && cursor < vertexCount) {
+                    if (live[cursor] > 0) best = static_cast<uint32_t>(cursor);
+                    ++cursor;
+                }
+            }
+            fanning = best;
+        }
+
+        HWR_ASSERT(out.size() == indices.size(),
+                   "optimizeVertexCache - not every triangle was emitted");
+        std::copy(out.begin(), out.end(), indices.begin());
+    }
+
+    std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices,
+                                              size_t vertexCount) {
+        validate(indices, vertexCount, "optimizeVertexFetch");
+        std::vector<uint32_t> remap(vertexCount, NO_VERTEX);
+        uint32_t next = 0;
+        for (uint32_t& v : indices) {
+            if (remap[v] == NO_VERTEX) {
+                remap[v] = next++;
+            }
+            v = remap[v];
+        }
+        for (uint32_t& r : remap) {
+            if (r == NO_VERTEX) {
+                r = next++;
+            }
+        }
+        return remap;
+    }
+
+    float averageCacheMissRatio(std::span<const uint32_t> indices,
+                                size_t vertexCount, uint32_t cacheSize) {
+        validate(indices, vertexCount, "averageCacheMissRatio");
+        if (indices.empty() || cacheSize == 0) {
+            return indices.empty() ? 0.0f : 3.0f;
+        }
+        std::deque<uint32_t> fifo;
+        std::vector<bool> cached(vertexCount, false);
+        size_t misses = 0;
+        for (uint32_t v : indices) {
+            if (cached[v]) continue;
+            ++misses;
+            fifo.push_back(v);
+            cached[v] = true;
+            if (fifo.size() > cacheSize) {
+                cached[fifo.front()] = false;
+                fifo.pop_front();
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    }
+
+} // namespace hwr
@@ -0,0 +1,73 @@
+#ifndef HWR_MESH_OPTIMIZER_HPP
+#define HWR_MESH_OPTIMIZER_HPP
+
+#include "../../util/jobs/thread_pool.hpp"
+#include "../../util/log/log.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+    // Typical post-transform cache size the reordering is tuned for.
+    inline constexpr uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+    // Reorders triangles (in place) for post-transform cache locality,
+    // using Tipsify (Sander, Nehab, Barczak 2007). Linear in index count.
+    void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount,
+                             uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    // Renumbers vertices in order of first use so fetches walk the vertex
+    // buffer front to back. Rewrites indices in place and returns the
+    // remap table (old index -> new index). Unreferenced vertices go last.
+    std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices,
+                                              size_t vertexCount);
+
+    // Average cache miss ratio (misses per triangle) of a FIFO cache.
+    // 3.0 is the worst case, ~0.6-0.7 is good for regular meshes.
+    float averageCacheMissRatio(std::span<const uint32_t> indices,
+                                size_t vertexCount,
+                                uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    // Applies a remap table from optimizeVertexFetch() to vertex data.
+    template<typename Vertex>
+    void remapVertices(std::vector<Vertex>& vertices,
+                       std::span<const uint32_t> remap) {
+        HWR_ASSERT(remap.size() == vertices.size(),
+                   "remapVertices - remap table size mismatch");
+        std::vector<Vertex> res(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            res[remap[i]] = vertices[i];
+        }
+        vertices = std::move(res);
+    }
+
+    // Both passes: triangle order first, then vertex order following it.
+    template<typename Vertex>
+    void optimizeMesh(std::vector<Vertex>& vertices,
+                      std::vector<uint32_t>& indices,
+                      uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE) {
+        optimizeVertexCache(indices, vertices.size(), cacheSize);
+        std::vector<uint32_t> remap = optimizeVertexFetch(indices, vertices.size());
+        remapVertices(vertices, remap);
+    }
+
+    // optimizeMesh() over many meshes, one job per mesh. vertices[i] goes
+    // with indices[i].
+    template<typename Vertex>
+    void optimizeMeshes(ThreadPool& pool,
+                        std::span<std::vector<Vertex>> vertices,
+                        std::span<std::vector<uint32_t>> indices,
+                        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE) {
+        HWR_ASSERT(vertices.size() == indices.size(),
+                   "optimizeMeshes - vertex and index list counts differ");
+        pool.parallelFor(vertices.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                optimizeMesh(vertices[i], indices[i], cacheSize);
+            }
+        });
+    }
+
+} // namespace hwr
+
+#endif // HWR_MESH_OPTIMIZER_HPP
@@ -0,0 +1,253 @@
+#include "scene_file.hpp"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace hwr {
+
+    namespace {
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        bool validateLayout(const std::byte* data, size_t size,
+                            std::vector<SceneChunkDesc>& chunks,
+                            [[maybe_unused]] const std::string& path) {
+            if (size < sizeof(SceneFileHeader)) {
+                HWR_ERR("Scene file too small: " + path);
+                return false;
+            }
+            SceneFileHeader header;
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, SCENE_FILE_MAGIC, 4) != 0) {
+                HWR_ERR("Not a scene file: " + path);
+                return false;
+            }
+            if (header.version != SCENE_FILE_VERSION) {
+                HWR_ERR("Unsupported scene file version "
+                        + std::to_string(header.version) + ": " + path);
+                return false;
+            }
+            if (header.tableOffset > size
+                || header.chunkCount > (size - header.tableOffset) / sizeof(SceneChunkDesc)) {
+                HWR_ERR("Scene file chunk table out of bounds: " + path);
+                return false;
+            }
+            chunks.resize(static_cast<size_t>(header.chunkCount));
+            std::memcpy(chunks.data(), data + header.tableOffset,
+                        chunks.size() * sizeof(SceneChunkDesc));
+            for (const SceneChunkDesc& c : chunks) {
+                if (c.elementSize == 0
+                    || c.elementCount > UINT64_MAX / c.elementSize
+                    || c.offset > size
+                    || c.byteSize() > size - c.offset) {
+                    HWR_ERR("Scene file chunk out of bounds: " + path);
+                    return false;
+                }
+                // The mapping is page aligned, so this aligns the data.
+                if (c.offset % SCENE_CHUNK_MIN_ALIGNMENT != 0) {
+                    HWR_ERR("Scene file chunk misaligned: " + path);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    }
+
+    std::optional<MappedSceneFile> MappedSceneFile::open(const std::string& path) {
+        MappedSceneFile file;
+    #ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                    nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            HWR_ERR("Failed to open scene file: " + path);
+            return std::nullopt;
+        }
+        file.m_file = handle;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+            HWR_ERR("Failed to stat scene file: " + path);
+            return std::nullopt;
+        }
+        file.m_size = static_cast<size_t>(size.QuadPart);
+        file.m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!file.m_mapping) {
+            HWR_ERR("Failed to map scene file: " + path);
+            return std::nullopt;
+        }
+        file.m_data = static_cast<const std::byte*>(
+            MapViewOfFile(file.m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!file.m_data) {
+            HWR_ERR("Failed to map scene file: " + path);
+            return std::nullopt;
+        }
+    #else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            HWR_ERR("Failed to open scene file: " + path);
+            return std::nullopt;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            HWR_ERR("Failed to stat scene file: " + path);
+            return std::nullopt;
+        }
+        file.m_size = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (mapped == MAP_FAILED) {
+            HWR_ERR("Failed to map scene file: " + path);
+            return std::nullopt;
+        }
+        file.m_data = static_cast<const std::byte*>(mapped);
+    #endif
+        if (!validateLayout(file.m_data, file.m_size, file.m_chunks, path)) {
+            return std::nullopt;
+        }
+        return file;
+    }
+
+    MappedSceneFile::MappedSceneFile(MappedSceneFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedSceneFile& MappedSceneFile::operator=(MappedSceneFile&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_chunks = std::move(other.m_chunks);
+        #ifdef _WIN32
+            m_file = std::exchange(other.m_file, nullptr);
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+        #endif
+        }
+        return *this;
+    }
+
+    MappedSceneFile::~MappedSceneFile() {
+        release();
+    }
+
+    void MappedSceneFile::release() {
+    #ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file) CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = nullptr;
+    #else
+        if (m_data) {
+            munmap(const_cast<std::byte*>(m_data), m_size);
+        }
+    #endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    std::optional<size_t> MappedSceneFile::findChunk(SceneChunkKind kind, uint64_t id) const {
+        for (size_t i = 0; i < m_chunks.size(); ++i) {
+            if (m_chunks[i].kind == kind && m_chunks[i].id == id) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::span<const std::byte> MappedSceneFile::chunkBytes(size_t chunk) const {
+        const SceneChunkDesc& desc = chunkDesc(chunk);
+        return { m_data + desc.offset, static_cast<size_t>(desc.byteSize()) };
+    }
+
+    void MappedSceneFile::prefetch(size_t chunk, size_t byteOffset, size_t byteCount) const {
+        std::span<const std::byte> bytes = chunkBytes(chunk);
+        if (byteOffset >= bytes.size()) {
+            return;
+        }
+        byteCount = std::min(byteCount, bytes.size() - byteOffset);
+    #ifdef _WIN32
+        WIN32_MEMORY_RANGE_ENTRY range{
+            const_cast<std::byte*>(bytes.data() + byteOffset), byteCount
+        };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    #else
+        // madvise wants a page aligned start.
+        const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto start = reinterpret_cast<uintptr_t>(bytes.data() + byteOffset);
+        const uintptr_t alignedStart = start / pageSize * pageSize;
+        madvise(reinterpret_cast<void*>(alignedStart),
+                byteCount + (start - alignedStart), MADV_WILLNEED);
+    #endif
+    }
+
+    bool SceneFileWriter::write(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            HWR_ERR("Failed to open scene file for writing: " + path);
+            return false;
+        }
+
+        std::vector<SceneChunkDesc> table;
+        table.reserve(m_chunks.size());
+        uint64_t offset = alignUp(sizeof(SceneFileHeader)
+                                  + m_chunks.size() * sizeof(SceneChunkDesc),
+                                  SCENE_CHUNK_ALIGNMENT);
+        for (const PendingChunk& c : m_chunks) {
+            SceneChunkDesc desc = c.desc;
+            desc.offset = offset;
+            table.push_back(desc);
+            offset = alignUp(offset + desc.byteSize(), SCENE_CHUNK_ALIGNMENT);
+        }
+
+        SceneFileHeader header{};
+        std::memcpy(header.magic, SCENE_FILE_MAGIC, 4);
+        header.version = SCENE_FILE_VERSION;
+        header.chunkCount = table.size();
+        header.tableOffset = sizeof(SceneFileHeader);
+
+        auto writeBytes = [&out](const void* data, size_t count) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(count));
+        };
+        auto padTo = [&](uint64_t target) {
+            static const char zeros[SCENE_CHUNK_ALIGNMENT] = {};
+            auto pos = static_cast<uint64_t>(out.tellp());
+            while (pos < target) {
+                const uint64_t n = std::min<uint64_t>(target - pos, sizeof(zeros));
+                writeBytes(zeros, static_cast<size_t>(n));
+                pos += n;
+            }
+        };
+
+        writeBytes(&header, sizeof(header));
+        writeBytes(table.data(), table.size() * sizeof(SceneChunkDesc));
+        for (size_t i = 0; i < m_chunks.size(); ++i) {
+            padTo(table[i].offset);
+            writeBytes(m_chunks[i].bytes.data(), m_chunks[i].bytes.size());
+        }
+        // Pad the tail too, so the last chunk's pages are fully backed.
+        padTo(offset);
+
+        if (!out) {
+            HWR_ERR("Failed to write scene file: " + path);
+            return false;
+        }
+        return true;
+    }
+
+} // namespace hwr
@@ -0,0 +1,142 @@
+#ifndef HWR_SCENE_FILE_HPP
+#define HWR_SCENE_FILE_HPP
+
+#include "../../util/log/log.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace hwr {
+
+/*
+* Binary scene file layout (native endianness, little-endian in practice):
+*
+*   SceneFileHeader
+*   SceneChunkDesc[chunkCount]      at header.tableOffset
+*   chunk payloads                  each at a SCENE_CHUNK_ALIGNMENT offset
+*
+* Payloads are raw arrays of trivially copyable elements, so a mapped
+* chunk can be handed to OpenCL as-is. The alignment keeps mapped chunks
+* page aligned, which CL_MEM_USE_HOST_PTR needs to avoid a hidden copy.
+*/
+
+inline constexpr char SCENE_FILE_MAGIC[4] = {'H', 'W', 'R', 'S'};
+inline constexpr uint32_t SCENE_FILE_VERSION = 1;
+inline constexpr uint64_t SCENE_CHUNK_ALIGNMENT = 4096;
+// What a file must at least keep for chunks to be read as typed spans:
+// enough for any scalar or 4-wide vector element.
+inline constexpr uint64_t SCENE_CHUNK_MIN_ALIGNMENT = 16;
+
+enum class SceneChunkKind : uint32_t {
+    VERTICES  = 0,
+    INDICES   = 1,
+    INSTANCES = 2,
+    USER      = 0x1000, // anything application specific
+};
+
+struct SceneFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t chunkCount;
+    uint64_t tableOffset;
+};
+
+struct SceneChunkDesc {
+    SceneChunkKind kind;
+    uint32_t elementSize;
+    uint64_t id;            // e.g. mesh index; pairs VERTICES with INDICES
+    uint64_t elementCount;
+    uint64_t offset;        // from the start of the file
+
+    uint64_t byteSize() const { return elementCount * elementSize; }
+};
+
+static_assert(sizeof(SceneFileHeader) == 24, "SceneFileHeader layout changed");
+static_assert(sizeof(SceneChunkDesc) == 32, "SceneChunkDesc layout changed");
+
+/**
+* \class MappedSceneFile
+* \brief Read-only memory mapping of a scene file. Chunks are spans into
+*        the mapping: nothing is read until it is touched.
+*/
+class MappedSceneFile {
+public:
+    /// Maps and validates a scene file. std::nullopt (and a logged error)
+    /// if it can't be opened or is malformed.
+    static std::optional<MappedSceneFile> open(const std::string& path);
+
+    MappedSceneFile(MappedSceneFile&& other) noexcept;
+    MappedSceneFile& operator=(MappedSceneFile&& other) noexcept;
+    MappedSceneFile(const MappedSceneFile&) = delete;
+    MappedSceneFile& operator=(const MappedSceneFile&) = delete;
+    ~MappedSceneFile();
+
+    size_t chunkCount() const { return m_chunks.size(); }
+    const SceneChunkDesc& chunkDesc(size_t chunk) const { return m_chunks.at(chunk); }
+    std::optional<size_t> findChunk(SceneChunkKind kind, uint64_t id) const;
+
+    std::span<const std::byte> chunkBytes(size_t chunk) const;
+
+    template<typename T>
+    std::span<const T> chunk(size_t index) const {
+        const SceneChunkDesc& desc = chunkDesc(index);
+        if (desc.elementSize != sizeof(T)) {
+            HWR_FATAL("MappedSceneFile::chunk - element size mismatch");
+        }
+        HWR_ASSERT(desc.offset % alignof(T) == 0, "MappedSceneFile::chunk - misaligned chunk");
+        return { reinterpret_cast<const T*>(m_data + desc.offset),
+                 static_cast<size_t>(desc.elementCount) };
+    }
+
+    /// Hints the OS to start reading part of a chunk in the background.
+    void prefetch(size_t chunk, size_t byteOffset, size_t byteCount) const;
+
+    size_t fileSize() const { return m_size; }
+
+private:
+    MappedSceneFile() = default;
+    void release();
+
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<SceneChunkDesc> m_chunks;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+/**
+* \class SceneFileWriter
+* \brief Collects chunks and writes them in the mappable layout above.
+*        The data is referenced, not copied: keep it alive until write().
+*/
+class SceneFileWriter {
+public:
+    template<typename T>
+    void addChunk(SceneChunkKind kind, uint64_t id, std::span<const T> data) {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "Scene chunks must be trivially copyable");
+        m_chunks.push_back({
+            SceneChunkDesc{kind, static_cast<uint32_t>(sizeof(T)), id, data.size(), 0},
+            { reinterpret_cast<const std::byte*>(data.data()), data.size_bytes() }
+        });
+    }
+
+    /// Returns false (and logs) on I/O failure.
+    bool write(const std::string& path) const;
+
+private:
+    struct PendingChunk {
+        SceneChunkDesc desc;
+        std::span<const std::byte> bytes;
+    };
+    std::vector<PendingChunk> m_chunks;
+};
+
+} // namespace hwr
+
+#endif // HWR_SCENE_FILE_HPP
@@ -0,0 +1,144 @@
+#include "scene_streamer.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+#include <algorithm>
+
+namespace hwr {
+
+    namespace {
+
+        // Zero copy only pays off (and only stays zero copy) if the device
+        // reads host memory directly and the chunks satisfy its alignment.
+        bool canWrapHostMemory(const GPUContext& ctx, const MappedSceneFile& file) {
+            cl::Device device = ctx.getDevice();
+            const bool shared = device.getInfo<CL_DEVICE_TYPE>() == CL_DEVICE_TYPE_CPU
+                             || device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() == CL_TRUE;
+            if (!shared) {
+                return false;
+            }
+            // Reported in bits.
+            const size_t align = device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;
+            for (size_t i = 0; i < file.chunkCount(); ++i) {
+                auto address = reinterpret_cast<uintptr_t>(file.chunkBytes(i).data());
+                if (align != 0 && address % align != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    }
+
+    SceneStreamer::SceneStreamer(const GPUContext& ctx, const MappedSceneFile& file,
+                                 size_t sliceBytes)
+        : m_ctx(ctx)
+        , m_file(file)
+        , m_queue(ctx.createQueue())
+        , m_sliceBytes(std::max<size_t>(sliceBytes, 1))
+        , m_zeroCopy(canWrapHostMemory(ctx, file))
+        , m_chunks(file.chunkCount())
+    {
+        for (size_t i = 0; i < file.chunkCount(); ++i) {
+            std::span<const std::byte> bytes = file.chunkBytes(i);
+            // Zero sized buffers are invalid in OpenCL.
+            const size_t size = std::max<size_t>(bytes.size(), 1);
+            cl_int err = CL_SUCCESS;
+            if (m_zeroCopy && !bytes.empty()) {
+                // The mapping is read-only, so is the buffer.
+                m_chunks[i].buffer = cl::Buffer(
+                    ctx.getContext(),
+                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR | CL_MEM_HOST_NO_ACCESS,
+                    size,
+                    const_cast<void*>(static_cast<const void*>(bytes.data())),
+                    &err
+                );
+                m_chunks[i].uploaded = bytes.size();
+            } else {
+                m_chunks[i].buffer = cl::Buffer(
+                    ctx.getContext(),
+                    CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                    size, nullptr, &err
+                );
+                if (!bytes.empty()) {
+                    m_pending.push_back(i);
+                }
+            }
+            HWR_ASSERT_CL_OK(err, "SceneStreamer - chunk buffer");
+            m_bytesTotal += bytes.size();
+        }
+        if (m_zeroCopy) {
+            m_bytesEnqueued = m_bytesTotal;
+            HWR_INFO("SceneStreamer: device shares host memory, using mapped file directly");
+        }
+        if (!m_pending.empty()) {
+            m_file.prefetch(m_pending.front(), 0, m_sliceBytes);
+        }
+    }
+
+    SceneStreamer::~SceneStreamer() {
+        // Writes in flight still read from the mapping.
+        m_queue.finish();
+    }
+
+    bool SceneStreamer::isFullyEnqueued(size_t chunk) const {
+        return m_chunks[chunk].uploaded >= m_file.chunkBytes(chunk).size();
+    }
+
+    bool SceneStreamer::stream(size_t byteBudget) {
+        size_t spent = 0;
+        // Always at least one slice, so a tiny budget still makes progress.
+        while (!m_pending.empty() && (spent == 0 || spent < byteBudget)) {
+            const size_t chunk = m_pending.front();
+            ChunkState& state = m_chunks[chunk];
+            std::span<const std::byte> bytes = m_file.chunkBytes(chunk);
+
+            const size_t count = std::min(m_sliceBytes, bytes.size() - state.uploaded);
+            cl_int err = m_queue.enqueueWriteBuffer(
+                state.buffer, CL_FALSE, state.uploaded, count,
+                bytes.data() + state.uploaded, nullptr, &state.last
+            );
+            HWR_ASSERT_CL_OK(err, "SceneStreamer::stream - enqueueWriteBuffer");
+            if (GPUProfiler* profiler = m_ctx.profiler()) {
+                profiler->record("SceneStreamer upload", m_queue(), state.last);
+            }
+            state.uploaded += count;
+            spent += count;
+            m_bytesEnqueued += count;
+
+            if (isFullyEnqueued(chunk)) {
+                m_pending.pop_front();
+            }
+            // Let the OS fault in the next slice while this one uploads.
+            if (!m_pending.empty()) {
+                const size_t next = m_pending.front();
+                m_file.prefetch(next, m_chunks[next].uploaded, m_sliceBytes);
+            }
+        }
+        m_queue.flush();
+        return !m_pending.empty();
+    }
+
+    void SceneStreamer::prioritize(size_t chunk) {
+        auto it = std::find(m_pending.begin(), m_pending.end(), chunk);
+        if (it != m_pending.end()) {
+            m_pending.erase(it);
+            m_pending.push_front(chunk);
+        }
+    }
+
+    bool SceneStreamer::isResident(size_t chunk) const {
+        if (!isFullyEnqueued(chunk)) {
+            return false;
+        }
+        const ChunkState& state = m_chunks.at(chunk);
+        if (state.last() == nullptr) {
+            return true; // zero copy or empty
+        }
+        return state.last.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() == CL_COMPLETE;
+    }
+
+    void SceneStreamer::finish() {
+        while (stream(SIZE_MAX)) {}
+        m_queue.finish();
+    }
+
+} // namespace hwr
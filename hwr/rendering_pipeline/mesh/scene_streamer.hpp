@@ -0,0 +1,79 @@
+#ifndef HWR_SCENE_STREAMER_HPP
+#define HWR_SCENE_STREAMER_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "./scene_file.hpp"
+#include <deque>
+#include <vector>
+
+namespace hwr {
+
+inline constexpr size_t DEFAULT_STREAM_SLICE_BYTES = size_t{16} << 20;
+
+/**
+* \class SceneStreamer
+* \brief Uploads the chunks of a MappedSceneFile to the device in slices,
+*        straight from the mapping, on a queue of its own.
+*
+* Call stream() once per frame with a byte budget and render whatever
+* isResident() already. On devices sharing memory with the host the
+* chunks are wrapped with CL_MEM_USE_HOST_PTR instead and are resident
+* right away. The file must outlive the streamer.
+*/
+class SceneStreamer {
+public:
+    SceneStreamer(const GPUContext& ctx, const MappedSceneFile& file,
+                  size_t sliceBytes = DEFAULT_STREAM_SLICE_BYTES);
+
+    SceneStreamer(const SceneStreamer&) = delete;
+    SceneStreamer& operator=(const SceneStreamer&) = delete;
+    ~SceneStreamer();
+
+    /// Enqueues roughly byteBudget more bytes of uploads (at least one slice).
+    /// Returns true while there is anything left to enqueue.
+    bool stream(size_t byteBudget);
+
+    /// Moves a chunk to the front of the upload order.
+    void prioritize(size_t chunk);
+
+    bool isResident(size_t chunk) const;
+    /// Blocks until every chunk is resident.
+    void finish();
+
+    bool isZeroCopy() const { return m_zeroCopy; }
+    size_t bytesEnqueued() const { return m_bytesEnqueued; }
+    size_t bytesTotal() const { return m_bytesTotal; }
+
+    template<typename T>
+    BufferView<T> buffer(size_t chunk) const {
+        const SceneChunkDesc& desc = m_file.chunkDesc(chunk);
+        if (desc.elementSize != sizeof(T)) {
+            HWR_FATAL("SceneStreamer::buffer - element size mismatch");
+        }
+        return BufferView<T>(m_ctx, m_chunks.at(chunk).buffer,
+                             static_cast<size_t>(desc.elementCount));
+    }
+
+private:
+    struct ChunkState {
+        cl::Buffer buffer;
+        size_t uploaded = 0;  // bytes enqueued so far
+        cl::Event last;       // the queue is in order: last done => all done
+    };
+
+    bool isFullyEnqueued(size_t chunk) const;
+
+    const GPUContext& m_ctx;
+    const MappedSceneFile& m_file;
+    cl::CommandQueue m_queue;
+    size_t m_sliceBytes;
+    bool m_zeroCopy = false;
+    std::vector<ChunkState> m_chunks;
+    std::deque<size_t> m_pending;
+    size_t m_bytesEnqueued = 0;
+    size_t m_bytesTotal = 0;
+};
+
+} // namespace hwr
+
+#endif // HWR_SCENE_STREAMER_HPP
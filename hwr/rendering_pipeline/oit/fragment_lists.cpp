@@ -0,0 +1,216 @@
+#include "fragment_lists.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+
+namespace hwr {
+
+    namespace {
+
+        const char* OIT_FRAGMENT_TYPE = R"CLC(
+typedef struct {
+    uint color;
+    float depth;
+    uint next;
+} OitFragment;
+)CLC";
+
+        // Keeps the HWR_OIT_MAX_LAYERS nearest fragments sorted near to far
+        // in private memory, then blends them far to near. Links always
+        // point below capacity or are OIT_END, which never is.
+        const char* OIT_RESOLVE_BODY = R"CLC(
+    const size_t hwr_pixel = get_global_id(0);
+    if (hwr_pixel >= pixelCount) return;
+    uint colors[HWR_OIT_MAX_LAYERS];
+    float depths[HWR_OIT_MAX_LAYERS];
+    uint n = 0;
+    for (uint i = heads[hwr_pixel]; i < capacity; i = fragments[i].next) {
+        const OitFragment f = fragments[i];
+        if (n == HWR_OIT_MAX_LAYERS && f.depth >= depths[n - 1]) continue;
+        uint k = n < HWR_OIT_MAX_LAYERS ? n++ : HWR_OIT_MAX_LAYERS - 1;
+        while (k > 0 && depths[k - 1] > f.depth) {
+            depths[k] = depths[k - 1];
+            colors[k] = colors[k - 1];
+            --k;
+        }
+        depths[k] = f.depth;
+        colors[k] = f.color;
+    }
+    if (n == 0) return;
+)CLC";
+
+        cl::Buffer makeBuffer(const GPUContext& ctx, size_t bytes) {
+            cl_int err = CL_SUCCESS;
+            cl::Buffer buffer(ctx.getContext(), CL_MEM_READ_WRITE, bytes, nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "FragmentLists - allocation");
+            return buffer;
+        }
+
+        std::string makeResolveSource(ColorFormat format, uint32_t maxLayers) {
+            if (maxLayers == 0 || maxLayers > OitResolve::MAX_LAYERS) {
+                HWR_FATAL("OitResolve - maxLayers must be in [1, OitResolve::MAX_LAYERS]");
+            }
+            std::string src = "#define HWR_OIT_MAX_LAYERS " + std::to_string(maxLayers) + "u\n";
+            src += OIT_FRAGMENT_TYPE;
+            src += "__kernel void hwr_oit_resolve(__global const uint* heads,\n"
+                   "    __global const OitFragment* fragments, const uint capacity,\n"
+                   "    const uint pixelCount, " + std::string(detail::colorPointerType(format))
+                   + " hwr_target)\n"
+                   "{\n";
+            src += OIT_RESOLVE_BODY;
+            src += "    float4 hwr_color = " + std::string(detail::colorLoad(format)) + ";\n"
+                   "    for (uint k = n; k-- > 0;) {\n"
+                   "        const float4 src = convert_float4(as_uchar4(colors[k])) / 255.0f;\n"
+                   "        hwr_color = (float4)(mix(hwr_color.xyz, src.xyz, src.w),\n"
+                   "                             src.w + hwr_color.w * (1.0f - src.w));\n"
+                   "    }\n"
+                   "    ";
+            src += detail::colorStore(format);
+            src += "}\n";
+            return src;
+        }
+
+    }
+
+    FragmentLists::FragmentLists(const GPUContext& ctx, uint32_t width, uint32_t height, size_t capacity)
+        : m_ctx(ctx)
+        , m_width(width)
+        , m_height(height)
+        , m_capacity(capacity)
+    {
+        if (width == 0 || height == 0 || capacity == 0) {
+            HWR_FATAL("FragmentLists - width, height and capacity must be non-zero");
+        }
+        if (capacity >= OIT_END) {
+            HWR_FATAL("FragmentLists - capacity must fit fragment links in 32 bits");
+        }
+        m_heads = makeBuffer(ctx, pixelCount() * sizeof(uint32_t));
+        m_fragments = makeBuffer(ctx, capacity * sizeof(OitFragment));
+        m_counter = makeBuffer(ctx, sizeof(uint32_t));
+    }
+
+    void FragmentLists::clear() {
+        cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiledHeads(m_ctx, queue, "FragmentLists::clear heads");
+        cl_int err = queue.enqueueFillBuffer(m_heads, OIT_END, 0, pixelCount() * sizeof(uint32_t),
+                                             nullptr, profiledHeads.event());
+        HWR_ASSERT_CL_OK(err, "FragmentLists::clear - heads");
+        ProfiledCommand profiledCounter(m_ctx, queue, "FragmentLists::clear counter");
+        err = queue.enqueueFillBuffer(m_counter, uint32_t{0}, 0, sizeof(uint32_t),
+                                      nullptr, profiledCounter.event());
+        HWR_ASSERT_CL_OK(err, "FragmentLists::clear - counter");
+    }
+
+    size_t FragmentLists::fragmentCount() const {
+        uint32_t count = 0;
+        const cl_int err = m_ctx.getQueue().enqueueReadBuffer(m_counter, CL_TRUE, 0,
+                                                              sizeof(count), &count);
+        HWR_ASSERT_CL_OK(err, "FragmentLists::fragmentCount");
+        return count;
+    }
+
+    namespace detail {
+
+        std::string makeTransparentRasterSource(const std::string& structDefs,
+                                                const std::string& attributeType,
+                                                const std::string& instanceType,
+                                                const std::vector<KernelParam>& params,
+                                                const std::string& body)
+        {
+            const std::string A = "struct " + attributeType;
+            const std::string I = "struct " + instanceType;
+
+            std::string src(OPENCL_STDINT_PRELUDE);
+            src += structDefs;
+            src += OIT_FRAGMENT_TYPE;
+            src += RASTER_HELPERS;
+            src += "__kernel void " + std::string(TRANSPARENT_RASTER_ENTRY) + "(\n"
+                   "    __global const float4* hwr_positions, __global const uint* hwr_indices,\n"
+                   "    __global const " + A + "* hwr_attributes,\n"
+                   "    __global const " + I + "* hwr_instances,\n"
+                   "    const uint hwr_triangle_count, const uint hwr_vertex_count,\n"
+                   "    const uint hwr_width, const uint hwr_height, const uint hwr_cull_back,\n"
+                   "    __global const uint* hwr_opaque_depth,\n"
+                   "    volatile __global uint* hwr_heads, __global OitFragment* hwr_fragments,\n"
+                   "    volatile __global uint* hwr_fragment_count, const uint hwr_capacity"
+                   + makeParamList(params) + ")\n"
+                   "{\n"
+                   "const uint hwr_triangle_id = (uint)get_global_id(0);\n"
+                   "const uint hwr_instance_id = (uint)get_global_id(1);\n"
+                   "if (hwr_triangle_id >= hwr_triangle_count) return;\n"
+                   "const uint hwr_i0 = hwr_indices[3 * hwr_triangle_id + 0];\n"
+                   "const uint hwr_i1 = hwr_indices[3 * hwr_triangle_id + 1];\n"
+                   "const uint hwr_i2 = hwr_indices[3 * hwr_triangle_id + 2];\n"
+                   "const size_t hwr_base = (size_t)hwr_instance_id * hwr_vertex_count;\n"
+                   "const float4 hwr_c0 = hwr_positions[hwr_base + hwr_i0];\n"
+                   "const float4 hwr_c1 = hwr_positions[hwr_base + hwr_i1];\n"
+                   "const float4 hwr_c2 = hwr_positions[hwr_base + hwr_i2];\n"
+                   "if (hwr_c0.w <= 0.0f || hwr_c1.w <= 0.0f || hwr_c2.w <= 0.0f) return;\n"
+                   "const float3 hwr_s0 = hwr_to_screen(hwr_c0, hwr_width, hwr_height);\n"
+                   "const float3 hwr_s1 = hwr_to_screen(hwr_c1, hwr_width, hwr_height);\n"
+                   "const float3 hwr_s2 = hwr_to_screen(hwr_c2, hwr_width, hwr_height);\n"
+                   "const float hwr_area = hwr_edge(hwr_s0.xy, hwr_s1.xy, hwr_s2.xy);\n"
+                   "if (hwr_area == 0.0f || (hwr_cull_back && hwr_area > 0.0f)) return;\n"
+                   "const float hwr_orient = hwr_area < 0.0f ? -1.0f : 1.0f;\n"
+                   "const float hwr_inv_area = 1.0f / fabs(hwr_area);\n"
+                   "const int4 hwr_bounds = hwr_pixel_bounds(hwr_s0, hwr_s1, hwr_s2, hwr_width, hwr_height);\n"
+                   "__global const " + A + "* hwr_a0 = hwr_attributes + hwr_i0;\n"
+                   "__global const " + A + "* hwr_a1 = hwr_attributes + hwr_i1;\n"
+                   "__global const " + A + "* hwr_a2 = hwr_attributes + hwr_i2;\n"
+                   "__global const " + I + "* hwr_instance = hwr_instances + hwr_instance_id;\n"
+                   "for (int hwr_y = hwr_bounds.y; hwr_y <= hwr_bounds.w; ++hwr_y) {\n"
+                   "for (int hwr_x = hwr_bounds.x; hwr_x <= hwr_bounds.z; ++hwr_x) {\n"
+                   "const float2 hwr_p = (float2)((float)hwr_x + 0.5f, (float)hwr_y + 0.5f);\n"
+                   "const float hwr_w0 = hwr_orient * hwr_edge(hwr_s1.xy, hwr_s2.xy, hwr_p);\n"
+                   "const float hwr_w1 = hwr_orient * hwr_edge(hwr_s2.xy, hwr_s0.xy, hwr_p);\n"
+                   "const float hwr_w2 = hwr_orient * hwr_edge(hwr_s0.xy, hwr_s1.xy, hwr_p);\n"
+                   "if (hwr_w0 < 0.0f || hwr_w1 < 0.0f || hwr_w2 < 0.0f) continue;\n"
+                   "const float hwr_depth = (hwr_w0 * hwr_s0.z + hwr_w1 * hwr_s1.z + hwr_w2 * hwr_s2.z) * hwr_inv_area;\n"
+                   "if (hwr_depth < 0.0f || hwr_depth > 1.0f) continue;\n"
+                   "const size_t hwr_pixel = (size_t)hwr_y * hwr_width + (size_t)hwr_x;\n"
+                   // Non-negative floats order like their bit patterns.
+                   "if (as_uint(hwr_depth) >= hwr_opaque_depth[hwr_pixel]) continue;\n"
+                   "const uint hwr_pixel_x = (uint)hwr_x;\n"
+                   "const uint hwr_pixel_y = (uint)hwr_y;\n"
+                   "float hwr_bary[3];\n"
+                   "hwr_bary[0] = hwr_w0 / hwr_c0.w;\n"
+                   "hwr_bary[1] = hwr_w1 / hwr_c1.w;\n"
+                   "hwr_bary[2] = hwr_w2 / hwr_c2.w;\n"
+                   "{\n"
+                   "const float hwr_sum = hwr_bary[0] + hwr_bary[1] + hwr_bary[2];\n"
+                   "hwr_bary[0] /= hwr_sum; hwr_bary[1] /= hwr_sum; hwr_bary[2] /= hwr_sum;\n"
+                   "}\n"
+                   "float4 hwr_color = (float4)(0.0f, 0.0f, 0.0f, 1.0f);\n";
+            src += body;
+            src += "if (hwr_color.s3 <= 0.0f) continue;\n"
+                   "const uint hwr_slot = atomic_inc(hwr_fragment_count);\n"
+                   "if (hwr_slot >= hwr_capacity) continue;\n"
+                   "hwr_fragments[hwr_slot].color = as_uint(convert_uchar4_sat_rte(hwr_color * 255.0f));\n"
+                   "hwr_fragments[hwr_slot].depth = hwr_depth;\n"
+                   "hwr_fragments[hwr_slot].next = atomic_xchg(&hwr_heads[hwr_pixel], hwr_slot);\n"
+                   "}\n"
+                   "}\n"
+                   "}\n";
+            return src;
+        }
+
+    } // namespace detail
+
+    OitResolve::OitResolve(const GPUContext& ctx, ColorFormat format, uint32_t maxLayers)
+        : m_format(format)
+        , m_maxLayers(maxLayers)
+        , m_kernel(ctx, makeResolveSource(format, maxLayers), "hwr_oit_resolve")
+    {}
+
+    void OitResolve::resolve(const FragmentLists& fragments, const Framebuffer& target) {
+        if (target.desc().color != m_format) {
+            HWR_FATAL("OitResolve::resolve - target color format differs from the pass");
+        }
+        if (target.width() != fragments.width() || target.height() != fragments.height()) {
+            HWR_FATAL("OitResolve::resolve - target and fragment list sizes differ");
+        }
+        m_kernel.setArgs(fragments.heads(), fragments.fragments(),
+                         static_cast<cl_uint>(fragments.capacity()),
+                         static_cast<cl_uint>(target.pixelCount()), target.color());
+        m_kernel.dispatch(cl::NDRange(target.pixelCount()));
+    }
+
+} // namespace hwr
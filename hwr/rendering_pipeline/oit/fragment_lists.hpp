@@ -0,0 +1,182 @@
+#ifndef HWR_FRAGMENT_LISTS_HPP
+#define HWR_FRAGMENT_LISTS_HPP
+
+#include "../shading/visibility_shading.hpp"
+#include <limits>
+
+namespace hwr {
+
+// Head or next link that points nowhere.
+inline constexpr uint32_t OIT_END = 0xFFFFFFFFu;
+
+// One transparent fragment as stored in the pool. color is RGBA8 with
+// straight alpha, r in the lowest byte; next links to the previous
+// fragment appended to the same pixel.
+struct OitFragment {
+    uint32_t color;
+    float depth;
+    uint32_t next;
+};
+
+static_assert(sizeof(OitFragment) == 12, "OitFragment must match the device layout");
+
+/**
+* \class FragmentLists
+* \brief Per-pixel linked lists of transparent fragments in one
+*        preallocated pool.
+*
+* Fragments are appended by bumping a single counter and swapping the
+* pixel's head, so rasterizing needs no sorting or per-pixel locks.
+* Fragments past capacity() are dropped; fragmentCount() tells by how much
+* the pool was short.
+*/
+class FragmentLists {
+public:
+    FragmentLists(const GPUContext& ctx, uint32_t width, uint32_t height, size_t capacity);
+
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    size_t pixelCount() const { return size_t{m_width} * m_height; }
+    size_t capacity() const { return m_capacity; }
+
+    const cl::Buffer& heads() const { return m_heads; }
+    const cl::Buffer& fragments() const { return m_fragments; }
+    const cl::Buffer& counter() const { return m_counter; }
+
+    /// Empties every list. Enqueued on the context's queue.
+    void clear();
+
+    /// Fragments appended since clear(), dropped ones included. Blocks
+    /// until the queue is done with them.
+    size_t fragmentCount() const;
+
+private:
+    const GPUContext& m_ctx;
+    uint32_t m_width;
+    uint32_t m_height;
+    size_t m_capacity;
+    cl::Buffer m_heads;
+    cl::Buffer m_fragments;
+    cl::Buffer m_counter;
+};
+
+namespace detail {
+
+    std::string makeTransparentRasterSource(const std::string& structDefs,
+                                            const std::string& attributeType,
+                                            const std::string& instanceType,
+                                            const std::vector<KernelParam>& params,
+                                            const std::string& body);
+
+} // namespace detail
+
+inline constexpr const char* TRANSPARENT_RASTER_ENTRY = "hwr_transparent_raster";
+
+/**
+* \class TransparentRaster
+* \brief Rasterizes transparent triangles, shades each fragment with the
+*        body and appends it to FragmentLists.
+*
+* Same input and coverage rules as VisibilityRaster. Fragments behind the
+* opaque depth in a VisibilityBuffer are skipped. The body uses the
+* hwr::shading built-ins and sets color(3) to the fragment's alpha;
+* fragments left with alpha 0 are not stored. Nothing is sorted here,
+* OitResolve orders each pixel's fragments when it blends them.
+*/
+template<ShaderStruct Attribute, ShaderStruct Instance>
+class TransparentRaster {
+public:
+    template<typename Lambda,
+        typename = std::enable_if_t<std::is_invocable_v<Lambda>>>
+    TransparentRaster(const GPUContext& ctx, Lambda&& body)
+        : m_body(std::forward<Lambda>(body))
+        , m_kernel(ctx, generateSource(m_body), TRANSPARENT_RASTER_ENTRY)
+    {
+        detail::declareBodyParams(m_kernel, FIXED_ARGS, m_body.parameters());
+    }
+
+    template<typename T>
+    void bind(const std::string& name, const T& value) {
+        m_kernel.setParam(name, value);
+    }
+
+    template<typename Position>
+    void rasterize(const BaseBuffer<Position>& positions,
+                   const BaseBuffer<uint32_t>& indices,
+                   const BaseBuffer<Attribute>& attributes,
+                   const BaseBuffer<Instance>& instances,
+                   const VisibilityBuffer& opaque,
+                   FragmentLists& target,
+                   CullMode cull = CullMode::NONE)
+    {
+        static_assert(sizeof(Position) == sizeof(vec4f),
+                      "Positions must be 4 floats: clip-space x, y, z, w");
+        if (target.width() != opaque.width() || target.height() != opaque.height()) {
+            HWR_FATAL("TransparentRaster::rasterize - fragment lists and opaque depth sizes differ");
+        }
+        if (positions.size() != attributes.size() * instances.size()) {
+            HWR_FATAL("TransparentRaster::rasterize - positions must hold instanceCount * vertexCount elements");
+        }
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+        if (triangleCount * instances.size() > std::numeric_limits<cl_uint>::max()
+            || target.capacity() > std::numeric_limits<cl_uint>::max()) {
+            HWR_FATAL("TransparentRaster::rasterize - counts would overflow 32 bits");
+        }
+        m_kernel.setArgs(positions, indices, attributes, instances,
+                         static_cast<cl_uint>(triangleCount),
+                         static_cast<cl_uint>(attributes.size()),
+                         cl_uint{target.width()}, cl_uint{target.height()},
+                         cl_uint{cull == CullMode::BACK ? 1u : 0u},
+                         opaque.depth(), target.heads(), target.fragments(),
+                         target.counter(), static_cast<cl_uint>(target.capacity()));
+        m_kernel.dispatch(cl::NDRange(triangleCount, instances.size()));
+    }
+
+private:
+    static constexpr cl_uint FIXED_ARGS = 14;
+
+    Program m_body;
+    Kernel m_kernel;
+
+    static std::string generateSource(Program& body) {
+        const std::string code = body.compile();
+        return detail::makeBodyPrelude(body)
+             + detail::makeTransparentRasterSource(
+            detail::compileStructDefs<Attribute, Instance>(),
+            Attribute::opencl_name, Instance::opencl_name,
+            body.parameters(), code
+        );
+    }
+};
+
+/**
+* \class OitResolve
+* \brief Sorts each pixel's fragments by depth and blends them back to
+*        front over the color already in a Framebuffer.
+*
+* At most maxLayers fragments per pixel are kept, the nearest ones; the
+* rest of a deeper list is dropped. Sorting is an insertion sort in
+* private memory, so the cost grows with maxLayers squared at worst.
+*/
+class OitResolve {
+public:
+    static constexpr uint32_t MAX_LAYERS = 64;
+
+    OitResolve(const GPUContext& ctx, ColorFormat format, uint32_t maxLayers = 16);
+
+    uint32_t maxLayers() const { return m_maxLayers; }
+
+    void resolve(const FragmentLists& fragments, const Framebuffer& target);
+
+private:
+    ColorFormat m_format;
+    uint32_t m_maxLayers;
+    Kernel m_kernel;
+};
+
+} // namespace hwr
+
+#endif // HWR_FRAGMENT_LISTS_HPP
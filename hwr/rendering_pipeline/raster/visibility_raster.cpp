@@ -0,0 +1,151 @@
+#include "visibility_raster.hpp"
+#include "../gpu/profiling/gpu_profiler.hpp"
+
+namespace hwr {
+
+    namespace detail {
+
+        const char* const RASTER_HELPERS = R"CLC(
+float hwr_edge(float2 a, float2 b, float2 p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+float3 hwr_to_screen(float4 c, uint width, uint height) {
+    const float3 ndc = c.xyz / c.w;
+    return (float3)((ndc.x * 0.5f + 0.5f) * (float)width,
+                    (0.5f - ndc.y * 0.5f) * (float)height,
+                    ndc.z * 0.5f + 0.5f);
+}
+
+// Pixels the triangle may cover: (minX, minY, maxX, maxY), inclusive.
+// Clamped before converting, since vertices close to w = 0 land far
+// outside int range. A triangle entirely off screen gets min > max.
+int4 hwr_pixel_bounds(float3 p0, float3 p1, float3 p2, uint width, uint height) {
+    const float2 last = (float2)((float)width - 1.0f, (float)height - 1.0f);
+    const float2 lo = clamp(floor(fmin(p0.xy, fmin(p1.xy, p2.xy))), (float2)(0.0f), last + 1.0f);
+    const float2 hi = clamp(ceil(fmax(p0.xy, fmax(p1.xy, p2.xy))), (float2)(-1.0f), last);
+    return convert_int4((float4)(lo, hi));
+}
+)CLC";
+
+    } // namespace detail
+
+    namespace {
+
+        const char* VISIBILITY_RASTER_KERNEL = R"CLC(
+__kernel void hwr_visibility_raster(
+    __global const float4* positions, __global const uint* indices,
+    const uint triangleCount, const uint vertexCount,
+    const uint width, const uint height,
+    const uint cullBack, const uint pass,
+    volatile __global uint* depth, __global uint* ids)
+{
+    const uint tri = (uint)get_global_id(0);
+    const uint inst = (uint)get_global_id(1);
+    if (tri >= triangleCount) return;
+
+    const size_t base = (size_t)inst * vertexCount;
+    const float4 c0 = positions[base + indices[3 * tri + 0]];
+    const float4 c1 = positions[base + indices[3 * tri + 1]];
+    const float4 c2 = positions[base + indices[3 * tri + 2]];
+    if (c0.w <= 0.0f || c1.w <= 0.0f || c2.w <= 0.0f) return;
+
+    const float3 p0 = hwr_to_screen(c0, width, height);
+    const float3 p1 = hwr_to_screen(c1, width, height);
+    const float3 p2 = hwr_to_screen(c2, width, height);
+
+    // y is flipped on the way to the screen, so front faces come out negative.
+    const float area = hwr_edge(p0.xy, p1.xy, p2.xy);
+    if (area == 0.0f || (cullBack && area > 0.0f)) return;
+    const float orient = area < 0.0f ? -1.0f : 1.0f;
+    const float invArea = 1.0f / fabs(area);
+
+    const int4 bounds = hwr_pixel_bounds(p0, p1, p2, width, height);
+    const uint primitive = inst * triangleCount + tri;
+
+    for (int y = bounds.y; y <= bounds.w; ++y) {
+        for (int x = bounds.x; x <= bounds.z; ++x) {
+            const float2 p = (float2)((float)x + 0.5f, (float)y + 0.5f);
+            const float w0 = orient * hwr_edge(p1.xy, p2.xy, p);
+            const float w1 = orient * hwr_edge(p2.xy, p0.xy, p);
+            const float w2 = orient * hwr_edge(p0.xy, p1.xy, p);
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+            const float z = (w0 * p0.z + w1 * p1.z + w2 * p2.z) * invArea;
+            if (z < 0.0f || z > 1.0f) continue;
+
+            // Non-negative floats order like their bit patterns.
+            const uint zbits = as_uint(z);
+            const size_t pixel = (size_t)y * width + (size_t)x;
+            if (pass == 0) {
+                atomic_min(&depth[pixel], zbits);
+            } else if (depth[pixel] == zbits) {
+                ids[pixel] = primitive;
+            }
+        }
+    }
+}
+)CLC";
+
+        cl::Buffer makeBuffer(const GPUContext& ctx, size_t bytes) {
+            cl_int err = CL_SUCCESS;
+            cl::Buffer buffer(ctx.getContext(), CL_MEM_READ_WRITE, bytes, nullptr, &err);
+            HWR_ASSERT_CL_OK(err, "VisibilityBuffer - allocation");
+            return buffer;
+        }
+
+    }
+
+    VisibilityBuffer::VisibilityBuffer(const GPUContext& ctx, uint32_t width, uint32_t height)
+        : m_ctx(ctx)
+        , m_width(width)
+        , m_height(height)
+    {
+        if (width == 0 || height == 0) {
+            HWR_FATAL("VisibilityBuffer - width and height must be non-zero");
+        }
+        m_depth = makeBuffer(ctx, pixelCount() * sizeof(float));
+        m_ids = makeBuffer(ctx, pixelCount() * sizeof(uint32_t));
+    }
+
+    void VisibilityBuffer::clear() {
+        cl::CommandQueue queue = m_ctx.getQueue();
+        ProfiledCommand profiledDepth(m_ctx, queue, "VisibilityBuffer::clear depth");
+        cl_int err = queue.enqueueFillBuffer(m_depth, 1.0f, 0, pixelCount() * sizeof(float),
+                                             nullptr, profiledDepth.event());
+        HWR_ASSERT_CL_OK(err, "VisibilityBuffer::clear - depth");
+        ProfiledCommand profiledIds(m_ctx, queue, "VisibilityBuffer::clear ids");
+        err = queue.enqueueFillBuffer(m_ids, VISIBILITY_EMPTY, 0, pixelCount() * sizeof(uint32_t),
+                                      nullptr, profiledIds.event());
+        HWR_ASSERT_CL_OK(err, "VisibilityBuffer::clear - ids");
+    }
+
+    VisibilityRaster::VisibilityRaster(const GPUContext& ctx)
+        : m_kernel(ctx, std::string(detail::RASTER_HELPERS) + VISIBILITY_RASTER_KERNEL, "hwr_visibility_raster")
+    {}
+
+    void VisibilityRaster::rasterize(const cl::Buffer& positions, const cl::Buffer& indices,
+                                     size_t triangleCount, size_t vertexCount,
+                                     size_t instanceCount, VisibilityBuffer& target,
+                                     CullMode cull)
+    {
+        if (triangleCount == 0 || instanceCount == 0) {
+            return;
+        }
+        if (triangleCount * instanceCount > std::numeric_limits<cl_uint>::max()
+            || vertexCount > std::numeric_limits<cl_uint>::max()) {
+            HWR_FATAL("VisibilityRaster::rasterize - primitive IDs would overflow 32 bits");
+        }
+        const cl::NDRange global(triangleCount, instanceCount);
+        for (cl_uint pass = 0; pass < 2; ++pass) {
+            m_kernel.setArgs(positions, indices,
+                             static_cast<cl_uint>(triangleCount),
+                             static_cast<cl_uint>(vertexCount),
+                             cl_uint{target.width()}, cl_uint{target.height()},
+                             cl_uint{cull == CullMode::BACK ? 1u : 0u}, pass,
+                             target.depth(), target.ids());
+            m_kernel.dispatch(global);
+        }
+    }
+
+} // namespace hwr
@@ -0,0 +1,98 @@
+#ifndef HWR_VISIBILITY_RASTER_HPP
+#define HWR_VISIBILITY_RASTER_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/kernel/kernel.hpp"
+#include "../../util/math/math_util.hpp"
+#include <limits>
+
+namespace hwr {
+
+// Value of a visibility buffer pixel that no triangle covers.
+inline constexpr uint32_t VISIBILITY_EMPTY = 0xFFFFFFFFu;
+
+enum class CullMode {
+    NONE,
+    BACK, // counter-clockwise in NDC is front facing
+};
+
+namespace detail {
+
+    // OpenCL C screen mapping, edge function and pixel bounds shared by
+    // the compute rasterizers, so they agree on which pixels a triangle
+    // covers.
+    extern const char* const RASTER_HELPERS;
+
+} // namespace detail
+
+/**
+* \class VisibilityBuffer
+* \brief Per-pixel depth (float in [0, 1]) and primitive ID, nothing else.
+*
+* The primitive ID is instance * triangleCount + triangle, so one uint
+* identifies both.
+*/
+class VisibilityBuffer {
+public:
+    VisibilityBuffer(const GPUContext& ctx, uint32_t width, uint32_t height);
+
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    size_t pixelCount() const { return size_t{m_width} * m_height; }
+
+    const cl::Buffer& depth() const { return m_depth; }
+    const cl::Buffer& ids() const { return m_ids; }
+
+    /// Depth to 1.0, IDs to VISIBILITY_EMPTY.
+    void clear();
+
+private:
+    const GPUContext& m_ctx;
+    uint32_t m_width;
+    uint32_t m_height;
+    cl::Buffer m_depth;
+    cl::Buffer m_ids;
+};
+
+/**
+* \class VisibilityRaster
+* \brief Compute rasterizer writing only depth and primitive IDs.
+*
+* Input is the output of the transform stage: clip-space positions laid
+* out instance-major (instance * vertexCount + vertex), as InstancedDraw
+* produces them, plus the mesh's triangle list. Runs two passes, a 32-bit
+* atomic_min depth pass and an ID resolve pass, so it only needs core
+* OpenCL atomics. One work-item per (triangle, instance); no clipping,
+* triangles crossing the near plane are dropped.
+*/
+class VisibilityRaster {
+public:
+    explicit VisibilityRaster(const GPUContext& ctx);
+
+    template<typename Position>
+    void rasterize(const BaseBuffer<Position>& positions,
+                   const BaseBuffer<uint32_t>& indices,
+                   size_t vertexCount,
+                   VisibilityBuffer& target,
+                   CullMode cull = CullMode::BACK)
+    {
+        static_assert(sizeof(Position) == sizeof(vec4f),
+                      "Positions must be 4 floats: clip-space x, y, z, w");
+        if (vertexCount == 0 || positions.size() % vertexCount != 0) {
+            HWR_FATAL("VisibilityRaster::rasterize - positions must hold instanceCount * vertexCount elements");
+        }
+        rasterize(positions.getCLBuffer(), indices.getCLBuffer(), indices.size() / 3,
+                  vertexCount, positions.size() / vertexCount, target, cull);
+    }
+
+private:
+    void rasterize(const cl::Buffer& positions, const cl::Buffer& indices,
+                   size_t triangleCount, size_t vertexCount, size_t instanceCount,
+                   VisibilityBuffer& target, CullMode cull);
+
+    Kernel m_kernel;
+};
+
+} // namespace hwr
+
+#endif // HWR_VISIBILITY_RASTER_HPP
@@ -0,0 +1,246 @@
+#include "ray_caster.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace hwr {
+
+namespace {
+
+    // Enough to hide latency on most GPUs without making the last tiles of
+    // a frame wait on a few busy groups.
+    constexpr size_t GROUPS_PER_COMPUTE_UNIT = 8;
+
+    const char* RAY_CAST_HELPERS = R"CLC(
+#define HWR_SCENE_PARAMS __global const BvhNode* hwr_nodes, __global const uint* hwr_order, \
+    const uint hwr_node_count, __global const float4* hwr_positions, __global const uint* hwr_indices
+#define HWR_SCENE hwr_nodes, hwr_order, hwr_node_count, hwr_positions, hwr_indices
+
+// World-space ray through the pixel center at ndc, from the near plane.
+void hwr_camera_ray(const float4 inv0, const float4 inv1, const float4 inv2, const float4 inv3,
+                    const float2 ndc, float3* o, float3* d)
+{
+    const float4 n = (float4)(ndc, -1.0f, 1.0f);
+    const float4 f = (float4)(ndc, 1.0f, 1.0f);
+    const float4 wn = (float4)(dot(inv0, n), dot(inv1, n), dot(inv2, n), dot(inv3, n));
+    const float4 wf = (float4)(dot(inv0, f), dot(inv1, f), dot(inv2, f), dot(inv3, f));
+    *o = wn.xyz / wn.w;
+    *d = normalize(wf.xyz / wf.w - *o);
+}
+
+// Moller-Trumbore. uv weights corners 1 and 2.
+bool hwr_ray_triangle(const float3 o, const float3 d, const float3 p0, const float3 p1,
+                      const float3 p2, const float tMin, const float tMax, float* t, float2* uv)
+{
+    const float3 e1 = p1 - p0;
+    const float3 e2 = p2 - p0;
+    const float3 pv = cross(d, e2);
+    const float det = dot(e1, pv);
+    if (fabs(det) < 1e-12f) return false;
+    const float inv = 1.0f / det;
+    const float3 tv = o - p0;
+    const float u = dot(tv, pv) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    const float3 qv = cross(tv, e1);
+    const float v = dot(d, qv) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    const float hit = dot(e2, qv) * inv;
+    if (hit < tMin || hit > tMax) return false;
+    *t = hit;
+    *uv = (float2)(u, v);
+    return true;
+}
+
+// Nearest triangle hit within [tMin, tMax], or with anyHit the first one
+// found. HWR_BVH_NO_HIT on a miss, t and uv are left alone then.
+uint hwr_trace(HWR_SCENE_PARAMS, const float3 o, const float3 d, const float tMin, float tMax,
+               const bool anyHit, float* t, float2* uv)
+{
+    const float3 invD = 1.0f / d;
+    uint hit = HWR_BVH_NO_HIT;
+    uint stack[HWR_BVH_STACK];
+    float entry[HWR_BVH_STACK];
+    uint top = 0;
+    if (hwr_node_count > 0) {
+        const BvhNode root = hwr_nodes[0];
+        const float tRoot = hwr_ray_box(o, invD, tMin, tMax, (float3)(root.minX, root.minY, root.minZ),
+                                        (float3)(root.maxX, root.maxY, root.maxZ));
+        if (tRoot < INFINITY) {
+            stack[top] = 0;
+            entry[top++] = tRoot;
+        }
+    }
+    while (top > 0) {
+        --top;
+        if (entry[top] > tMax) continue;
+        const BvhNode n = hwr_nodes[stack[top]];
+        if (n.count == 0) {
+            const BvhNode l = hwr_nodes[n.leftFirst];
+            const BvhNode r = hwr_nodes[n.leftFirst + 1];
+            const float tl = hwr_ray_box(o, invD, tMin, tMax, (float3)(l.minX, l.minY, l.minZ),
+                                         (float3)(l.maxX, l.maxY, l.maxZ));
+            const float tr = hwr_ray_box(o, invD, tMin, tMax, (float3)(r.minX, r.minY, r.minZ),
+                                         (float3)(r.maxX, r.maxY, r.maxZ));
+            const bool leftNear = tl <= tr;
+            const float tNear = leftNear ? tl : tr;
+            const float tFar = leftNear ? tr : tl;
+            if (tFar < INFINITY) {
+                stack[top] = leftNear ? n.leftFirst + 1 : n.leftFirst;
+                entry[top++] = tFar;
+            }
+            if (tNear < INFINITY) {
+                stack[top] = leftNear ? n.leftFirst : n.leftFirst + 1;
+                entry[top++] = tNear;
+            }
+            continue;
+        }
+        for (uint i = n.leftFirst; i < n.leftFirst + n.count; ++i) {
+            const uint tri = hwr_order[i];
+            const float3 p0 = hwr_positions[hwr_indices[3 * tri + 0]].xyz;
+            const float3 p1 = hwr_positions[hwr_indices[3 * tri + 1]].xyz;
+            const float3 p2 = hwr_positions[hwr_indices[3 * tri + 2]].xyz;
+            if (hwr_ray_triangle(o, d, p0, p1, p2, tMin, tMax, t, uv)) {
+                hit = tri;
+                tMax = *t;
+                if (anyHit) return hit;
+            }
+        }
+    }
+    return hit;
+}
+
+float hwr_shadow(HWR_SCENE_PARAMS, const float3 o, const float3 towardsLight)
+{
+    float t;
+    float2 uv;
+    return hwr_trace(HWR_SCENE, o, normalize(towardsLight), 0.0f, INFINITY, true, &t, &uv)
+        == HWR_BVH_NO_HIT ? 1.0f : 0.0f;
+}
+
+float hwr_shadow_to(HWR_SCENE_PARAMS, const float3 o, const float3 light)
+{
+    const float3 towardsLight = light - o;
+    const float dist = length(towardsLight);
+    float t;
+    float2 uv;
+    return hwr_trace(HWR_SCENE, o, towardsLight / dist, 0.0f, dist, true, &t, &uv)
+        == HWR_BVH_NO_HIT ? 1.0f : 0.0f;
+}
+)CLC";
+
+}
+
+std::vector<Aabb> triangleBounds(std::span<const vec4f> positions,
+                                 std::span<const uint32_t> indices)
+{
+    std::vector<Aabb> bounds(indices.size() / 3);
+    for (size_t t = 0; t < bounds.size(); ++t) {
+        Aabb& b = bounds[t];
+        b.min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max(), 0.0f };
+        b.max = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest(), 0.0f };
+        for (size_t k = 0; k < 3; ++k) {
+            const uint32_t i = indices[3 * t + k];
+            HWR_ASSERT(i < positions.size(), "triangleBounds - index out of range");
+            const vec4f& p = positions[i];
+            b.min.x = std::min(b.min.x, p.x);
+            b.min.y = std::min(b.min.y, p.y);
+            b.min.z = std::min(b.min.z, p.z);
+            b.max.x = std::max(b.max.x, p.x);
+            b.max.y = std::max(b.max.y, p.y);
+            b.max.z = std::max(b.max.z, p.z);
+        }
+    }
+    return bounds;
+}
+
+namespace detail {
+
+std::string makeRayCastSource(const std::string& structDefs,
+                              const std::string& attributeType,
+                              ColorFormat format,
+                              const std::vector<KernelParam>& params,
+                              const std::string& body)
+{
+    const std::string A = "struct " + attributeType;
+    const std::string tile = std::to_string(RAY_CAST_TILE) + "u";
+
+    std::string src(OPENCL_STDINT_PRELUDE);
+    src += structDefs;
+    src += BVH_DEVICE_HELPERS;
+    src += RAY_CAST_HELPERS;
+    src += "__kernel void " + std::string(RAY_CAST_ENTRY) + "(\n"
+           "    HWR_SCENE_PARAMS,\n"
+           "    __global const " + A + "* hwr_attributes,\n"
+           "    const float4 hwr_inv0, const float4 hwr_inv1,\n"
+           "    const float4 hwr_inv2, const float4 hwr_inv3,\n"
+           "    const uint hwr_width, const uint hwr_height,\n"
+           "    __global uint* hwr_next_tile,\n"
+           "    " + colorPointerType(format) + " hwr_target"
+           + makeParamList(params) + ")\n"
+           "{\n"
+           "__local uint hwr_tile;\n"
+           "const uint hwr_tiles_x = (hwr_width + " + tile + " - 1u) / " + tile + ";\n"
+           "const uint hwr_tile_count = hwr_tiles_x * ((hwr_height + " + tile + " - 1u) / " + tile + ");\n"
+           "const uint hwr_lane = (uint)get_local_id(0);\n"
+           // The tile is the same for the whole group, so every work-item
+           // reaches both barriers and leaves the loop together.
+           "for (;;) {\n"
+           "if (hwr_lane == 0) hwr_tile = atomic_inc(hwr_next_tile);\n"
+           "barrier(CLK_LOCAL_MEM_FENCE);\n"
+           "const uint hwr_current = hwr_tile;\n"
+           "barrier(CLK_LOCAL_MEM_FENCE);\n"
+           "if (hwr_current >= hwr_tile_count) break;\n"
+           "const uint hwr_pixel_x = hwr_current % hwr_tiles_x * " + tile + " + hwr_lane % " + tile + ";\n"
+           "const uint hwr_pixel_y = hwr_current / hwr_tiles_x * " + tile + " + hwr_lane / " + tile + ";\n"
+           "if (hwr_pixel_x >= hwr_width || hwr_pixel_y >= hwr_height) continue;\n"
+           "const size_t hwr_pixel = (size_t)hwr_pixel_y * hwr_width + hwr_pixel_x;\n"
+           "const float2 hwr_ndc = (float2)(((float)hwr_pixel_x + 0.5f) / (float)hwr_width * 2.0f - 1.0f,\n"
+           "                                1.0f - ((float)hwr_pixel_y + 0.5f) / (float)hwr_height * 2.0f);\n"
+           "float3 hwr_ray_o, hwr_ray_d;\n"
+           "hwr_camera_ray(hwr_inv0, hwr_inv1, hwr_inv2, hwr_inv3, hwr_ndc, &hwr_ray_o, &hwr_ray_d);\n"
+           "float hwr_t = INFINITY;\n"
+           "float2 hwr_uv = (float2)(0.0f, 0.0f);\n"
+           "const uint hwr_triangle_id = hwr_trace(HWR_SCENE, hwr_ray_o, hwr_ray_d, 0.0f, INFINITY,\n"
+           "                                       false, &hwr_t, &hwr_uv);\n"
+           "const bool hwr_hit = hwr_triangle_id != HWR_BVH_NO_HIT;\n"
+           "uint hwr_i0 = 0, hwr_i1 = 0, hwr_i2 = 0;\n"
+           "float hwr_bary[3] = { 0.0f, 0.0f, 0.0f };\n"
+           "float3 hwr_normal = -hwr_ray_d;\n"
+           "if (hwr_hit) {\n"
+           "hwr_i0 = hwr_indices[3 * hwr_triangle_id + 0];\n"
+           "hwr_i1 = hwr_indices[3 * hwr_triangle_id + 1];\n"
+           "hwr_i2 = hwr_indices[3 * hwr_triangle_id + 2];\n"
+           "const float3 hwr_p0 = hwr_positions[hwr_i0].xyz;\n"
+           "hwr_normal = normalize(cross(hwr_positions[hwr_i1].xyz - hwr_p0,\n"
+           "                             hwr_positions[hwr_i2].xyz - hwr_p0));\n"
+           "if (dot(hwr_normal, hwr_ray_d) > 0.0f) hwr_normal = -hwr_normal;\n"
+           "hwr_bary[0] = 1.0f - hwr_uv.x - hwr_uv.y;\n"
+           "hwr_bary[1] = hwr_uv.x;\n"
+           "hwr_bary[2] = hwr_uv.y;\n"
+           "}\n"
+           "const float3 hwr_hit_position = hwr_ray_o + hwr_ray_d * hwr_t;\n"
+           // Lifted off the surface, scaled with the coordinates, so shadow
+           // rays do not hit the triangle they start from.
+           "const float3 hwr_shadow_origin = hwr_hit_position + hwr_normal * (1e-4f\n"
+           "    * fmax(1.0f, fmax(fabs(hwr_hit_position.x), fmax(fabs(hwr_hit_position.y),\n"
+           "                                                     fabs(hwr_hit_position.z)))));\n"
+           "__global const " + A + "* hwr_a0 = hwr_attributes + hwr_i0;\n"
+           "__global const " + A + "* hwr_a1 = hwr_attributes + hwr_i1;\n"
+           "__global const " + A + "* hwr_a2 = hwr_attributes + hwr_i2;\n"
+           "float4 hwr_color = (float4)(0.0f, 0.0f, 0.0f, 1.0f);\n";
+    src += body;
+    src += colorStore(format);
+    src += "}\n"
+           "}\n";
+    return src;
+}
+
+size_t persistentGroupCount(const GPUContext& ctx) {
+    const cl_uint units = ctx.getDevice().getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    return std::max<size_t>(units, 1) * GROUPS_PER_COMPUTE_UNIT;
+}
+
+} // namespace detail
+
+} // namespace hwr
@@ -0,0 +1,243 @@
+#ifndef HWR_RAY_CASTER_HPP
+#define HWR_RAY_CASTER_HPP
+
+#include "../draw/instanced_draw.hpp"
+#include "../framebuffer/framebuffer.hpp"
+#include "../scene/bvh.hpp"
+#include "../../util/math/transform.hpp"
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+namespace detail {
+
+    inline ShaderValue<float> trace_shadow(const std::string& call) {
+        const std::string tmp = program_context::make_temp_name();
+        program_context::appendToProgramCode("float " + tmp + " = " + call + ";");
+        return ShaderValue<float>(bind_existing, tmp);
+    }
+
+} // namespace detail
+
+// Built-ins usable inside the body of a RayCaster pass. The body runs once
+// per pixel, hit or not; everything about the hit is only meaningful when
+// hit() is true.
+namespace raycast {
+
+    inline ShaderRValue<uint32_t> pixel_x() {
+        return ShaderRValue<uint32_t>(std::string("hwr_pixel_x"));
+    }
+
+    inline ShaderRValue<uint32_t> pixel_y() {
+        return ShaderRValue<uint32_t>(std::string("hwr_pixel_y"));
+    }
+
+    inline ShaderRValue<bool> hit() {
+        return ShaderRValue<bool>(std::string("hwr_hit"));
+    }
+
+    // BVH_NO_HIT when the ray hit nothing.
+    inline ShaderRValue<uint32_t> triangle_id() {
+        return ShaderRValue<uint32_t>(std::string("hwr_triangle_id"));
+    }
+
+    // Distance from the near plane to the hit, along the normalized ray.
+    inline ShaderRValue<float> distance() {
+        return ShaderRValue<float>(std::string("hwr_t"));
+    }
+
+    // Component 0, 1 or 2 (x, y, z) of the world-space ray.
+    inline ShaderRValue<float> ray_origin(uint32_t axis) {
+        return ShaderRValue<float>("hwr_ray_o.s" + std::to_string(axis));
+    }
+
+    inline ShaderRValue<float> ray_direction(uint32_t axis) {
+        return ShaderRValue<float>("hwr_ray_d.s" + std::to_string(axis));
+    }
+
+    // World-space hit point.
+    inline ShaderRValue<float> position(uint32_t axis) {
+        return ShaderRValue<float>("hwr_hit_position.s" + std::to_string(axis));
+    }
+
+    // Unit geometric normal of the hit triangle, facing the ray.
+    inline ShaderRValue<float> normal(uint32_t axis) {
+        return ShaderRValue<float>("hwr_normal.s" + std::to_string(axis));
+    }
+
+    inline ShaderRValue<float> barycentric(uint32_t corner) {
+        return ShaderRValue<float>("hwr_bary[" + std::to_string(corner) + "]");
+    }
+
+    // Vertex attribute interpolated across the hit triangle.
+    template<FloatingType T>
+    ShaderRValue<T> attribute(const std::string& field) {
+        return ShaderRValue<T>("(hwr_bary[0] * hwr_a0->" + field
+                             + " + hwr_bary[1] * hwr_a1->" + field
+                             + " + hwr_bary[2] * hwr_a2->" + field + ")");
+    }
+
+    // Vertex attribute of the triangle's first corner, not interpolated.
+    template<AllowedShaderType T>
+    ShaderRValue<T> flat(const std::string& field) {
+        return ShaderRValue<T>("hwr_a0->" + field);
+    }
+
+    // Output color channel 0..3 (r, g, b, a), in [0, 1] for RGBA8 targets.
+    inline ShaderValue<float> color(uint32_t channel) {
+        return ShaderValue<float>(detail::bind_existing,
+                                  "hwr_color.s" + std::to_string(channel));
+    }
+
+    // Traces a shadow ray from the hit point along (x, y, z), towards a
+    // directional light. 1 if nothing is in the way, 0 otherwise.
+    template<typename X, typename Y, typename Z>
+    ShaderValue<float> shadow(const X& x, const Y& y, const Z& z) {
+        return detail::trace_shadow(
+            "hwr_shadow(HWR_SCENE, hwr_shadow_origin, (float3)(" + detail::expr(x)
+            + ", " + detail::expr(y) + ", " + detail::expr(z) + "))"
+        );
+    }
+
+    // Same towards a point light at (x, y, z); only what lies between the
+    // hit point and the light occludes it.
+    template<typename X, typename Y, typename Z>
+    ShaderValue<float> shadow_to(const X& x, const Y& y, const Z& z) {
+        return detail::trace_shadow(
+            "hwr_shadow_to(HWR_SCENE, hwr_shadow_origin, (float3)(" + detail::expr(x)
+            + ", " + detail::expr(y) + ", " + detail::expr(z) + "))"
+        );
+    }
+
+} // namespace raycast
+
+// World-space bounds of each triangle, in triangle order: build the Bvh a
+// RayCaster traverses from these, so primitive i is triangle i.
+std::vector<Aabb> triangleBounds(std::span<const vec4f> positions,
+                                 std::span<const uint32_t> indices);
+
+namespace detail {
+
+    std::string makeRayCastSource(const std::string& structDefs,
+                                  const std::string& attributeType,
+                                  ColorFormat format,
+                                  const std::vector<KernelParam>& params,
+                                  const std::string& body);
+
+    // Work-groups that keep every compute unit busy when each one loops
+    // over tiles until none are left.
+    size_t persistentGroupCount(const GPUContext& ctx);
+
+} // namespace detail
+
+inline constexpr const char* RAY_CAST_ENTRY = "hwr_ray_cast";
+// Pixels per side of the tile one work-group traces at a time.
+inline constexpr uint32_t RAY_CAST_TILE = 8;
+
+/**
+* \class RayCaster
+* \brief Renders by casting one primary ray per pixel through a DeviceBvh
+*        built over world-space triangles, with shadow rays on demand.
+*
+* An alternative to VisibilityRaster + VisibilityShading for renders that
+* only need visibility and shadow queries. Each work-group traces
+* RAY_CAST_TILE x RAY_CAST_TILE tiles, so the rays it runs together start
+* close and mostly visit the same nodes. Only enough groups to fill the
+* device are launched; they take the next tile from a shared counter until
+* the frame is done, so tiles that cost more (silhouettes, many shadow
+* rays) do not leave units idle.
+*
+* Attributes are per vertex. Textures and samplers declared in the body are
+* bound by name with bind().
+*/
+template<ShaderStruct Attribute>
+class RayCaster {
+public:
+    template<typename Lambda,
+        typename = std::enable_if_t<std::is_invocable_v<Lambda>>>
+    RayCaster(const GPUContext& ctx, ColorFormat format, Lambda&& body)
+        : m_format(format)
+        , m_body(std::forward<Lambda>(body))
+        , m_kernel(ctx, generateSource(format, m_body), RAY_CAST_ENTRY)
+        , m_nextTile(ctx, 1)
+        , m_groupCount(detail::persistentGroupCount(ctx))
+    {
+        detail::declareBodyParams(m_kernel, FIXED_ARGS, m_body.parameters());
+    }
+
+    template<typename T>
+    void bind(const std::string& name, const T& value) {
+        m_kernel.setParam(name, value);
+    }
+
+    // positions are world space, xyz used; bvh must have been built from
+    // triangleBounds() of the same positions and indices.
+    template<typename Position>
+    void render(const DeviceBvh& bvh,
+                const BaseBuffer<Position>& positions,
+                const BaseBuffer<uint32_t>& indices,
+                const BaseBuffer<Attribute>& attributes,
+                const mat4f& viewProjection,
+                const Framebuffer& target)
+    {
+        static_assert(sizeof(Position) == sizeof(vec4f),
+                      "Positions must be 4 floats: world-space x, y, z and unused w");
+        if (target.desc().color != m_format) {
+            HWR_FATAL("RayCaster::render - target color format differs from the pass");
+        }
+        if (!bvh.uploaded()) {
+            HWR_FATAL("RayCaster::render - nothing uploaded to the BVH");
+        }
+        if (bvh.primitiveCount() != indices.size() / 3) {
+            HWR_FATAL("RayCaster::render - the BVH must hold one primitive per triangle");
+        }
+        if (positions.size() != attributes.size()) {
+            HWR_FATAL("RayCaster::render - positions and attributes must have one element per vertex");
+        }
+        if (target.pixelCount() == 0) {
+            return;
+        }
+
+        const mat4f inv = mat_inverse(viewProjection);
+        const auto row = [&](int r) {
+            return vec4f{ inv.m[r][0], inv.m[r][1], inv.m[r][2], inv.m[r][3] };
+        };
+        const size_t tilesX = (target.width() + RAY_CAST_TILE - 1) / RAY_CAST_TILE;
+        const size_t tilesY = (target.height() + RAY_CAST_TILE - 1) / RAY_CAST_TILE;
+        const size_t groups = std::min(m_groupCount, tilesX * tilesY);
+        constexpr size_t groupSize = size_t{RAY_CAST_TILE} * RAY_CAST_TILE;
+
+        m_nextTile.writeFrom(std::vector<uint32_t>{ 0 });
+        m_kernel.setArgs(bvh.nodes(), bvh.primitiveIndices(),
+                         static_cast<cl_uint>(bvh.nodeCount()),
+                         positions, indices, attributes,
+                         row(0), row(1), row(2), row(3),
+                         cl_uint{target.width()}, cl_uint{target.height()},
+                         m_nextTile, target.color());
+        m_kernel.dispatch(cl::NDRange(groups * groupSize), cl::NDRange(groupSize));
+    }
+
+private:
+    static constexpr cl_uint FIXED_ARGS = 14;
+
+    ColorFormat m_format;
+    Program m_body;
+    Kernel m_kernel;
+    GeneralBuffer<uint32_t, HOST_WRITE, GPU_READ, GPU_WRITE> m_nextTile;
+    size_t m_groupCount;
+
+    static std::string generateSource(ColorFormat format, Program& body) {
+        const std::string code = body.compile();
+        return detail::makeBodyPrelude(body)
+             + detail::makeRayCastSource(
+            detail::compileStructDefs<Attribute>(),
+            Attribute::opencl_name, format, body.parameters(), code
+        );
+    }
+};
+
+} // namespace hwr
+
+#endif // HWR_RAY_CASTER_HPP
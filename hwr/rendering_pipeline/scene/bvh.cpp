@@ -0,0 +1,745 @@
+#include "bvh.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+
+namespace hwr {
+
+    namespace detail {
+
+        const char* const BVH_DEVICE_HELPERS = R"CLC(
+typedef struct {
+    float minX, minY, minZ;
+    uint leftFirst;
+    float maxX, maxY, maxZ;
+    uint count;
+} BvhNode;
+
+typedef struct {
+    float4 min;
+    float4 max;
+} Aabb;
+
+typedef struct {
+    float4 origin;
+    float4 direction;
+} BvhRay;
+
+typedef struct {
+    uint primitive;
+    float t;
+} BvhHit;
+
+#define HWR_BVH_STACK 64
+#define HWR_BVH_NO_HIT 0xffffffffu
+
+// False if the box is entirely behind one of the planes.
+bool hwr_box_visible(const float4* planes, const float3 lo, const float3 hi)
+{
+    for (int p = 0; p < 6; ++p) {
+        const float3 corner = select(lo, hi, isgreaterequal(planes[p].xyz, (float3)(0.0f)));
+        if (dot(planes[p].xyz, corner) + planes[p].w < 0.0f) return false;
+    }
+    return true;
+}
+
+// Where the ray enters the box, INFINITY if it misses it within [tMin, tMax].
+float hwr_ray_box(const float3 o, const float3 invD, const float tMin, const float tMax,
+                  const float3 lo, const float3 hi)
+{
+    const float3 t0 = (lo - o) * invD;
+    const float3 t1 = (hi - o) * invD;
+    const float3 tn = fmin(t0, t1);
+    const float3 tf = fmax(t0, t1);
+    const float enter = fmax(fmax(tn.x, tn.y), fmax(tn.z, tMin));
+    const float exit = fmin(fmin(tf.x, tf.y), fmin(tf.z, tMax));
+    return enter <= exit ? enter : INFINITY;
+}
+)CLC";
+
+    } // namespace detail
+
+    namespace {
+
+        const char* BVH_KERNELS = R"CLC(
+__kernel void hwr_bvh_cull(const float4 p0, const float4 p1, const float4 p2,
+    const float4 p3, const float4 p4, const float4 p5,
+    __global const BvhNode* nodes, __global const uint* indices,
+    __global const Aabb* bounds, __global const uint* roots, const uint rootCount,
+    __global uint* visible, __global uint* visibleCount)
+{
+    const uint gid = get_global_id(0);
+    if (gid >= rootCount) return;
+    const float4 planes[6] = { p0, p1, p2, p3, p4, p5 };
+    uint stack[HWR_BVH_STACK];
+    uint top = 0;
+    stack[top++] = roots[gid];
+    while (top > 0) {
+        const BvhNode n = nodes[stack[--top]];
+        if (!hwr_box_visible(planes, (float3)(n.minX, n.minY, n.minZ),
+                             (float3)(n.maxX, n.maxY, n.maxZ))) continue;
+        if (n.count == 0) {
+            stack[top++] = n.leftFirst;
+            stack[top++] = n.leftFirst + 1;
+            continue;
+        }
+        for (uint i = n.leftFirst; i < n.leftFirst + n.count; ++i) {
+            const uint prim = indices[i];
+            const Aabb b = bounds[prim];
+            if (hwr_box_visible(planes, b.min.xyz, b.max.xyz)) {
+                visible[atomic_inc(visibleCount)] = prim;
+            }
+        }
+    }
+}
+
+__kernel void hwr_bvh_raycast(__global const BvhNode* nodes, __global const uint* indices,
+    __global const Aabb* bounds, const uint nodeCount,
+    __global const BvhRay* rays, __global BvhHit* hits, const uint count)
+{
+    const uint gid = get_global_id(0);
+    if (gid >= count) return;
+    const BvhRay ray = rays[gid];
+    const float3 o = ray.origin.xyz;
+    const float3 invD = 1.0f / ray.direction.xyz;
+    const float tMin = ray.origin.w;
+    float limit = ray.direction.w;
+    BvhHit hit = { HWR_BVH_NO_HIT, INFINITY };
+
+    uint stack[HWR_BVH_STACK];
+    float entry[HWR_BVH_STACK];
+    uint top = 0;
+    if (nodeCount > 0) {
+        const BvhNode root = nodes[0];
+        const float t = hwr_ray_box(o, invD, tMin, limit, (float3)(root.minX, root.minY, root.minZ),
+                                    (float3)(root.maxX, root.maxY, root.maxZ));
+        if (t < INFINITY) {
+            stack[top] = 0;
+            entry[top++] = t;
+        }
+    }
+    while (top > 0) {
+        --top;
+        if (entry[top] > limit) continue;
+        const BvhNode n = nodes[stack[top]];
+        if (n.count == 0) {
+            const BvhNode l = nodes[n.leftFirst];
+            const BvhNode r = nodes[n.leftFirst + 1];
+            const float tl = hwr_ray_box(o, invD, tMin, limit, (float3)(l.minX, l.minY, l.minZ),
+                                         (float3)(l.maxX, l.maxY, l.maxZ));
+            const float tr = hwr_ray_box(o, invD, tMin, limit, (float3)(r.minX, r.minY, r.minZ),
+                                         (float3)(r.maxX, r.maxY, r.maxZ));
+            // Far child first, so the near one is popped first.
+            const bool leftNear = tl <= tr;
+            const float tNear = leftNear ? tl : tr;
+            const float tFar = leftNear ? tr : tl;
+            if (tFar < INFINITY) {
+                stack[top] = leftNear ? n.leftFirst + 1 : n.leftFirst;
+                entry[top++] = tFar;
+            }
+            if (tNear < INFINITY) {
+                stack[top] = leftNear ? n.leftFirst : n.leftFirst + 1;
+                entry[top++] = tNear;
+            }
+            continue;
+        }
+        for (uint i = n.leftFirst; i < n.leftFirst + n.count; ++i) {
+            const uint prim = indices[i];
+            const Aabb b = bounds[prim];
+            const float t = hwr_ray_box(o, invD, tMin, limit, b.min.xyz, b.max.xyz);
+            if (t < hit.t) {
+                hit.primitive = prim;
+                hit.t = t;
+                limit = t;
+            }
+        }
+    }
+    hits[gid] = hit;
+}
+)CLC";
+
+        constexpr uint32_t BIN_COUNT = 16;
+        // Cost of visiting a node relative to testing one primitive.
+        constexpr float TRAVERSAL_COST = 1.0f;
+        // Subtrees at least this large are built as jobs of their own.
+        constexpr uint32_t PARALLEL_SUBTREE_SIZE = 4096;
+        // Nodes at least this large are binned across the pool.
+        constexpr size_t PARALLEL_BIN_SIZE = 65536;
+        constexpr size_t BIN_GRAIN = 16384;
+        constexpr size_t REFIT_GRAIN = 4096;
+        // Subtree roots handed to the device, one per work-item.
+        constexpr size_t DEVICE_ROOT_COUNT = 256;
+
+        constexpr float INF = std::numeric_limits<float>::infinity();
+
+        Aabb emptyBox() {
+            return { { INF, INF, INF, 0.0f }, { -INF, -INF, -INF, 0.0f } };
+        }
+
+        void growPoint(Aabb& box, const vec4f& p) {
+            const detail::simd::f32x4 v = detail::load(p);
+            box.min = detail::store(detail::simd::min(detail::load(box.min), v));
+            box.max = detail::store(detail::simd::max(detail::load(box.max), v));
+        }
+
+        void grow(Aabb& box, const Aabb& other) {
+            box.min = detail::store(detail::simd::min(detail::load(box.min), detail::load(other.min)));
+            box.max = detail::store(detail::simd::max(detail::load(box.max), detail::load(other.max)));
+        }
+
+        float surfaceArea(const Aabb& box) {
+            const float dx = box.max.x - box.min.x;
+            const float dy = box.max.y - box.min.y;
+            const float dz = box.max.z - box.min.z;
+            return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+        }
+
+        float component(const vec4f& v, int axis) {
+            return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+        }
+
+        vec4f centroid(const Aabb& box) {
+            return vec_scale(vec_add(box.min, box.max), 0.5f);
+        }
+
+        Aabb sphereBox(const_vec4f_soa spheres, size_t i) {
+            const float r = spheres.w[i];
+            return { { spheres.x[i] - r, spheres.y[i] - r, spheres.z[i] - r, 0.0f },
+                     { spheres.x[i] + r, spheres.y[i] + r, spheres.z[i] + r, 0.0f } };
+        }
+
+        Aabb nodeBox(const BvhNode& n) {
+            return { { n.minX, n.minY, n.minZ, 0.0f }, { n.maxX, n.maxY, n.maxZ, 0.0f } };
+        }
+
+        void setNodeBox(BvhNode& n, const Aabb& box) {
+            n.minX = box.min.x;
+            n.minY = box.min.y;
+            n.minZ = box.min.z;
+            n.maxX = box.max.x;
+            n.maxY = box.max.y;
+            n.maxZ = box.max.z;
+        }
+
+        enum class Overlap { OUTSIDE, PARTIAL, INSIDE };
+
+        Overlap classify(const Frustum& frustum, const Aabb& box) {
+            Overlap res = Overlap::INSIDE;
+            for (const vec4f& p : frustum.planes) {
+                // Box corners farthest along and against the plane normal.
+                const float farthest = p.w + p.x * (p.x >= 0.0f ? box.max.x : box.min.x)
+                                      + p.y * (p.y >= 0.0f ? box.max.y : box.min.y)
+                                      + p.z * (p.z >= 0.0f ? box.max.z : box.min.z);
+                if (farthest < 0.0f) {
+                    return Overlap::OUTSIDE;
+                }
+                const float nearest = p.w + p.x * (p.x >= 0.0f ? box.min.x : box.max.x)
+                                       + p.y * (p.y >= 0.0f ? box.min.y : box.max.y)
+                                       + p.z * (p.z >= 0.0f ? box.min.z : box.max.z);
+                if (nearest < 0.0f) {
+                    res = Overlap::PARTIAL;
+                }
+            }
+            return res;
+        }
+
+        // Same as hwr_ray_box() in the kernel.
+        float rayBox(const vec4f& o, const vec4f& invD, float tMin, float tMax, const Aabb& box) {
+            float enter = tMin;
+            float exit = tMax;
+            for (int a = 0; a < 3; ++a) {
+                const float t0 = (component(box.min, a) - component(o, a)) * component(invD, a);
+                const float t1 = (component(box.max, a) - component(o, a)) * component(invD, a);
+                // fmin/fmax drop the NaN of a ray lying in a slab plane.
+                enter = std::fmax(enter, std::fmin(t0, t1));
+                exit = std::fmin(exit, std::fmax(t0, t1));
+            }
+            return enter <= exit ? enter : INF;
+        }
+
+        // fn(begin, end, partial) over [first, first + count), across the
+        // pool for large ranges, accumulating into result.
+        template<typename T, typename Fn, typename Merge>
+        void reduceRange(ThreadPool& pool, size_t first, size_t count, T& result,
+                         const Fn& fn, const Merge& merge)
+        {
+            if (count < PARALLEL_BIN_SIZE) {
+                fn(first, first + count, result);
+                return;
+            }
+            std::vector<T> partial((count + BIN_GRAIN - 1) / BIN_GRAIN, result);
+            pool.parallelFor(count, BIN_GRAIN, [&](size_t begin, size_t end) {
+                fn(first + begin, first + end, partial[begin / BIN_GRAIN]);
+            });
+            for (const T& p : partial) {
+                merge(result, p);
+            }
+        }
+
+        struct Bin {
+            Aabb bounds;
+            Aabb centroids;
+            uint32_t count;
+        };
+
+        // Small nodes use fewer bins; only the bins in use are initialized,
+        // as most nodes are small.
+        struct Bins {
+            uint32_t binCount;
+            Bin bins[3][BIN_COUNT];
+
+            explicit Bins(uint32_t primitives)
+                : binCount(std::clamp(primitives, 4u, BIN_COUNT))
+            {
+                for (auto& axis : bins) {
+                    for (uint32_t k = 0; k < binCount; ++k) {
+                        axis[k] = { emptyBox(), emptyBox(), 0 };
+                    }
+                }
+            }
+        };
+
+        struct BvhMetrics {
+            Counter& builds = metrics().counter("bvh.builds");
+            Histogram& buildLatency = metrics().histogram("bvh.build_ms");
+            Histogram& refitLatency = metrics().histogram("bvh.refit_ms");
+        };
+
+        BvhMetrics& bvhMetrics() {
+            static BvhMetrics m;
+            return m;
+        }
+
+    }
+
+    struct Bvh::BuildState {
+        ThreadPool& pool;
+        JobCounter subtrees;
+        std::vector<vec4f> centroids;
+        std::atomic<uint32_t> nodeCount{1};
+    };
+
+    // Primitives [first, first + count) of m_indices, with their box and
+    // the box of their centroids.
+    struct Bvh::Range {
+        uint32_t first;
+        uint32_t count;
+        Aabb bounds;
+        Aabb centroids;
+    };
+
+    void Bvh::build(std::span<const Aabb> bounds, ThreadPool& pool) {
+        m_bounds.assign(bounds.begin(), bounds.end());
+        buildTree(pool);
+    }
+
+    void Bvh::build(const_vec4f_soa spheres, size_t count, ThreadPool& pool) {
+        m_bounds.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            m_bounds[i] = sphereBox(spheres, i);
+        }
+        buildTree(pool);
+    }
+
+    void Bvh::refit(std::span<const Aabb> bounds, ThreadPool& pool) {
+        if (bounds.size() != m_bounds.size()) {
+            HWR_FATAL("Bvh::refit - primitive count differs from the last build");
+        }
+        std::copy(bounds.begin(), bounds.end(), m_bounds.begin());
+        refitNodes(pool);
+    }
+
+    void Bvh::refit(const_vec4f_soa spheres, size_t count, ThreadPool& pool) {
+        if (count != m_bounds.size()) {
+            HWR_FATAL("Bvh::refit - primitive count differs from the last build");
+        }
+        for (size_t i = 0; i < count; ++i) {
+            m_bounds[i] = sphereBox(spheres, i);
+        }
+        refitNodes(pool);
+    }
+
+    void Bvh::buildTree(ThreadPool& pool) {
+        ScopedTimer timer(bvhMetrics().buildLatency);
+        bvhMetrics().builds.add();
+        if (m_bounds.size() > std::numeric_limits<uint32_t>::max() / 2) {
+            HWR_FATAL("Bvh::build - too many primitives");
+        }
+        const uint32_t count = static_cast<uint32_t>(m_bounds.size());
+        m_indices.resize(count);
+        std::iota(m_indices.begin(), m_indices.end(), 0u);
+        m_nodes.clear();
+        m_roots.clear();
+        if (count == 0) {
+            return;
+        }
+
+        // Every split leaves both sides non-empty: at most 2n - 1 nodes.
+        m_nodes.resize(2 * size_t{count} - 1);
+        BuildState state{ pool, {}, std::vector<vec4f>(count), {1} };
+        Bin root = { emptyBox(), emptyBox(), 0 };
+        reduceRange(pool, 0, count, root,
+            [&](size_t begin, size_t end, Bin& r) {
+                for (size_t i = begin; i < end; ++i) {
+                    state.centroids[i] = centroid(m_bounds[i]);
+                    grow(r.bounds, m_bounds[i]);
+                    growPoint(r.centroids, state.centroids[i]);
+                }
+            },
+            [](Bin& a, const Bin& b) {
+                grow(a.bounds, b.bounds);
+                grow(a.centroids, b.centroids);
+            });
+        buildNode(state, 0, { 0, count, root.bounds, root.centroids }, 0);
+        pool.wait(state.subtrees);
+        m_nodes.resize(state.nodeCount.load(std::memory_order_relaxed));
+        collectRoots();
+    }
+
+    void Bvh::buildNode(BuildState& state, uint32_t node, const Range& range, uint32_t depth) {
+        const uint32_t first = range.first;
+        const uint32_t count = range.count;
+        BvhNode& n = m_nodes[node];
+        setNodeBox(n, range.bounds);
+        const auto makeLeaf = [&] {
+            n.leftFirst = first;
+            n.count = count;
+        };
+        if (count == 1 || depth >= MAX_DEPTH) {
+            makeLeaf();
+            return;
+        }
+
+        Bins bins(count);
+        const uint32_t binCount = bins.binCount;
+        float scale[3];
+        for (int a = 0; a < 3; ++a) {
+            const float extent = component(range.centroids.max, a) - component(range.centroids.min, a);
+            scale[a] = extent > 0.0f ? static_cast<float>(binCount) / extent : 0.0f;
+        }
+        const auto binOf = [&](uint32_t prim, int a) {
+            const float offset = component(state.centroids[prim], a) - component(range.centroids.min, a);
+            return std::min(binCount - 1, static_cast<uint32_t>(offset * scale[a]));
+        };
+
+        reduceRange(state.pool, first, count, bins,
+            [&](size_t begin, size_t end, Bins& out) {
+                for (size_t i = begin; i < end; ++i) {
+                    const uint32_t prim = m_indices[i];
+                    for (int a = 0; a < 3; ++a) {
+                        if (scale[a] > 0.0f) {
+                            Bin& bin = out.bins[a][binOf(prim, a)];
+                            grow(bin.bounds, m_bounds[prim]);
+                            growPoint(bin.centroids, state.centroids[prim]);
+                            ++bin.count;
+                        }
+                    }
+                }
+            },
+            [](Bins& a, const Bins& b) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    for (uint32_t k = 0; k < a.binCount; ++k) {
+                        grow(a.bins[axis][k].bounds, b.bins[axis][k].bounds);
+                        grow(a.bins[axis][k].centroids, b.bins[axis][k].centroids);
+                        a.bins[axis][k].count += b.bins[axis][k].count;
+                    }
+                }
+            });
+
+        // Sweep each axis: bins [0, k) go left, [k, binCount) go right.
+        float bestCost = INF;
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (int a = 0; a < 3; ++a) {
+            if (scale[a] <= 0.0f) {
+                continue;
+            }
+            float rightArea[BIN_COUNT];
+            uint32_t rightCount[BIN_COUNT];
+            Aabb box = emptyBox();
+            uint32_t inside = 0;
+            for (uint32_t k = binCount - 1; k > 0; --k) {
+                grow(box, bins.bins[a][k].bounds);
+                inside += bins.bins[a][k].count;
+                rightArea[k] = surfaceArea(box);
+                rightCount[k] = inside;
+            }
+            box = emptyBox();
+            inside = 0;
+            for (uint32_t k = 1; k < binCount; ++k) {
+                grow(box, bins.bins[a][k - 1].bounds);
+                inside += bins.bins[a][k - 1].count;
+                if (inside == 0 || rightCount[k] == 0) {
+                    continue;
+                }
+                const float cost = surfaceArea(box) * static_cast<float>(inside)
+                                 + rightArea[k] * static_cast<float>(rightCount[k]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = k;
+                }
+            }
+        }
+
+        Range left{ first, 0, emptyBox(), emptyBox() };
+        Range right{ first, 0, emptyBox(), emptyBox() };
+        if (bestAxis < 0) {
+            // All centroids coincide; only the leaf size forces a split.
+            if (count <= MAX_LEAF_SIZE) {
+                makeLeaf();
+                return;
+            }
+            left.count = count / 2;
+            for (uint32_t i = first; i < first + left.count; ++i) {
+                grow(left.bounds, m_bounds[m_indices[i]]);
+            }
+            for (uint32_t i = first + left.count; i < first + count; ++i) {
+                grow(right.bounds, m_bounds[m_indices[i]]);
+            }
+            left.centroids = right.centroids = range.centroids;
+        } else {
+            const float nodeArea = surfaceArea(range.bounds);
+            if (count <= MAX_LEAF_SIZE
+                && TRAVERSAL_COST * nodeArea + bestCost >= nodeArea * static_cast<float>(count)) {
+                makeLeaf();
+                return;
+            }
+            // The bins on each side give the children's boxes for free.
+            for (uint32_t k = 0; k < binCount; ++k) {
+                const Bin& bin = bins.bins[bestAxis][k];
+                Range& side = k < bestSplit ? left : right;
+                grow(side.bounds, bin.bounds);
+                grow(side.centroids, bin.centroids);
+                side.count += bin.count;
+            }
+            const auto begin = m_indices.begin() + first;
+            std::partition(begin, begin + count, [&](uint32_t prim) {
+                return binOf(prim, bestAxis) < bestSplit;
+            });
+        }
+        right.first = first + left.count;
+        right.count = count - left.count;
+
+        const uint32_t child = state.nodeCount.fetch_add(2, std::memory_order_relaxed);
+        n.leftFirst = child;
+        n.count = 0;
+        if (right.count >= PARALLEL_SUBTREE_SIZE) {
+            state.pool.submit([this, &state, child, right, depth] {
+                buildNode(state, child + 1, right, depth + 1);
+            }, state.subtrees);
+        } else {
+            buildNode(state, child + 1, right, depth + 1);
+        }
+        buildNode(state, child, left, depth + 1);
+    }
+
+    void Bvh::refitNodes(ThreadPool& pool) {
+        ScopedTimer timer(bvhMetrics().refitLatency);
+        // Leaves hold nearly all the work and are independent; the inner
+        // nodes then go bottom-up, children being stored after parents.
+        pool.parallelFor(m_nodes.size(), REFIT_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                BvhNode& n = m_nodes[i];
+                if (n.count == 0) {
+                    continue;
+                }
+                Aabb box = emptyBox();
+                for (uint32_t k = n.leftFirst; k < n.leftFirst + n.count; ++k) {
+                    grow(box, m_bounds[m_indices[k]]);
+                }
+                setNodeBox(n, box);
+            }
+        });
+        for (size_t i = m_nodes.size(); i-- > 0;) {
+            BvhNode& n = m_nodes[i];
+            if (n.count == 0) {
+                Aabb box = nodeBox(m_nodes[n.leftFirst]);
+                grow(box, nodeBox(m_nodes[n.leftFirst + 1]));
+                setNodeBox(n, box);
+            }
+        }
+    }
+
+    void Bvh::collectRoots() {
+        // Expand level by level until there are enough subtrees.
+        m_roots.assign(1, 0);
+        std::vector<uint32_t> next;
+        while (m_roots.size() < DEVICE_ROOT_COUNT) {
+            next.clear();
+            bool expanded = false;
+            for (uint32_t r : m_roots) {
+                const BvhNode& n = m_nodes[r];
+                if (n.count == 0) {
+                    next.push_back(n.leftFirst);
+                    next.push_back(n.leftFirst + 1);
+                    expanded = true;
+                } else {
+                    next.push_back(r);
+                }
+            }
+            if (!expanded) {
+                break;
+            }
+            m_roots.swap(next);
+        }
+    }
+
+    size_t Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+        visible.clear();
+        if (m_nodes.empty()) {
+            return 0;
+        }
+        std::vector<uint32_t> stack{ 0 };
+        while (!stack.empty()) {
+            const uint32_t i = stack.back();
+            stack.pop_back();
+            const BvhNode& n = m_nodes[i];
+            const Overlap overlap = classify(frustum, nodeBox(n));
+            if (overlap == Overlap::OUTSIDE) {
+                continue;
+            }
+            if (overlap == Overlap::INSIDE) {
+                // A subtree covers one contiguous run of primitiveIndices(),
+                // from its leftmost to its rightmost leaf.
+                uint32_t lo = i;
+                uint32_t hi = i;
+                while (m_nodes[lo].count == 0) lo = m_nodes[lo].leftFirst;
+                while (m_nodes[hi].count == 0) hi = m_nodes[hi].leftFirst + 1;
+                visible.insert(visible.end(),
+                               m_indices.begin() + m_nodes[lo].leftFirst,
+                               m_indices.begin() + m_nodes[hi].leftFirst + m_nodes[hi].count);
+                continue;
+            }
+            if (n.count == 0) {
+                stack.push_back(n.leftFirst);
+                stack.push_back(n.leftFirst + 1);
+                continue;
+            }
+            for (uint32_t k = n.leftFirst; k < n.leftFirst + n.count; ++k) {
+                if (classify(frustum, m_bounds[m_indices[k]]) != Overlap::OUTSIDE) {
+                    visible.push_back(m_indices[k]);
+                }
+            }
+        }
+        return visible.size();
+    }
+
+    std::optional<BvhHit> Bvh::raycast(const BvhRay& ray) const {
+        if (m_nodes.empty()) {
+            return std::nullopt;
+        }
+        const vec4f& o = ray.origin;
+        const vec4f invD = { 1.0f / ray.direction.x, 1.0f / ray.direction.y,
+                             1.0f / ray.direction.z, 0.0f };
+        const float tMin = ray.origin.w;
+        float limit = ray.direction.w;
+        BvhHit hit = { BVH_NO_HIT, INF };
+
+        struct Entry { uint32_t node; float t; };
+        std::vector<Entry> stack;
+        const float tRoot = rayBox(o, invD, tMin, limit, nodeBox(m_nodes[0]));
+        if (tRoot < INF) {
+            stack.push_back({ 0, tRoot });
+        }
+        while (!stack.empty()) {
+            const Entry e = stack.back();
+            stack.pop_back();
+            if (e.t > limit) {
+                continue;
+            }
+            const BvhNode& n = m_nodes[e.node];
+            if (n.count == 0) {
+                const float tl = rayBox(o, invD, tMin, limit, nodeBox(m_nodes[n.leftFirst]));
+                const float tr = rayBox(o, invD, tMin, limit, nodeBox(m_nodes[n.leftFirst + 1]));
+                // Far child first, so the near one is popped first.
+                const bool leftNear = tl <= tr;
+                const Entry nearChild{ leftNear ? n.leftFirst : n.leftFirst + 1, leftNear ? tl : tr };
+                const Entry farChild{ leftNear ? n.leftFirst + 1 : n.leftFirst, leftNear ? tr : tl };
+                if (farChild.t < INF) {
+                    stack.push_back(farChild);
+                }
+                if (nearChild.t < INF) {
+                    stack.push_back(nearChild);
+                }
+                continue;
+            }
+            for (uint32_t k = n.leftFirst; k < n.leftFirst + n.count; ++k) {
+                const uint32_t prim = m_indices[k];
+                const float t = rayBox(o, invD, tMin, limit, m_bounds[prim]);
+                if (t < hit.t) {
+                    hit = { prim, t };
+                    limit = t;
+                }
+            }
+        }
+        if (hit.primitive == BVH_NO_HIT) {
+            return std::nullopt;
+        }
+        return hit;
+    }
+
+    DeviceBvh::DeviceBvh(const GPUContext& ctx)
+        : m_ctx(ctx)
+        , m_cull(ctx, std::string(detail::BVH_DEVICE_HELPERS) + BVH_KERNELS, "hwr_bvh_cull")
+        , m_raycast(ctx, std::string(detail::BVH_DEVICE_HELPERS) + BVH_KERNELS, "hwr_bvh_raycast")
+        , m_visibleCount(ctx, 1)
+    {}
+
+    template<typename T>
+    void DeviceBvh::uploadArray(Buffer<T>& buffer, std::span<const T> data) {
+        // Kernels cannot take empty buffers; an empty tree keeps one
+        // unused element.
+        const size_t size = std::max<size_t>(data.size(), 1);
+        if (!buffer || buffer->size() != size) {
+            buffer = std::make_unique<HostProducedBuffer<T>>(m_ctx, size);
+        }
+        buffer->writeFrom(data, 0);
+    }
+
+    void DeviceBvh::upload(const Bvh& bvh) {
+        uploadArray(m_nodes, bvh.nodes());
+        uploadArray(m_indices, bvh.primitiveIndices());
+        uploadArray(m_bounds, bvh.primitiveBounds());
+        uploadArray(m_roots, bvh.subtreeRoots());
+        m_primitiveCount = bvh.primitiveCount();
+        m_nodeCount = bvh.nodes().size();
+        m_rootCount = bvh.subtreeRoots().size();
+    }
+
+    size_t DeviceBvh::cull(const Frustum& frustum, const BaseBuffer<uint32_t>& visible) {
+        if (m_rootCount == 0) {
+            return 0;
+        }
+        if (visible.size() < m_primitiveCount) {
+            HWR_FATAL("DeviceBvh::cull - visible buffer smaller than the primitive count");
+        }
+        m_visibleCount.writeFrom(std::vector<uint32_t>{ 0 });
+        const vec4f* p = frustum.planes;
+        m_cull.setArgs(p[0], p[1], p[2], p[3], p[4], p[5],
+                       *m_nodes, *m_indices, *m_bounds, *m_roots,
+                       static_cast<cl_uint>(m_rootCount), visible, m_visibleCount);
+        m_cull.dispatch(cl::NDRange(m_rootCount));
+        std::vector<uint32_t> visibleCount;
+        m_visibleCount.readTo(visibleCount);
+        return visibleCount[0];
+    }
+
+    void DeviceBvh::raycast(const BaseBuffer<BvhRay>& rays, const BaseBuffer<BvhHit>& hits, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        if (!m_nodes) {
+            HWR_FATAL("DeviceBvh::raycast - nothing uploaded");
+        }
+        if (count > std::numeric_limits<cl_uint>::max()
+            || rays.size() < count || hits.size() < count) {
+            HWR_FATAL("DeviceBvh::raycast - buffers smaller than count");
+        }
+        m_raycast.setArgs(*m_nodes, *m_indices, *m_bounds, static_cast<cl_uint>(m_nodeCount),
+                          rays, hits, static_cast<cl_uint>(count));
+        m_raycast.dispatch(cl::NDRange(count));
+    }
+
+} // namespace hwr
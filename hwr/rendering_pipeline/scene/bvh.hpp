@@ -0,0 +1,163 @@
+#ifndef HWR_BVH_HPP
+#define HWR_BVH_HPP
+
+#include "../cull/transform_cull.hpp"
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/kernel/kernel.hpp"
+#include "../../util/jobs/thread_pool.hpp"
+#include "../../util/math/math_util.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+// Axis-aligned box; w is unused.
+struct Aabb {
+    vec4f min;
+    vec4f max;
+};
+
+// One node of the linearized tree, laid out the same on host and device.
+// Internal nodes (count == 0) have their children at leftFirst and
+// leftFirst + 1; leaves cover primitiveIndices()[leftFirst, leftFirst + count).
+struct BvhNode {
+    float minX, minY, minZ;
+    uint32_t leftFirst;
+    float maxX, maxY, maxZ;
+    uint32_t count;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode must match the device layout");
+
+// origin.w is where the ray starts (t min), direction.w where it ends (t max).
+struct BvhRay {
+    vec4f origin;
+    vec4f direction;
+};
+
+inline constexpr uint32_t BVH_NO_HIT = std::numeric_limits<uint32_t>::max();
+
+// Nearest primitive box along a ray; primitive is BVH_NO_HIT on a miss.
+struct BvhHit {
+    uint32_t primitive;
+    float t;
+};
+
+namespace detail {
+
+    // OpenCL C declarations of BvhNode, Aabb, BvhRay and BvhHit plus the
+    // box tests, for kernels that walk a DeviceBvh themselves.
+    extern const char* const BVH_DEVICE_HELPERS;
+
+} // namespace detail
+
+/**
+* \class Bvh
+* \brief Bounding volume hierarchy over primitive boxes, for culling and
+*        picking queries.
+*
+* build() splits with a binned surface area heuristic. Large subtrees are
+* built as separate jobs and the largest nodes are binned across the pool.
+* refit() keeps the tree and only recomputes the boxes, for primitives
+* that moved but kept their identity; the tree degrades as things move
+* far, so rebuild now and then.
+*
+* Children are always stored after their parent, so nodes() can be
+* walked backwards to go bottom-up.
+*/
+class Bvh {
+public:
+    static constexpr uint32_t MAX_LEAF_SIZE = 8;
+    // Deeper nodes become leaves; bounds the traversal stacks.
+    static constexpr uint32_t MAX_DEPTH = 48;
+
+    void build(std::span<const Aabb> bounds, ThreadPool& pool = jobs());
+    // Bounding spheres, center in xyz and radius in w (SceneGraph::worldBounds()).
+    void build(const_vec4f_soa spheres, size_t count, ThreadPool& pool = jobs());
+
+    // Same primitives, in the same order, as the last build().
+    void refit(std::span<const Aabb> bounds, ThreadPool& pool = jobs());
+    void refit(const_vec4f_soa spheres, size_t count, ThreadPool& pool = jobs());
+
+    // Primitives whose box is at least partially inside the frustum, in no
+    // particular order. Returns visible.size().
+    size_t cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // Nearest primitive box hit by the ray.
+    std::optional<BvhHit> raycast(const BvhRay& ray) const;
+
+    size_t primitiveCount() const { return m_bounds.size(); }
+    std::span<const BvhNode> nodes() const { return m_nodes; }
+    std::span<const uint32_t> primitiveIndices() const { return m_indices; }
+    std::span<const Aabb> primitiveBounds() const { return m_bounds; }
+    // Disjoint subtrees covering every primitive, one device work-item each.
+    std::span<const uint32_t> subtreeRoots() const { return m_roots; }
+
+private:
+    struct BuildState;
+    struct Range;
+
+    void buildTree(ThreadPool& pool);
+    void buildNode(BuildState& state, uint32_t node, const Range& range, uint32_t depth);
+    void refitNodes(ThreadPool& pool);
+    void collectRoots();
+
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_indices;
+    std::vector<Aabb> m_bounds;
+    std::vector<uint32_t> m_roots;
+};
+
+/**
+* \class DeviceBvh
+* \brief Device copy of a Bvh with culling and ray picking kernels.
+*
+* cull() runs one work-item per subtree root and, like
+* DeviceTransformCull, writes the visible primitives in no particular
+* order and reads back how many there are. raycast() runs one work-item
+* per ray.
+*/
+class DeviceBvh {
+public:
+    explicit DeviceBvh(const GPUContext& ctx);
+
+    // Call after every build() or refit().
+    void upload(const Bvh& bvh);
+
+    size_t cull(const Frustum& frustum, const BaseBuffer<uint32_t>& visible);
+    void raycast(const BaseBuffer<BvhRay>& rays, const BaseBuffer<BvhHit>& hits, size_t count);
+
+    // For kernels that traverse the tree themselves; valid after upload().
+    bool uploaded() const { return m_nodes != nullptr; }
+    const BaseBuffer<BvhNode>& nodes() const { return *m_nodes; }
+    const BaseBuffer<uint32_t>& primitiveIndices() const { return *m_indices; }
+    size_t nodeCount() const { return m_nodeCount; }
+    size_t primitiveCount() const { return m_primitiveCount; }
+
+private:
+    template<typename T>
+    using Buffer = std::unique_ptr<HostProducedBuffer<T>>;
+
+    template<typename T>
+    void uploadArray(Buffer<T>& buffer, std::span<const T> data);
+
+    const GPUContext& m_ctx;
+    Kernel m_cull;
+    Kernel m_raycast;
+    Buffer<BvhNode> m_nodes;
+    Buffer<uint32_t> m_indices;
+    Buffer<Aabb> m_bounds;
+    Buffer<uint32_t> m_roots;
+    AllPurposeBuffer<uint32_t> m_visibleCount;
+    size_t m_primitiveCount = 0;
+    size_t m_nodeCount = 0;
+    size_t m_rootCount = 0;
+};
+
+} // namespace hwr
+
+#endif // HWR_BVH_HPP
@@ -0,0 +1,205 @@
+#include "scene_graph.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace hwr {
+
+    namespace {
+
+        const char* SCENE_SCATTER_SOURCE = R"CLC(
+__kernel void hwr_scatter_matrices(__global const float16* src,
+    __global const uint* index, const uint count, __global float16* dst)
+{
+    const uint i = get_global_id(0);
+    if (i >= count) return;
+    dst[index[i]] = src[i];
+}
+)CLC";
+
+        // Nodes per job when a depth level is spread over the pool.
+        constexpr size_t UPDATE_GRAIN = 512;
+
+        struct SceneMetrics {
+            Counter& updatedNodes = metrics().counter("scene.updated_nodes");
+            Counter& uploadedMatrices = metrics().counter("scene.uploaded_matrices");
+            Counter& fullUploads = metrics().counter("scene.full_uploads");
+        };
+
+        SceneMetrics& sceneMetrics() {
+            static SceneMetrics m;
+            return m;
+        }
+
+        // Largest factor the matrix scales a length by (longest basis axis).
+        float maxScale(const mat4f& m) {
+            float longest = 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                const float len2 = m.m[0][c] * m.m[0][c] + m.m[1][c] * m.m[1][c]
+                                 + m.m[2][c] * m.m[2][c];
+                longest = std::max(longest, len2);
+            }
+            return std::sqrt(longest);
+        }
+
+    }
+
+    NodeId SceneGraph::addNode(NodeId parent, const mat4f& local, const vec4f& bounds) {
+        if (parent != NO_NODE && parent >= m_parent.size()) {
+            HWR_FATAL("SceneGraph::addNode - parent does not exist");
+        }
+        if (m_parent.size() >= NO_NODE) {
+            HWR_FATAL("SceneGraph::addNode - too many nodes");
+        }
+        const NodeId node = static_cast<NodeId>(m_parent.size());
+        m_parent.push_back(parent);
+        m_depth.push_back(parent == NO_NODE ? 0 : m_depth[parent] + 1);
+        m_local.push_back(local);
+        m_bounds.push_back(bounds);
+        m_world.push_back(local);
+        m_worldX.push_back(0.0f);
+        m_worldY.push_back(0.0f);
+        m_worldZ.push_back(0.0f);
+        m_worldRadius.push_back(0.0f);
+        m_dirty.push_back(0);
+        m_inChanged.push_back(0);
+        markDirty(node);
+        return node;
+    }
+
+    void SceneGraph::setLocal(NodeId node, const mat4f& local) {
+        HWR_ASSERT(node < m_parent.size(), "SceneGraph::setLocal - no such node");
+        m_local[node] = local;
+        markDirty(node);
+    }
+
+    void SceneGraph::setBounds(NodeId node, const vec4f& bounds) {
+        HWR_ASSERT(node < m_parent.size(), "SceneGraph::setBounds - no such node");
+        m_bounds[node] = bounds;
+        markDirty(node);
+    }
+
+    void SceneGraph::markDirty(NodeId node) {
+        m_dirty[node] = 1;
+        m_firstDirty = std::min(m_firstDirty, node);
+    }
+
+    size_t SceneGraph::update(ThreadPool& pool) {
+        if (m_firstDirty == NO_NODE) {
+            return 0;
+        }
+
+        // Parents come first, so one pass from the first marked node
+        // extends the marks over whole subtrees. Nothing before it can be
+        // affected.
+        for (std::vector<NodeId>& level : m_levels) {
+            level.clear();
+        }
+        size_t count = 0;
+        for (NodeId i = m_firstDirty; i < m_parent.size(); ++i) {
+            const NodeId p = m_parent[i];
+            if (!m_dirty[i] && (p == NO_NODE || !m_dirty[p])) {
+                continue;
+            }
+            m_dirty[i] = 1;
+            if (m_depth[i] >= m_levels.size()) {
+                m_levels.resize(m_depth[i] + 1);
+            }
+            m_levels[m_depth[i]].push_back(i);
+            ++count;
+        }
+
+        // A level only reads the world matrices of the one above it.
+        for (const std::vector<NodeId>& level : m_levels) {
+            pool.parallelFor(level.size(), UPDATE_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    updateNode(level[k]);
+                }
+            });
+        }
+
+        for (const std::vector<NodeId>& level : m_levels) {
+            for (NodeId node : level) {
+                m_dirty[node] = 0;
+                if (!m_inChanged[node]) {
+                    m_inChanged[node] = 1;
+                    m_changed.push_back(node);
+                }
+            }
+        }
+        m_firstDirty = NO_NODE;
+        sceneMetrics().updatedNodes.add(count);
+        return count;
+    }
+
+    void SceneGraph::updateNode(NodeId node) {
+        const NodeId p = m_parent[node];
+        const mat4f& world = m_world[node] = p == NO_NODE
+            ? m_local[node]
+            : mat_mul(m_world[p], m_local[node]);
+        const vec4f& b = m_bounds[node];
+        const vec4f center = mat_mul_vec(world, { b.x, b.y, b.z, 1.0f });
+        m_worldX[node] = center.x;
+        m_worldY[node] = center.y;
+        m_worldZ[node] = center.z;
+        m_worldRadius[node] = b.w * maxScale(world);
+    }
+
+    void SceneGraph::clearChanged() {
+        for (NodeId node : m_changed) {
+            m_inChanged[node] = 0;
+        }
+        m_changed.clear();
+    }
+
+    DeviceSceneTransforms::DeviceSceneTransforms(const GPUContext& ctx, size_t capacity)
+        : m_ctx(ctx)
+        , m_scatter(ctx, SCENE_SCATTER_SOURCE, "hwr_scatter_matrices")
+        , m_world(std::make_unique<MatrixBuffer>(ctx, std::max<size_t>(capacity, 1)))
+    {}
+
+    size_t DeviceSceneTransforms::upload(SceneGraph& graph) {
+        const size_t nodeCount = graph.size();
+        if (nodeCount > m_world->size()) {
+            const size_t capacity = std::max(nodeCount, m_world->size() * 2);
+            HWR_DEBUG_IN(LogModule::SCENE, "DeviceSceneTransforms - growing to {} matrices", capacity);
+            m_world = std::make_unique<MatrixBuffer>(m_ctx, capacity);
+            ++m_generation;
+            m_needsFullUpload = true;
+        }
+
+        const std::span<const NodeId> changed = graph.changed();
+        size_t written = 0;
+        if (nodeCount > 0 && (m_needsFullUpload || changed.size() * 2 >= nodeCount)) {
+            // The buffer holds nothing usable yet, or too much changed for
+            // the scatter to pay off.
+            m_world->writeFrom(graph.worldMatrices(), 0);
+            sceneMetrics().fullUploads.add();
+            written = nodeCount;
+        } else if (!changed.empty()) {
+            m_packedMatrices.resize(changed.size());
+            m_packedIndices.resize(changed.size());
+            for (size_t i = 0; i < changed.size(); ++i) {
+                m_packedIndices[i] = changed[i];
+                m_packedMatrices[i] = graph.world(changed[i]);
+            }
+            if (!m_stagingMatrices || m_stagingMatrices->size() < changed.size()) {
+                const size_t capacity = std::max(changed.size(),
+                    m_stagingMatrices ? m_stagingMatrices->size() * 2 : size_t{0});
+                m_stagingMatrices = std::make_unique<HostProducedBuffer<mat4f>>(m_ctx, capacity);
+                m_stagingIndices = std::make_unique<HostProducedBuffer<uint32_t>>(m_ctx, capacity);
+            }
+            m_stagingMatrices->writeFrom(std::span<const mat4f>(m_packedMatrices), 0);
+            m_stagingIndices->writeFrom(std::span<const uint32_t>(m_packedIndices), 0);
+            m_scatter.setArgs(*m_stagingMatrices, *m_stagingIndices,
+                              static_cast<cl_uint>(changed.size()), *m_world);
+            m_scatter.dispatch(cl::NDRange(changed.size()));
+            written = changed.size();
+        }
+
+        m_needsFullUpload = false;
+        graph.clearChanged();
+        sceneMetrics().uploadedMatrices.add(written);
+        return written;
+    }
+
+} // namespace hwr
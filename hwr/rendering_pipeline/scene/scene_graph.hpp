@@ -0,0 +1,129 @@
+#ifndef HWR_SCENE_GRAPH_HPP
+#define HWR_SCENE_GRAPH_HPP
+
+#include "../gpu/buffer/gpu_buffer.hpp"
+#include "../gpu/kernel/kernel.hpp"
+#include "../../util/jobs/thread_pool.hpp"
+#include "../../util/math/math_util.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace hwr {
+
+using NodeId = uint32_t;
+inline constexpr NodeId NO_NODE = std::numeric_limits<NodeId>::max();
+
+/**
+* \class SceneGraph
+* \brief Transform hierarchy stored as one flat array per node field.
+*
+* Nodes are numbered in creation order and a parent always exists before
+* its children, so a single forward pass sees every parent first.
+* setLocal() and setBounds() only mark the node; update() recomputes the
+* world matrix and world bounds of the marked nodes and their descendants
+* and leaves every other node alone.
+*
+* Bounds are spheres with the center in xyz and the radius in w. World
+* bounds are kept one array per component, ready for
+* HostTransformCull::cull().
+*/
+class SceneGraph {
+public:
+    NodeId addNode(NodeId parent = NO_NODE,
+                   const mat4f& local = mat_identity(),
+                   const vec4f& bounds = { 0.0f, 0.0f, 0.0f, 0.0f });
+
+    void setLocal(NodeId node, const mat4f& local);
+    void setBounds(NodeId node, const vec4f& bounds);
+
+    size_t size() const { return m_parent.size(); }
+    NodeId parent(NodeId node) const { return m_parent[node]; }
+    const mat4f& local(NodeId node) const { return m_local[node]; }
+
+    // World data as of the last update().
+    const mat4f& world(NodeId node) const { return m_world[node]; }
+    std::span<const mat4f> worldMatrices() const { return m_world; }
+    const_vec4f_soa worldBounds() const {
+        return { m_worldX.data(), m_worldY.data(), m_worldZ.data(), m_worldRadius.data() };
+    }
+
+    // Recomputes the marked subtrees one depth level at a time, each level
+    // spread over pool. Returns how many nodes were recomputed.
+    size_t update(ThreadPool& pool = jobs());
+
+    // Nodes recomputed by update() since the last clearChanged(), each
+    // listed once, in no particular order.
+    std::span<const NodeId> changed() const { return m_changed; }
+    void clearChanged();
+
+private:
+    void markDirty(NodeId node);
+    void updateNode(NodeId node);
+
+    std::vector<NodeId> m_parent;
+    std::vector<uint32_t> m_depth;
+    std::vector<mat4f> m_local;
+    std::vector<vec4f> m_bounds;
+    std::vector<mat4f> m_world;
+    std::vector<float> m_worldX;
+    std::vector<float> m_worldY;
+    std::vector<float> m_worldZ;
+    std::vector<float> m_worldRadius;
+
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint8_t> m_inChanged;
+    std::vector<NodeId> m_changed;
+    NodeId m_firstDirty = NO_NODE;
+    std::vector<std::vector<NodeId>> m_levels; // scratch for update()
+};
+
+/**
+* \class DeviceSceneTransforms
+* \brief Device copy of the world matrices of a SceneGraph, node i at
+*        index i, kept up to date incrementally.
+*
+* upload() only sends the matrices of changed nodes: they are packed with
+* their indices into staging buffers and scattered by a kernel, so a frame
+* costs two small writes and one dispatch however spread out the changes
+* are. When most nodes changed, or the graph outgrew the buffer, the whole
+* array is written instead.
+*
+* Outgrowing the buffer replaces it with one of twice the capacity: the
+* buffer returned by worldMatrices() before that is released. Kernels
+* whose arguments were set from it must be set again whenever
+* generation() has changed since.
+*/
+class DeviceSceneTransforms {
+public:
+    explicit DeviceSceneTransforms(const GPUContext& ctx, size_t capacity = 1024);
+
+    // Call after graph.update(). Sends the matrices in graph.changed(),
+    // clears it and returns how many matrices were written.
+    size_t upload(SceneGraph& graph);
+
+    // Valid until upload() grows the buffer, see generation().
+    const BaseBuffer<mat4f>& worldMatrices() const { return *m_world; }
+    // Changes each time upload() replaces the buffer.
+    uint64_t generation() const { return m_generation; }
+
+private:
+    using MatrixBuffer = GeneralBuffer<mat4f, HOST_WRITE, GPU_READ, GPU_WRITE>;
+
+    const GPUContext& m_ctx;
+    Kernel m_scatter;
+    std::unique_ptr<MatrixBuffer> m_world;
+    uint64_t m_generation = 0;
+    std::unique_ptr<HostProducedBuffer<mat4f>> m_stagingMatrices;
+    std::unique_ptr<HostProducedBuffer<uint32_t>> m_stagingIndices;
+    std::vector<mat4f> m_packedMatrices;
+    std::vector<uint32_t> m_packedIndices;
+    // Set while the buffer does not mirror the graph yet.
+    bool m_needsFullUpload = true;
+};
+
+} // namespace hwr
+
+#endif // HWR_SCENE_GRAPH_HPP
@@ -0,0 +1,67 @@
+#include "visibility_shading.hpp"
+
+namespace hwr::detail {
+
+std::string makeVisibilityShadingSource(const std::string& structDefs,
+                                        const std::string& attributeType,
+                                        const std::string& instanceType,
+                                        ColorFormat format,
+                                        const std::vector<KernelParam>& params,
+                                        const std::string& body)
+{
+    const std::string A = "struct " + attributeType;
+    const std::string I = "struct " + instanceType;
+
+    std::string src(OPENCL_STDINT_PRELUDE);
+    src += structDefs;
+    src += RASTER_HELPERS; // same screen mapping as the visibility raster
+    src += "__kernel void " + std::string(VISIBILITY_SHADING_ENTRY) + "(\n"
+           "    __global const uint* hwr_ids, __global const float* hwr_depths,\n"
+           "    __global const float4* hwr_positions, __global const uint* hwr_indices,\n"
+           "    __global const " + A + "* hwr_attributes,\n"
+           "    __global const " + I + "* hwr_instances,\n"
+           "    const uint hwr_triangle_count, const uint hwr_vertex_count,\n"
+           "    const uint hwr_width, const uint hwr_height,\n"
+           "    " + colorPointerType(format) + " hwr_target"
+           + makeParamList(params) + ")\n"
+           "{\n"
+           "const uint hwr_pixel_x = (uint)get_global_id(0);\n"
+           "const uint hwr_pixel_y = (uint)get_global_id(1);\n"
+           "if (hwr_pixel_x >= hwr_width || hwr_pixel_y >= hwr_height) return;\n"
+           "const size_t hwr_pixel = (size_t)hwr_pixel_y * hwr_width + hwr_pixel_x;\n"
+           "const uint hwr_primitive = hwr_ids[hwr_pixel];\n"
+           "if (hwr_primitive == " + std::to_string(VISIBILITY_EMPTY) + "u) return;\n"
+           "const uint hwr_instance_id = hwr_primitive / hwr_triangle_count;\n"
+           "const uint hwr_triangle_id = hwr_primitive % hwr_triangle_count;\n"
+           "const float hwr_depth = hwr_depths[hwr_pixel];\n"
+           "const uint hwr_i0 = hwr_indices[3 * hwr_triangle_id + 0];\n"
+           "const uint hwr_i1 = hwr_indices[3 * hwr_triangle_id + 1];\n"
+           "const uint hwr_i2 = hwr_indices[3 * hwr_triangle_id + 2];\n"
+           "const size_t hwr_base = (size_t)hwr_instance_id * hwr_vertex_count;\n"
+           "const float4 hwr_c0 = hwr_positions[hwr_base + hwr_i0];\n"
+           "const float4 hwr_c1 = hwr_positions[hwr_base + hwr_i1];\n"
+           "const float4 hwr_c2 = hwr_positions[hwr_base + hwr_i2];\n"
+           "const float3 hwr_s0 = hwr_to_screen(hwr_c0, hwr_width, hwr_height);\n"
+           "const float3 hwr_s1 = hwr_to_screen(hwr_c1, hwr_width, hwr_height);\n"
+           "const float3 hwr_s2 = hwr_to_screen(hwr_c2, hwr_width, hwr_height);\n"
+           "const float2 hwr_p = (float2)((float)hwr_pixel_x + 0.5f, (float)hwr_pixel_y + 0.5f);\n"
+           "float hwr_bary[3];\n"
+           "hwr_bary[0] = hwr_edge(hwr_s1.xy, hwr_s2.xy, hwr_p) / hwr_c0.w;\n"
+           "hwr_bary[1] = hwr_edge(hwr_s2.xy, hwr_s0.xy, hwr_p) / hwr_c1.w;\n"
+           "hwr_bary[2] = hwr_edge(hwr_s0.xy, hwr_s1.xy, hwr_p) / hwr_c2.w;\n"
+           "{\n"
+           "const float hwr_sum = hwr_bary[0] + hwr_bary[1] + hwr_bary[2];\n"
+           "hwr_bary[0] /= hwr_sum; hwr_bary[1] /= hwr_sum; hwr_bary[2] /= hwr_sum;\n"
+           "}\n"
+           "__global const " + A + "* hwr_a0 = hwr_attributes + hwr_i0;\n"
+           "__global const " + A + "* hwr_a1 = hwr_attributes + hwr_i1;\n"
+           "__global const " + A + "* hwr_a2 = hwr_attributes + hwr_i2;\n"
+           "__global const " + I + "* hwr_instance = hwr_instances + hwr_instance_id;\n"
+           "float4 hwr_color = (float4)(0.0f, 0.0f, 0.0f, 1.0f);\n";
+    src += body;
+    src += colorStore(format);
+    src += "}\n";
+    return src;
+}
+
+} // namespace hwr::detail
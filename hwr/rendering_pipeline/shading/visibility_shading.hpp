@@ -0,0 +1,158 @@
+#ifndef HWR_VISIBILITY_SHADING_HPP
+#define HWR_VISIBILITY_SHADING_HPP
+
+#include "../draw/instanced_draw.hpp"
+#include "../framebuffer/framebuffer.hpp"
+#include "../raster/visibility_raster.hpp"
+
+namespace hwr {
+
+// Built-ins usable inside the body of a VisibilityShading pass.
+// The body runs once per covered pixel; uncovered pixels are left alone.
+namespace shading {
+
+    inline ShaderRValue<uint32_t> pixel_x() {
+        return ShaderRValue<uint32_t>(std::string("hwr_pixel_x"));
+    }
+
+    inline ShaderRValue<uint32_t> pixel_y() {
+        return ShaderRValue<uint32_t>(std::string("hwr_pixel_y"));
+    }
+
+    inline ShaderRValue<uint32_t> triangle_id() {
+        return ShaderRValue<uint32_t>(std::string("hwr_triangle_id"));
+    }
+
+    inline ShaderRValue<uint32_t> instance_id() {
+        return ShaderRValue<uint32_t>(std::string("hwr_instance_id"));
+    }
+
+    inline ShaderRValue<float> depth() {
+        return ShaderRValue<float>(std::string("hwr_depth"));
+    }
+
+    // Perspective-correct barycentric weight of corner 0, 1 or 2.
+    inline ShaderRValue<float> barycentric(uint32_t corner) {
+        return ShaderRValue<float>("hwr_bary[" + std::to_string(corner) + "]");
+    }
+
+    // Vertex attribute interpolated across the triangle.
+    template<FloatingType T>
+    ShaderRValue<T> attribute(const std::string& field) {
+        return ShaderRValue<T>("(hwr_bary[0] * hwr_a0->" + field
+                             + " + hwr_bary[1] * hwr_a1->" + field
+                             + " + hwr_bary[2] * hwr_a2->" + field + ")");
+    }
+
+    // Vertex attribute of the triangle's first corner, not interpolated.
+    template<AllowedShaderType T>
+    ShaderRValue<T> flat(const std::string& field) {
+        return ShaderRValue<T>("hwr_a0->" + field);
+    }
+
+    template<AllowedShaderType T>
+    ShaderRValue<T> instance(const std::string& field) {
+        return ShaderRValue<T>("hwr_instance->" + field);
+    }
+
+    // Output color channel 0..3 (r, g, b, a), in [0, 1] for RGBA8 targets.
+    inline ShaderValue<float> color(uint32_t channel) {
+        return ShaderValue<float>(detail::bind_existing,
+                                  "hwr_color.s" + std::to_string(channel));
+    }
+
+} // namespace shading
+
+namespace detail {
+
+    std::string makeVisibilityShadingSource(const std::string& structDefs,
+                                            const std::string& attributeType,
+                                            const std::string& instanceType,
+                                            ColorFormat format,
+                                            const std::vector<KernelParam>& params,
+                                            const std::string& body);
+
+} // namespace detail
+
+inline constexpr const char* VISIBILITY_SHADING_ENTRY = "hwr_visibility_shading";
+
+/**
+* \class VisibilityShading
+* \brief Full-screen pass that shades every covered pixel of a
+*        VisibilityBuffer exactly once, independent of overdraw.
+*
+* Attributes are per mesh vertex (shared by all instances); positions are
+* the clip-space positions the raster stage consumed, used to rebuild
+* perspective-correct barycentrics. Textures and samplers declared in the
+* body (e.g. material maps) are bound by name with bind().
+*/
+template<ShaderStruct Attribute, ShaderStruct Instance>
+class VisibilityShading {
+public:
+    template<typename Lambda,
+        typename = std::enable_if_t<std::is_invocable_v<Lambda>>>
+    VisibilityShading(const GPUContext& ctx, ColorFormat format, Lambda&& body)
+        : m_format(format)
+        , m_body(std::forward<Lambda>(body))
+        , m_kernel(ctx, generateSource(format, m_body), VISIBILITY_SHADING_ENTRY)
+    {
+        detail::declareBodyParams(m_kernel, FIXED_ARGS, m_body.parameters());
+    }
+
+    template<typename T>
+    void bind(const std::string& name, const T& value) {
+        m_kernel.setParam(name, value);
+    }
+
+    template<typename Position>
+    void shade(const VisibilityBuffer& visibility,
+               const BaseBuffer<Position>& positions,
+               const BaseBuffer<uint32_t>& indices,
+               const BaseBuffer<Attribute>& attributes,
+               const BaseBuffer<Instance>& instances,
+               const Framebuffer& target)
+    {
+        static_assert(sizeof(Position) == sizeof(vec4f),
+                      "Positions must be 4 floats: clip-space x, y, z, w");
+        if (target.desc().color != m_format) {
+            HWR_FATAL("VisibilityShading::shade - target color format differs from the pass");
+        }
+        if (target.width() != visibility.width() || target.height() != visibility.height()) {
+            HWR_FATAL("VisibilityShading::shade - target and visibility buffer sizes differ");
+        }
+        if (positions.size() != attributes.size() * instances.size()) {
+            HWR_FATAL("VisibilityShading::shade - positions must hold instanceCount * vertexCount elements");
+        }
+        if (indices.size() < 3) {
+            return;
+        }
+        m_kernel.setArgs(visibility.ids(), visibility.depth(),
+                         positions, indices, attributes, instances,
+                         static_cast<cl_uint>(indices.size() / 3),
+                         static_cast<cl_uint>(attributes.size()),
+                         cl_uint{target.width()}, cl_uint{target.height()},
+                         target.color());
+        m_kernel.dispatch(cl::NDRange(target.width(), target.height()));
+    }
+
+private:
+    static constexpr cl_uint FIXED_ARGS = 11;
+
+    ColorFormat m_format;
+    Program m_body;
+    Kernel m_kernel;
+
+    static std::string generateSource(ColorFormat format, Program& body) {
+        const std::string code = body.compile();
+        return detail::makeBodyPrelude(body)
+             + detail::makeVisibilityShadingSource(
+            detail::compileStructDefs<Attribute, Instance>(),
+            Attribute::opencl_name, Instance::opencl_name,
+            format, body.parameters(), code
+        );
+    }
+};
+
+} // namespace hwr
+
+#endif // HWR_VISIBILITY_SHADING_HPP
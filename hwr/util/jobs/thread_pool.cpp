@@ -0,0 +1,253 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace hwr {
+
+    namespace {
+        constexpr size_t NOT_A_WORKER = std::numeric_limits<size_t>::max();
+
+        // Set on worker threads so tasks they submit stay on their deque.
+        thread_local const ThreadPool* tl_pool = nullptr;
+        thread_local size_t tl_index = NOT_A_WORKER;
+
+        // Tasks of tl_runningPool on this thread's stack: more than one when
+        // a task waits and runs other tasks meanwhile. wait() does not count
+        // them, they cannot finish before it returns.
+        thread_local const ThreadPool* tl_runningPool = nullptr;
+        thread_local size_t tl_running = 0;
+
+        // Calls fn when the scope is left, by an exception too, so a task
+        // that throws is still counted as finished.
+        template<typename Fn>
+        class OnExit {
+        public:
+            explicit OnExit(Fn fn) : m_fn(std::move(fn)) {}
+            ~OnExit() { m_fn(); }
+
+            OnExit(const OnExit&) = delete;
+            OnExit& operator=(const OnExit&) = delete;
+
+        private:
+            Fn m_fn;
+        };
+    }
+
+    void JobCounter::add() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void JobCounter::release() {
+        std::vector<std::pair<ThreadPool*, std::function<void()>>> ready;
+        {
+            // Notified under the mutex: a waiter locks it before returning,
+            // so the counter is not destroyed while still in use here.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            ready.swap(m_continuations);
+            m_pending.notify_all();
+        }
+        for (auto& [pool, task] : ready) {
+            pool->submit(std::move(task));
+        }
+    }
+
+    ThreadPool::ThreadPool(size_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            m_threads.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stop = true;
+        }
+        m_sleep.notify_all();
+        for (std::thread& t : m_threads) {
+            t.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        const size_t index = tl_pool == this
+            ? tl_index
+            : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+        m_unfinished.fetch_add(1, std::memory_order_relaxed);
+        {
+            // Counted before the push so m_queued never drops below the
+            // number of tasks in the deques, and under the sleep mutex so
+            // a worker about to sleep sees it.
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_queued.fetch_add(1, std::memory_order_release);
+        }
+        {
+            Worker& worker = *m_workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+        m_sleep.notify_one();
+    }
+
+    void ThreadPool::submit(std::function<void()> task, JobCounter& counter) {
+        counter.add();
+        submit([task = std::move(task), &counter] {
+            OnExit released([&counter] { counter.release(); });
+            task();
+        });
+    }
+
+    void ThreadPool::submitAfter(JobCounter& dependency, std::function<void()> task,
+                                 JobCounter* counter)
+    {
+        if (counter) {
+            counter->add();
+            task = [task = std::move(task), counter] {
+                OnExit released([counter] { counter->release(); });
+                task();
+            };
+        }
+        {
+            std::lock_guard<std::mutex> lock(dependency.m_mutex);
+            if (dependency.m_pending.load(std::memory_order_acquire) > 0) {
+                dependency.m_continuations.emplace_back(this, std::move(task));
+                return;
+            }
+        }
+        submit(std::move(task));
+    }
+
+    void ThreadPool::wait() {
+        const size_t self = tl_pool == this ? tl_index : NOT_A_WORKER;
+        const size_t own = tl_runningPool == this ? tl_running : 0;
+        for (;;) {
+            const size_t unfinished = m_unfinished.load(std::memory_order_acquire);
+            if (unfinished <= own) {
+                return;
+            }
+            if (!runOne(self)) {
+                m_unfinished.wait(unfinished, std::memory_order_acquire);
+            }
+        }
+    }
+
+    void ThreadPool::wait(JobCounter& counter) {
+        const size_t self = tl_pool == this ? tl_index : NOT_A_WORKER;
+        for (;;) {
+            const size_t pending = counter.m_pending.load(std::memory_order_acquire);
+            if (pending == 0) {
+                break;
+            }
+            if (!runOne(self)) {
+                counter.m_pending.wait(pending, std::memory_order_acquire);
+            }
+        }
+        // The last release() may still hold the mutex.
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+    }
+
+    void ThreadPool::parallelFor(size_t count, size_t grain,
+                                 const std::function<void(size_t, size_t)>& fn)
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || m_workers.size() == 1) {
+            if (count > 0) {
+                fn(0, count);
+            }
+            return;
+        }
+
+        JobCounter remaining;
+        for (size_t begin = grain; begin < count; begin += grain) {
+            const size_t end = std::min(count, begin + grain);
+            submit([&fn, begin, end] { fn(begin, end); }, remaining);
+        }
+        fn(0, grain);
+        wait(remaining);
+    }
+
+    void ThreadPool::run(size_t index) {
+        tl_pool = this;
+        tl_index = index;
+        for (;;) {
+            if (runOne(index)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleep.wait(lock, [this] {
+                return m_stop || m_queued.load(std::memory_order_acquire) > 0;
+            });
+            if (m_stop && m_queued.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+
+    bool ThreadPool::runOne(size_t self) {
+        std::function<void()> task;
+        bool found = self != NOT_A_WORKER && pop(self, task);
+        const size_t n = m_workers.size();
+        const size_t start = self != NOT_A_WORKER ? self + 1 : 0;
+        for (size_t i = 0; !found && i < n; ++i) {
+            const size_t victim = (start + i) % n;
+            found = victim != self && steal(victim, task);
+        }
+        if (!found) {
+            return false;
+        }
+
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        const ThreadPool* outerPool = tl_runningPool;
+        const size_t outerRunning = tl_running;
+        tl_runningPool = this;
+        tl_running = outerPool == this ? outerRunning + 1 : 1;
+        OnExit finished([this, outerPool, outerRunning] {
+            tl_runningPool = outerPool;
+            tl_running = outerRunning;
+            // Not only on the last task: a wait() from inside a task returns
+            // while its own tasks are still unfinished.
+            m_unfinished.fetch_sub(1, std::memory_order_acq_rel);
+            m_unfinished.notify_all();
+        });
+        task();
+        return true;
+    }
+
+    bool ThreadPool::pop(size_t index, std::function<void()>& task) {
+        Worker& worker = *m_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool ThreadPool::steal(size_t victim, std::function<void()>& task) {
+        Worker& worker = *m_workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    ThreadPool& jobs() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+} // namespace hwr
@@ -0,0 +1,158 @@
+#ifndef HWR_THREAD_POOL_HPP
+#define HWR_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hwr {
+
+class ThreadPool;
+
+/**
+* \class JobCounter
+* \brief Number of unfinished jobs of a group, for waiting on the group or
+*        starting jobs once it is done.
+*
+* Jobs are added to a counter by passing it to ThreadPool::submit() or
+* submitAfter(). A counter has to outlive the jobs it counts, and the jobs
+* started after it.
+*/
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+
+    void add();
+    // Submits the continuations once the last job is released.
+    void release();
+
+    std::atomic<size_t> m_pending{0};
+    std::mutex m_mutex;
+    std::vector<std::pair<ThreadPool*, std::function<void()>>> m_continuations;
+};
+
+/**
+* \class ThreadPool
+* \brief Fixed set of workers, each with its own task deque.
+*
+* A worker pops its newest task first and, when out of work, steals the
+* oldest task of another worker, so tasks spawned from a task stay on the
+* core that spawned them. Threads waiting on the pool (parallelFor(),
+* wait()) run tasks instead of blocking. JobCounters group tasks so they
+* can be waited on, or followed by other tasks, without a full wait().
+*
+* A task that throws still counts as finished for wait() and its
+* JobCounter. The exception leaves through the wait() or parallelFor()
+* that ran the task, or terminates the program on a worker thread.
+*/
+class ThreadPool {
+public:
+    // 0 uses every hardware thread.
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t threadCount() const { return m_workers.size(); }
+
+    void submit(std::function<void()> task);
+    // Same, counted by counter until it has finished.
+    void submit(std::function<void()> task, JobCounter& counter);
+    // Submits task once every job of dependency has finished (right away
+    // if there are none). counter, if given, counts task from now on.
+    void submitAfter(JobCounter& dependency, std::function<void()> task,
+                     JobCounter* counter = nullptr);
+
+    // Runs until every submitted task has finished. Called from a task, the
+    // tasks this thread is running do not count. Two tasks calling it at
+    // once wait on each other forever; wait on a JobCounter instead.
+    void wait();
+    // Runs until every job of counter has finished.
+    void wait(JobCounter& counter);
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most grain
+    // elements and returns when all chunks are done.
+    void parallelFor(size_t count, size_t grain,
+                     const std::function<void(size_t begin, size_t end)>& fn);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(size_t index);
+    // Own deque first (back), then the others (front). False if none.
+    bool runOne(size_t self);
+    bool pop(size_t index, std::function<void()>& task);
+    bool steal(size_t victim, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextQueue{0};
+    std::atomic<size_t> m_queued{0};     // tasks in deques
+    std::atomic<size_t> m_unfinished{0}; // submitted, not yet finished
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleep;
+    bool m_stop = false;
+};
+
+// Pool shared by the pipeline's CPU stages, created on first use with
+// every hardware thread.
+ThreadPool& jobs();
+
+namespace detail {
+
+    template<typename Results, typename Fns, size_t... I>
+    void submitEach(ThreadPool& pool, JobCounter& done, Results& results, Fns& fns,
+                    std::index_sequence<I...>)
+    {
+        (pool.submit([&result = std::get<I>(results), &fn = std::get<I>(fns)] {
+            result.emplace(fn());
+        }, done), ...);
+    }
+
+} // namespace detail
+
+/// Calls every fn as a job of pool and returns their results, in order,
+/// once all have finished. Meant for building several pipelines at once:
+/// each generates its shader and builds its kernel on its own job.
+///
+///     auto [draw, shading] = hwr::parallelInvoke(hwr::jobs(),
+///         [&] { return std::make_unique<Draw>(ctx, drawBody); },
+///         [&] { return std::make_unique<Shading>(ctx, hwr::ColorFormat::RGBA8, shadingBody); });
+template<typename... Fns>
+std::tuple<std::invoke_result_t<Fns&>...> parallelInvoke(ThreadPool& pool, Fns&&... fns) {
+    static_assert((!std::is_void_v<std::invoke_result_t<Fns&>> && ...),
+                  "parallelInvoke - every function must return a value");
+    std::tuple<std::optional<std::invoke_result_t<Fns&>>...> results;
+    std::tuple<Fns&...> calls(fns...);
+    JobCounter done;
+    detail::submitEach(pool, done, results, calls, std::index_sequence_for<Fns...>{});
+    pool.wait(done);
+    return std::apply([](auto&... result) {
+        return std::tuple<std::invoke_result_t<Fns&>...>(std::move(*result)...);
+    }, results);
+}
+
+} // namespace hwr
+
+#endif // HWR_THREAD_POOL_HPP
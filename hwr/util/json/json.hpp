@@ -0,0 +1,34 @@
+#ifndef HWR_JSON_HPP
+#define HWR_JSON_HPP
+
+#include <cstdio>
+#include <string>
+
+namespace hwr {
+
+    // s as the contents of a JSON string literal, quotes not included.
+    inline std::string jsonEscape(const std::string& s) {
+        std::string res;
+        res.reserve(s.size());
+        for (char c : s) {
+            switch (c) {
+                case '"':  res += "\\\""; break;
+                case '\\': res += "\\\\"; break;
+                case '\n': res += "\\n"; break;
+                case '\t': res += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                        res += buf;
+                    } else {
+                        res += c;
+                    }
+            }
+        }
+        return res;
+    }
+
+} // namespace hwr
+
+#endif // HWR_JSON_HPP
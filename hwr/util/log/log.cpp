@@ -2,23 +2,32 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <cstdio>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 namespace hwr {
 
         namespace{
-            static std::ofstream g_logFile;
-            std::string currentTime() {
-                using std::chrono::system_clock;
-                auto now = system_clock::now();
+
+            using Clock = std::chrono::system_clock;
+
+            struct Record {
+                Clock::time_point time;
+                const char* level = "";
+                const char* color = "";
+                std::string msg;
+            };
+
+            std::string formatTime(Clock::time_point now) {
                 auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                             now.time_since_epoch()) % 1000;
-                std::time_t t = system_clock::to_time_t(now);
-        
+                std::time_t t = Clock::to_time_t(now);
+
                 std::tm tmBuf;
 
                 #ifdef _WIN32
@@ -27,12 +36,13 @@ namespace hwr {
                     localtime_r(&t, &tmBuf);
                 #endif
 
-                std::ostringstream oss;
-                oss << std::put_time(&tmBuf, "%T") << "." << std::setw(3)
-                    << std::setfill('0') << ms.count();
-                return oss.str();
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%03d",
+                              tmBuf.tm_hour, tmBuf.tm_min, tmBuf.tm_sec,
+                              static_cast<int>(ms.count()));
+                return buffer;
             }
-        
+
             std::string currentDateTime() {
                 std::time_t now = std::time(nullptr);
                 std::tm tmBuf;
@@ -47,35 +57,274 @@ namespace hwr {
                 strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tmBuf);
                 return std::string(buffer);
             }
-            void logMessage(const std::string &level,
-                const std::string &colorCode,
-                const std::string &msg)
-            {
-                std::string timeStr = currentTime();
-                std::string line = "[" + timeStr + "] [" + level + "] " + msg;
-
-                std::cout << colorCode << line << ANSI_COLOR_RESET << std::endl;
-
-                #if LOG_ENABLE_FILE
-                if (g_logFile.is_open()) {
-                    // Strip color codes in the file
-                    g_logFile << line << std::endl;
+
+            // Lock-free bounded multi-producer queue (Vyukov): each cell's
+            // sequence number tells producers and the single consumer
+            // whose turn it is.
+            class RecordRing {
+            public:
+                static constexpr size_t CAPACITY = 8192; // power of two
+
+                RecordRing() {
+                    for (size_t i = 0; i < CAPACITY; ++i) {
+                        m_cells[i].seq.store(i, std::memory_order_relaxed);
+                    }
                 }
-                #endif
+
+                bool push(Record&& rec) {
+                    size_t pos = m_enqueue.load(std::memory_order_relaxed);
+                    Cell* cell;
+                    for (;;) {
+                        cell = &m_cells[pos & (CAPACITY - 1)];
+                        const size_t seq = cell->seq.load(std::memory_order_acquire);
+                        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                        if (diff == 0) {
+                            if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                                break;
+                            }
+                        } else if (diff < 0) {
+                            return false; // full
+                        } else {
+                            pos = m_enqueue.load(std::memory_order_relaxed);
+                        }
+                    }
+                    cell->rec = std::move(rec);
+                    cell->seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+
+                // Single consumer only.
+                bool pop(Record& out) {
+                    Cell& cell = m_cells[m_dequeue & (CAPACITY - 1)];
+                    if (cell.seq.load(std::memory_order_acquire) != m_dequeue + 1) {
+                        return false;
+                    }
+                    out = std::move(cell.rec);
+                    cell.seq.store(m_dequeue + CAPACITY, std::memory_order_release);
+                    ++m_dequeue;
+                    return true;
+                }
+
+            private:
+                struct Cell {
+                    std::atomic<size_t> seq;
+                    Record rec;
+                };
+
+                std::unique_ptr<Cell[]> m_cells = std::make_unique<Cell[]>(CAPACITY);
+                alignas(64) std::atomic<size_t> m_enqueue{0};
+                alignas(64) size_t m_dequeue = 0;
+            };
+
+            /**
+            * Records are queued by the logging thread and formatted and
+            * written in batches by a background thread, one console write
+            * and one file write per batch. When the ring is full, records
+            * are dropped and the count is reported with the next batch.
+            */
+            class AsyncLogger {
+            public:
+                AsyncLogger() : m_writer([this] { run(); }) {}
+
+                ~AsyncLogger() {
+                    m_stop.store(true, std::memory_order_release);
+                    wake();
+                    m_writer.join();
+                }
+
+                void log(const char* level, const char* color, std::string msg) {
+                    Record rec{Clock::now(), level, color, std::move(msg)};
+                    if (!m_ring.push(std::move(rec))) {
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    m_pushed.fetch_add(1, std::memory_order_release);
+                    wake();
+                }
+
+                // For the record explaining a crash: waits for room in the
+                // ring instead of dropping it.
+                void logBlocking(const char* level, const char* color, std::string msg) {
+                    Record rec{Clock::now(), level, color, std::move(msg)};
+                    // push() only moves from rec once it succeeds.
+                    while (!m_ring.push(std::move(rec))) {
+                        if (m_stop.load(std::memory_order_acquire)) {
+                            // Writer gone, nothing drains the ring any more.
+                            std::string plain;
+                            std::string colored;
+                            appendLine(rec, plain, colored);
+                            write(plain, colored);
+                            return;
+                        }
+                        wake();
+                        std::this_thread::yield();
+                    }
+                    m_pushed.fetch_add(1, std::memory_order_release);
+                    wake();
+                }
+
+                void flush() {
+                    const uint64_t target = m_pushed.load(std::memory_order_acquire);
+                    uint64_t written = m_written.load(std::memory_order_acquire);
+                    while (written < target) {
+                        m_written.wait(written, std::memory_order_acquire);
+                        written = m_written.load(std::memory_order_acquire);
+                    }
+                }
+
+                void openFile(const char* path) {
+                    std::lock_guard<std::mutex> lock(m_fileMutex);
+                    m_file.open(path, std::ios::app);
+                    if (!m_file.is_open()) {
+                        std::cerr << "init() - Could not open log file: " << path << std::endl;
+                    }
+                }
+
+            private:
+                void wake() {
+                    m_signal.fetch_add(1, std::memory_order_release);
+                    m_signal.notify_one();
+                }
+
+                void run() {
+                    std::string plain;
+                    std::string colored;
+                    Record rec;
+                    for (;;) {
+                        const uint32_t seen = m_signal.load(std::memory_order_acquire);
+                        uint64_t count = 0;
+                        plain.clear();
+                        colored.clear();
+                        while (m_ring.pop(rec)) {
+                            appendLine(rec, plain, colored);
+                            ++count;
+                        }
+                        const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+                        if (dropped > 0) {
+                            Record note{Clock::now(), "ERROR", ANSI_COLOR_RED,
+                                        std::to_string(dropped) + " log records dropped, ring full"};
+                            appendLine(note, plain, colored);
+                        }
+                        if (!plain.empty()) {
+                            write(plain, colored);
+                        }
+                        if (count > 0) {
+                            m_written.fetch_add(count, std::memory_order_release);
+                            m_written.notify_all();
+                        }
+                        if (count == 0 && m_stop.load(std::memory_order_acquire)) {
+                            return;
+                        }
+                        if (count == 0) {
+                            m_signal.wait(seen, std::memory_order_acquire);
+                        }
+                    }
+                }
+
+                static void appendLine(const Record& rec, std::string& plain, [[maybe_unused]] std::string& colored) {
+                    std::string line = "[" + formatTime(rec.time) + "] [" + rec.level + "] " + rec.msg;
+                    #if LOG_ENABLE_CONSOLE
+                        colored += rec.color;
+                        colored += line;
+                        colored += ANSI_COLOR_RESET "\n";
+                    #endif
+                    plain += line;
+                    plain += '\n';
+                }
+
+                void write([[maybe_unused]] const std::string& plain,
+                           [[maybe_unused]] const std::string& colored) {
+                    #if LOG_ENABLE_CONSOLE
+                        std::fwrite(colored.data(), 1, colored.size(), stdout);
+                        std::fflush(stdout);
+                    #endif
+                    #if LOG_ENABLE_FILE
+                        std::lock_guard<std::mutex> lock(m_fileMutex);
+                        if (m_file.is_open()) {
+                            // Color codes only go to the console
+                            m_file.write(plain.data(), static_cast<std::streamsize>(plain.size()));
+                            m_file.flush();
+                        }
+                    #endif
+                }
+
+                RecordRing m_ring;
+                std::atomic<uint64_t> m_pushed{0};
+                std::atomic<uint64_t> m_written{0};
+                std::atomic<uint64_t> m_dropped{0};
+                std::atomic<uint32_t> m_signal{0};
+                std::atomic<bool> m_stop{false};
+                std::mutex m_fileMutex;
+                std::ofstream m_file;
+                std::thread m_writer; // last, starts once the rest exists
+            };
+
+            AsyncLogger& logger() {
+                static AsyncLogger instance;
+                return instance;
             }
 
+            void logMessage(const char* level, const char* colorCode, const std::string& msg) {
+                logger().log(level, colorCode, msg);
+            }
+
+            void logMessageBlocking(const char* level, const char* colorCode, const std::string& msg) {
+                logger().logBlocking(level, colorCode, msg);
+            }
+
+        }
+
+    namespace {
+        std::mutex g_levelMutex;
+        LogLevel g_level = LogLevel::DEBUG;
+        uint32_t g_disabledModules = 0;
+
+        // Caller holds g_levelMutex.
+        void refreshThresholds() {
+            for (size_t i = 0; i < static_cast<size_t>(LogModule::COUNT); ++i) {
+                const bool off = (g_disabledModules >> i) & 1u;
+                const LogLevel t = off ? LogLevel::OFF : g_level;
+                detail::g_logThreshold[i].store(static_cast<uint8_t>(t), std::memory_order_relaxed);
+            }
         }
+    }
+
+    void setLogLevel(LogLevel level) {
+        std::lock_guard<std::mutex> lock(g_levelMutex);
+        g_level = level;
+        refreshThresholds();
+    }
+
+    LogLevel logLevel() {
+        std::lock_guard<std::mutex> lock(g_levelMutex);
+        return g_level;
+    }
+
+    void setLogModuleEnabled(LogModule module, bool enabled) {
+        std::lock_guard<std::mutex> lock(g_levelMutex);
+        const uint32_t bit = 1u << static_cast<uint32_t>(module);
+        g_disabledModules = enabled ? (g_disabledModules & ~bit) : (g_disabledModules | bit);
+        refreshThresholds();
+    }
+
+    bool logModuleEnabled(LogModule module) {
+        std::lock_guard<std::mutex> lock(g_levelMutex);
+        return !((g_disabledModules >> static_cast<uint32_t>(module)) & 1u);
+    }
+
+    void logFlush() {
+        logger().flush();
+    }
 
     namespace detail{
 
+        // Zero-initialized, i.e. LogLevel::DEBUG for every module.
+        std::atomic<uint8_t> g_logThreshold[static_cast<size_t>(LogModule::COUNT)];
+
         void logInit() {
         #if LOG_ENABLE_FILE
             // Only open a file if file logging is on
-            g_logFile.open(LOG_FILE_PATH, std::ios::app);
-            if (!g_logFile.is_open()) {
-                std::cerr << "init() - Could not open log file: "
-                        << LOG_FILE_PATH << std::endl;
-            }
+            logger().openFile(LOG_FILE_PATH);
         #endif
             // Print a separator in both file and console so we can see new runs.
             std::string initMsg = "---------------------------------------- "
@@ -96,13 +345,15 @@ namespace hwr {
         }
 
         void Fatal(const std::string &msg) {
-            logMessage("FATAL", ANSI_COLOR_DARK_RED, msg);
+            logMessageBlocking("FATAL", ANSI_COLOR_DARK_RED, msg);
+            logFlush();
             throw new std::runtime_error("Runtime error.");
         }
 
         void Assert(bool cond, const std::string &msg){
             if(!cond){
-                logMessage("ASSERT FAILED", ANSI_COLOR_DARK_RED, msg);
+                logMessageBlocking("ASSERT FAILED", ANSI_COLOR_DARK_RED, msg);
+                logFlush();
                 assert(false && msg.c_str());
             }
         }
@@ -173,7 +424,8 @@ namespace hwr {
                 default:                                      errStr = "Unknown OpenCL error"; break;
             }
             const std::string& fullMessage = errStr + " (" + std::to_string(code) + ")\n\t\tSituation: "+situation;
-            logMessage("OpenCL Error",ANSI_COLOR_LIGHT_RED, fullMessage);
+            logMessageBlocking("OpenCL Error", ANSI_COLOR_LIGHT_RED, fullMessage);
+            logFlush();
             assert(false && fullMessage.c_str());
         }
 
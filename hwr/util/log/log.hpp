@@ -3,11 +3,64 @@
 #include "log_config_detail.hpp"
 #include "../../rendering_pipeline/gpu/gpu_cl_init.hpp"
 #include "CL/opencl.hpp"
+#include <atomic>
+#include <cstdint>
+#include <format>
 #include <string>
 #include <stdexcept>
 
 namespace hwr {
+
+    // Severity threshold, checked before a message is built.
+    enum class LogLevel : uint8_t {
+        DEBUG,
+        INFO,
+        SUCCESS,
+        ERR,
+        FATAL,
+        OFF,
+    };
+
+    // Subsystems that can be silenced independently of the level.
+    enum class LogModule : uint8_t {
+        CORE,
+        GPU,
+        SHADER,
+        SCENE,
+        COUNT,
+    };
+
+    void setLogLevel(LogLevel level);
+    LogLevel logLevel();
+
+    void setLogModuleEnabled(LogModule module, bool enabled);
+    bool logModuleEnabled(LogModule module);
+
+    // Blocks until every record logged so far has been written.
+    void logFlush();
+
     namespace detail {
+        // Effective threshold per module: the global level, or OFF when the
+        // module is disabled. Kept folded so a check is one load and compare.
+        extern std::atomic<uint8_t> g_logThreshold[static_cast<size_t>(LogModule::COUNT)];
+
+        inline bool logEnabled(LogLevel level, LogModule module = LogModule::CORE) {
+            if constexpr (!(LOG_ENABLE_CONSOLE || LOG_ENABLE_FILE)) {
+                return false;
+            }
+            return static_cast<uint8_t>(level) >=
+                   g_logThreshold[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+        }
+
+        // A single argument is logged as is, more are std::format'ed.
+        inline const std::string& formatLog(const std::string& msg) { return msg; }
+        inline std::string formatLog(const char* msg) { return msg; }
+
+        template <class Arg, class... Args>
+        std::string formatLog(std::format_string<Arg, Args...> fmt, Arg&& arg, Args&&... args) {
+            return std::format(fmt, std::forward<Arg>(arg), std::forward<Args>(args)...);
+        }
+
         void logInit();
         void Debug(const std::string &msg);
         void Error(const std::string &msg);
@@ -21,19 +74,32 @@ namespace hwr {
 
 
 #if HWR_LOG_ENABLE
+    // Arguments are only evaluated, and the message only formatted, when the
+    // level passes the module's threshold:
+    //   HWR_DEBUG("plain " + text);
+    //   HWR_DEBUG_IN(hwr::LogModule::SHADER, "{} temporaries", count);
+    #define HWR_LOG_AT(level, module, fn, ...) \
+        do { if (hwr::detail::logEnabled(level, module)) fn(hwr::detail::formatLog(__VA_ARGS__)); } while(0)
+
     #define HWR_LOG_INIT() hwr::detail::logInit()
-    #define HWR_INFO(msg)  hwr::detail::Info(msg)
-    #define HWR_DEBUG(msg) hwr::detail::Debug(msg)
-    #define HWR_ERR(msg)   hwr::detail::Error(msg)
-    #define HWR_FATAL(msg) hwr::detail::Fatal(msg)
-    #define HWR_SUCCESS(msg) hwr::detail::Success(msg)
+    #define HWR_INFO_IN(module, ...)  HWR_LOG_AT(hwr::LogLevel::INFO, module, hwr::detail::Info, __VA_ARGS__)
+    #define HWR_DEBUG_IN(module, ...) HWR_LOG_AT(hwr::LogLevel::DEBUG, module, hwr::detail::Debug, __VA_ARGS__)
+    #define HWR_ERR_IN(module, ...)   HWR_LOG_AT(hwr::LogLevel::ERR, module, hwr::detail::Error, __VA_ARGS__)
+    #define HWR_INFO(...)  HWR_INFO_IN(hwr::LogModule::CORE, __VA_ARGS__)
+    #define HWR_DEBUG(...) HWR_DEBUG_IN(hwr::LogModule::CORE, __VA_ARGS__)
+    #define HWR_ERR(...)   HWR_ERR_IN(hwr::LogModule::CORE, __VA_ARGS__)
+    #define HWR_FATAL(...) hwr::detail::Fatal(hwr::detail::formatLog(__VA_ARGS__))
+    #define HWR_SUCCESS(...) HWR_LOG_AT(hwr::LogLevel::SUCCESS, hwr::LogModule::CORE, hwr::detail::Success, __VA_ARGS__)
 #else
     #define HWR_LOG_INIT()  do {} while(0)
-    #define HWR_INFO(msg)   do {} while(0)
-    #define HWR_DEBUG(msg)  do {} while(0)
-    #define HWR_ERR(msg)    do {} while(0)
-    #define HWR_FATAL(msg) throw std::runtime_error(msg)
-    #define HWR_SUCCESS(msg)  do {} while(0)
+    #define HWR_INFO_IN(module, ...)  do {} while(0)
+    #define HWR_DEBUG_IN(module, ...) do {} while(0)
+    #define HWR_ERR_IN(module, ...)   do {} while(0)
+    #define HWR_INFO(...)   do {} while(0)
+    #define HWR_DEBUG(...)  do {} while(0)
+    #define HWR_ERR(...)    do {} while(0)
+    #define HWR_FATAL(...) throw std::runtime_error(hwr::detail::formatLog(__VA_ARGS__))
+    #define HWR_SUCCESS(...)  do {} while(0)
 #endif
 
 #ifndef NDEBUG
@@ -41,7 +107,7 @@ namespace hwr {
     #define HWR_ASSERT_CL_OK(code, when)     hwr::detail::Assert_CL_OK(code, when)
 #else
     #define HWR_ASSERT(cond, msg)    do {} while(0)
-    #define HWR_ASSERT_CL_OK(code, msg)  do {} while(0)
+    #define HWR_ASSERT_CL_OK(code, msg)  do { (void)(code); } while(0)
 #endif
 
 #endif // HWR_LOG_HPP
@@ -2,68 +2,91 @@
 
 namespace hwr {
 
-    vec4f vec_add(const vec4f& a, const vec4f& b) {
-        return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
-    }
-
-    vec4f vec_sub(const vec4f& a, const vec4f& b) {
-        return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
-    }
-
-    vec4f vec_scale(const vec4f& v, float scalar) {
-        return { v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar };
-    }
+    namespace {
+        using Wide = detail::simd::Wide;
+        using detail::simd::add;
+        using detail::simd::mul;
+        using detail::simd::fmadd;
 
-    float vec_dot(const vec4f& a, const vec4f& b) {
-        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
-    }
-
-    float vec_length(const vec4f& v) {
-        return std::sqrt(vec_dot(v, v));
-    }
-
-    vec4f vec_normalize(const vec4f& v) {
-        float len = vec_length(v);
-        if (len == 0.0f) return {0, 0, 0, 0};
-        return vec_scale(v, 1.0f / len);
+        // dot(row, (x, y, z, w)) for WIDTH vectors at once.
+        inline Wide::type rowDot(const float* row, Wide::type x, Wide::type y,
+                                 Wide::type z, Wide::type w) {
+            Wide::type r = mul(Wide::splat(row[0]), x);
+            r = fmadd(Wide::splat(row[1]), y, r);
+            r = fmadd(Wide::splat(row[2]), z, r);
+            return fmadd(Wide::splat(row[3]), w, r);
+        }
     }
 
-
-
-    mat4f mat_identity() {
-        mat4f m = {};
-        for (int i = 0; i < 4; ++i)
-            m.m[i][i] = 1.0f;
-        return m;
+    void mat_mul_vec_soa(const mat4f& m, const_vec4f_soa in, vec4f_soa out, size_t count) {
+        size_t i = 0;
+        for (; i + Wide::WIDTH <= count; i += Wide::WIDTH) {
+            const Wide::type x = Wide::load(in.x + i);
+            const Wide::type y = Wide::load(in.y + i);
+            const Wide::type z = Wide::load(in.z + i);
+            const Wide::type w = Wide::load(in.w + i);
+            // All loads happen before the stores, so in == out is fine.
+            const Wide::type rx = rowDot(m.m[0], x, y, z, w);
+            const Wide::type ry = rowDot(m.m[1], x, y, z, w);
+            const Wide::type rz = rowDot(m.m[2], x, y, z, w);
+            const Wide::type rw = rowDot(m.m[3], x, y, z, w);
+            Wide::store(out.x + i, rx);
+            Wide::store(out.y + i, ry);
+            Wide::store(out.z + i, rz);
+            Wide::store(out.w + i, rw);
+        }
+        for (; i < count; ++i) {
+            const vec4f r = mat_mul_vec(m, {in.x[i], in.y[i], in.z[i], in.w[i]});
+            out.x[i] = r.x;
+            out.y[i] = r.y;
+            out.z[i] = r.z;
+            out.w[i] = r.w;
+        }
     }
 
-    mat4f mat_transpose(const mat4f& in) {
-        mat4f out = {};
-        for (int i = 0; i < 4; ++i)
-            for (int j = 0; j < 4; ++j)
-                out.m[i][j] = in.m[j][i];
-        return out;
+    void vec_dot_soa(const vec4f& a, const_vec4f_soa v, float* out, size_t count) {
+        const float row[4] = { a.x, a.y, a.z, a.w };
+        size_t i = 0;
+        for (; i + Wide::WIDTH <= count; i += Wide::WIDTH) {
+            Wide::store(out + i, rowDot(row, Wide::load(v.x + i), Wide::load(v.y + i),
+                                        Wide::load(v.z + i), Wide::load(v.w + i)));
+        }
+        for (; i < count; ++i) {
+            out[i] = a.x * v.x[i] + a.y * v.y[i] + a.z * v.z[i] + a.w * v.w[i];
+        }
     }
 
-    mat4f mat_mul(const mat4f& a, const mat4f& b) {
-        mat4f result = {};
-        for (int row = 0; row < 4; ++row) {
-            for (int col = 0; col < 4; ++col) {
-                for (int k = 0; k < 4; ++k) {
-                    result.m[row][col] += a.m[row][k] * b.m[k][col];
-                }
-            }
+    void vec_add_soa(const_vec4f_soa a, const_vec4f_soa b, vec4f_soa out, size_t count) {
+        size_t i = 0;
+        for (; i + Wide::WIDTH <= count; i += Wide::WIDTH) {
+            Wide::store(out.x + i, add(Wide::load(a.x + i), Wide::load(b.x + i)));
+            Wide::store(out.y + i, add(Wide::load(a.y + i), Wide::load(b.y + i)));
+            Wide::store(out.z + i, add(Wide::load(a.z + i), Wide::load(b.z + i)));
+            Wide::store(out.w + i, add(Wide::load(a.w + i), Wide::load(b.w + i)));
+        }
+        for (; i < count; ++i) {
+            out.x[i] = a.x[i] + b.x[i];
+            out.y[i] = a.y[i] + b.y[i];
+            out.z[i] = a.z[i] + b.z[i];
+            out.w[i] = a.w[i] + b.w[i];
         }
-        return result;
     }
 
-    vec4f mat_mul_vec(const mat4f& m, const vec4f& v) {
-        return {
-            m.m[0][0]*v.x + m.m[0][1]*v.y + m.m[0][2]*v.z + m.m[0][3]*v.w,
-            m.m[1][0]*v.x + m.m[1][1]*v.y + m.m[1][2]*v.z + m.m[1][3]*v.w,
-            m.m[2][0]*v.x + m.m[2][1]*v.y + m.m[2][2]*v.z + m.m[2][3]*v.w,
-            m.m[3][0]*v.x + m.m[3][1]*v.y + m.m[3][2]*v.z + m.m[3][3]*v.w
-        };
+    void mat_mul_vec_batch(const mat4f& m, std::span<const vec4f> in, std::span<vec4f> out) {
+        assert(out.size() >= in.size());
+        // Columns of m, so each result is a weighted sum of four registers.
+        namespace simd = detail::simd;
+        simd::f32x4 c0 = simd::load4(m.m[0]), c1 = simd::load4(m.m[1]);
+        simd::f32x4 c2 = simd::load4(m.m[2]), c3 = simd::load4(m.m[3]);
+        simd::transpose(c0, c1, c2, c3);
+        for (size_t i = 0; i < in.size(); ++i) {
+            const vec4f& v = in[i];
+            simd::f32x4 r = simd::mul(simd::splat4(v.x), c0);
+            r = simd::fmadd(simd::splat4(v.y), c1, r);
+            r = simd::fmadd(simd::splat4(v.z), c2, r);
+            r = simd::fmadd(simd::splat4(v.w), c3, r);
+            out[i] = detail::store(r);
+        }
     }
 
     std::string to_string(const vec4f& v) {
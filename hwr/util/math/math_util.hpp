@@ -6,7 +6,9 @@
 #include <type_traits>
 #include <cassert>
 #include <cmath> 
+#include <span>
 #include <string>
+#include "simd.hpp"
 
 namespace hwr {
 
@@ -58,19 +60,157 @@ namespace hwr {
     static_assert(sizeof(mat4f) == 64, "mat4f must be exactly 64 bytes");
 
 
-    vec4f vec_add(const vec4f& a, const vec4f& b);
-    vec4f vec_sub(const vec4f& a, const vec4f& b);
-    vec4f vec_scale(const vec4f& v, float scalar);
-    float vec_dot(const vec4f& a, const vec4f& b);
-    float vec_length(const vec4f& v);
-    vec4f vec_normalize(const vec4f& v);
+    namespace detail {
+        // vec4f and mat4f rows are 4 contiguous floats.
+        inline simd::f32x4 load(const vec4f& v) { return simd::load4(reinterpret_cast<const float*>(&v)); }
+        inline vec4f store(simd::f32x4 s) {
+            vec4f v;
+            simd::store4(reinterpret_cast<float*>(&v), s);
+            return v;
+        }
+    }
+
+    // Header-inline so callers in any translation unit inline and
+    // vectorize them. Constant evaluation takes the scalar path.
+    constexpr vec4f vec_add(const vec4f& a, const vec4f& b) {
+        if consteval {
+            return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+        } else {
+            return detail::store(detail::simd::add(detail::load(a), detail::load(b)));
+        }
+    }
+
+    constexpr vec4f vec_sub(const vec4f& a, const vec4f& b) {
+        if consteval {
+            return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
+        } else {
+            return detail::store(detail::simd::sub(detail::load(a), detail::load(b)));
+        }
+    }
+
+    constexpr vec4f vec_scale(const vec4f& v, float scalar) {
+        if consteval {
+            return { v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar };
+        } else {
+            return detail::store(detail::simd::mul(detail::load(v), detail::simd::splat4(scalar)));
+        }
+    }
+
+    constexpr float vec_dot(const vec4f& a, const vec4f& b) {
+        if consteval {
+            return (a.x * b.x + a.y * b.y) + (a.z * b.z + a.w * b.w);
+        } else {
+            return detail::simd::hsum(detail::simd::mul(detail::load(a), detail::load(b)));
+        }
+    }
+
+    inline float vec_length(const vec4f& v) {
+        return std::sqrt(vec_dot(v, v));
+    }
+
+    inline vec4f vec_normalize(const vec4f& v) {
+        float len = vec_length(v);
+        if (len == 0.0f) return {0, 0, 0, 0};
+        return vec_scale(v, 1.0f / len);
+    }
+
+
+    constexpr mat4f mat_identity() {
+        mat4f m = {};
+        for (int i = 0; i < 4; ++i)
+            m.m[i][i] = 1.0f;
+        return m;
+    }
+
+    constexpr mat4f mat_transpose(const mat4f& in) {
+        mat4f out = {};
+        if consteval {
+            for (int i = 0; i < 4; ++i)
+                for (int j = 0; j < 4; ++j)
+                    out.m[i][j] = in.m[j][i];
+        } else {
+            namespace simd = detail::simd;
+            simd::f32x4 r0 = simd::load4(in.m[0]), r1 = simd::load4(in.m[1]);
+            simd::f32x4 r2 = simd::load4(in.m[2]), r3 = simd::load4(in.m[3]);
+            simd::transpose(r0, r1, r2, r3);
+            simd::store4(out.m[0], r0); simd::store4(out.m[1], r1);
+            simd::store4(out.m[2], r2); simd::store4(out.m[3], r3);
+        }
+        return out;
+    }
+
+    // Row i of the result is a's row i weighting b's rows.
+    constexpr mat4f mat_mul(const mat4f& a, const mat4f& b) {
+        mat4f result = {};
+        if consteval {
+            for (int row = 0; row < 4; ++row)
+                for (int col = 0; col < 4; ++col)
+                    for (int k = 0; k < 4; ++k)
+                        result.m[row][col] += a.m[row][k] * b.m[k][col];
+        } else {
+            namespace simd = detail::simd;
+            const simd::f32x4 b0 = simd::load4(b.m[0]), b1 = simd::load4(b.m[1]);
+            const simd::f32x4 b2 = simd::load4(b.m[2]), b3 = simd::load4(b.m[3]);
+            for (int row = 0; row < 4; ++row) {
+                simd::f32x4 r = simd::mul(simd::splat4(a.m[row][0]), b0);
+                r = simd::fmadd(simd::splat4(a.m[row][1]), b1, r);
+                r = simd::fmadd(simd::splat4(a.m[row][2]), b2, r);
+                r = simd::fmadd(simd::splat4(a.m[row][3]), b3, r);
+                simd::store4(result.m[row], r);
+            }
+        }
+        return result;
+    }
+
+    constexpr vec4f mat_mul_vec(const mat4f& m, const vec4f& v) {
+        if consteval {
+            return {
+                m.m[0][0]*v.x + m.m[0][1]*v.y + m.m[0][2]*v.z + m.m[0][3]*v.w,
+                m.m[1][0]*v.x + m.m[1][1]*v.y + m.m[1][2]*v.z + m.m[1][3]*v.w,
+                m.m[2][0]*v.x + m.m[2][1]*v.y + m.m[2][2]*v.z + m.m[2][3]*v.w,
+                m.m[3][0]*v.x + m.m[3][1]*v.y + m.m[3][2]*v.z + m.m[3][3]*v.w
+            };
+        } else {
+            namespace simd = detail::simd;
+            const simd::f32x4 vv = detail::load(v);
+            simd::f32x4 r0 = simd::mul(simd::load4(m.m[0]), vv), r1 = simd::mul(simd::load4(m.m[1]), vv);
+            simd::f32x4 r2 = simd::mul(simd::load4(m.m[2]), vv), r3 = simd::mul(simd::load4(m.m[3]), vv);
+            // Summing the columns of the transposed products gives all four dots at once.
+            simd::transpose(r0, r1, r2, r3);
+            return detail::store(simd::add(simd::add(r0, r1), simd::add(r2, r3)));
+        }
+    }
+
+
+    // Arrays of vectors split into one array per component, so a register
+    // holds the same component of 4 (SSE/NEON) or 8 (AVX2) vectors.
+    struct vec4f_soa {
+        float* x;
+        float* y;
+        float* z;
+        float* w;
+    };
 
+    struct const_vec4f_soa {
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* w;
+
+        const_vec4f_soa(const float* x_, const float* y_, const float* z_, const float* w_)
+            : x(x_), y(y_), z(z_), w(w_) {}
+        const_vec4f_soa(const vec4f_soa& v) : x(v.x), y(v.y), z(v.z), w(v.w) {}
+    };
 
-    mat4f mat_identity();
-    mat4f mat_transpose(const mat4f& m);
-    mat4f mat_mul(const mat4f& a, const mat4f& b);
-    vec4f mat_mul_vec(const mat4f& m, const vec4f& v);
+    // out[i] = m * in[i]; in and out may be the same arrays.
+    void mat_mul_vec_soa(const mat4f& m, const_vec4f_soa in, vec4f_soa out, size_t count);
+    // out[i] = dot(a, v[i]), e.g. plane distances for culling.
+    void vec_dot_soa(const vec4f& a, const_vec4f_soa v, float* out, size_t count);
+    // out[i] = a[i] + b[i]
+    void vec_add_soa(const_vec4f_soa a, const_vec4f_soa b, vec4f_soa out, size_t count);
 
+    // out[i] = m * in[i] over an array of vec4f.
+    void mat_mul_vec_batch(const mat4f& m, std::span<const vec4f> in, std::span<vec4f> out);
 
 
     std::string to_string(const vec4f& v);
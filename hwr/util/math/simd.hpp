@@ -0,0 +1,142 @@
+#ifndef HWR_SIMD_HPP
+#define HWR_SIMD_HPP
+
+#include <cstddef>
+
+// Picks the widest instruction set the compiler targets. Configure with
+// HWR_NATIVE_ARCH=ON (or -mavx2 -mfma) to get the 8-wide paths; define
+// HWR_SIMD_SCALAR to force the portable fallback.
+#if !defined(HWR_SIMD_SCALAR)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define HWR_SIMD_SSE 1
+        #include <immintrin.h>
+        #if defined(__AVX2__)
+            #define HWR_SIMD_AVX2 1
+        #endif
+    #elif defined(__ARM_NEON) && defined(__aarch64__)
+        #define HWR_SIMD_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
+
+namespace hwr::detail::simd {
+
+    // 4 floats in one register.
+    #if HWR_SIMD_SSE
+        struct f32x4 { __m128 v; };
+
+        inline f32x4 load4(const float* p) { return { _mm_loadu_ps(p) }; }
+        inline void store4(float* p, f32x4 a) { _mm_storeu_ps(p, a.v); }
+        inline f32x4 splat4(float s) { return { _mm_set1_ps(s) }; }
+        inline f32x4 add(f32x4 a, f32x4 b) { return { _mm_add_ps(a.v, b.v) }; }
+        inline f32x4 sub(f32x4 a, f32x4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+        inline f32x4 mul(f32x4 a, f32x4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+        inline f32x4 min(f32x4 a, f32x4 b) { return { _mm_min_ps(a.v, b.v) }; }
+        inline f32x4 max(f32x4 a, f32x4 b) { return { _mm_max_ps(a.v, b.v) }; }
+        // a * b + c
+        inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) {
+            #if defined(__FMA__)
+                return { _mm_fmadd_ps(a.v, b.v, c.v) };
+            #else
+                return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) };
+            #endif
+        }
+        inline float hsum(f32x4 a) {
+            __m128 shuf = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 3, 0, 1));
+            __m128 sums = _mm_add_ps(a.v, shuf);
+            shuf = _mm_movehl_ps(shuf, sums);
+            sums = _mm_add_ss(sums, shuf);
+            return _mm_cvtss_f32(sums);
+        }
+        inline void transpose(f32x4& r0, f32x4& r1, f32x4& r2, f32x4& r3) {
+            _MM_TRANSPOSE4_PS(r0.v, r1.v, r2.v, r3.v);
+        }
+    #elif HWR_SIMD_NEON
+        struct f32x4 { float32x4_t v; };
+
+        inline f32x4 load4(const float* p) { return { vld1q_f32(p) }; }
+        inline void store4(float* p, f32x4 a) { vst1q_f32(p, a.v); }
+        inline f32x4 splat4(float s) { return { vdupq_n_f32(s) }; }
+        inline f32x4 add(f32x4 a, f32x4 b) { return { vaddq_f32(a.v, b.v) }; }
+        inline f32x4 sub(f32x4 a, f32x4 b) { return { vsubq_f32(a.v, b.v) }; }
+        inline f32x4 mul(f32x4 a, f32x4 b) { return { vmulq_f32(a.v, b.v) }; }
+        inline f32x4 min(f32x4 a, f32x4 b) { return { vminq_f32(a.v, b.v) }; }
+        inline f32x4 max(f32x4 a, f32x4 b) { return { vmaxq_f32(a.v, b.v) }; }
+        inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) { return { vfmaq_f32(c.v, a.v, b.v) }; }
+        inline float hsum(f32x4 a) { return vaddvq_f32(a.v); }
+        inline void transpose(f32x4& r0, f32x4& r1, f32x4& r2, f32x4& r3) {
+            const float32x4x2_t t01 = vtrnq_f32(r0.v, r1.v);
+            const float32x4x2_t t23 = vtrnq_f32(r2.v, r3.v);
+            r0.v = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+            r1.v = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+            r2.v = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+            r3.v = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+        }
+    #else
+        struct f32x4 { float v[4]; };
+
+        inline f32x4 load4(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+        inline void store4(float* p, f32x4 a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+        inline f32x4 splat4(float s) { return { { s, s, s, s } }; }
+        inline f32x4 add(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+        inline f32x4 sub(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+        inline f32x4 mul(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+        inline f32x4 min(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] = b.v[i] < a.v[i] ? b.v[i] : a.v[i]; return a; }
+        inline f32x4 max(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] = b.v[i] > a.v[i] ? b.v[i] : a.v[i]; return a; }
+        inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) { return add(mul(a, b), c); }
+        inline float hsum(f32x4 a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+        inline void transpose(f32x4& r0, f32x4& r1, f32x4& r2, f32x4& r3) {
+            f32x4* rows[4] = { &r0, &r1, &r2, &r3 };
+            for (int i = 0; i < 4; ++i) {
+                for (int j = i + 1; j < 4; ++j) {
+                    const float t = rows[i]->v[j];
+                    rows[i]->v[j] = rows[j]->v[i];
+                    rows[j]->v[i] = t;
+                }
+            }
+        }
+    #endif
+
+    // 8 floats in one register; only with AVX2.
+    #if HWR_SIMD_AVX2
+        struct f32x8 { __m256 v; };
+
+        inline f32x8 load8(const float* p) { return { _mm256_loadu_ps(p) }; }
+        inline void store8(float* p, f32x8 a) { _mm256_storeu_ps(p, a.v); }
+        inline f32x8 splat8(float s) { return { _mm256_set1_ps(s) }; }
+        inline f32x8 add(f32x8 a, f32x8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+        inline f32x8 sub(f32x8 a, f32x8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+        inline f32x8 mul(f32x8 a, f32x8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+        inline f32x8 min(f32x8 a, f32x8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+        inline f32x8 max(f32x8 a, f32x8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+        inline f32x8 fmadd(f32x8 a, f32x8 b, f32x8 c) {
+            #if defined(__FMA__)
+                return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+            #else
+                return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) };
+            #endif
+        }
+    #endif
+
+    // The widest lane type, used by the batch functions.
+    #if HWR_SIMD_AVX2
+        struct Wide {
+            using type = f32x8;
+            static constexpr size_t WIDTH = 8;
+            static type load(const float* p) { return load8(p); }
+            static void store(float* p, type a) { store8(p, a); }
+            static type splat(float s) { return splat8(s); }
+        };
+    #else
+        struct Wide {
+            using type = f32x4;
+            static constexpr size_t WIDTH = 4;
+            static type load(const float* p) { return load4(p); }
+            static void store(float* p, type a) { store4(p, a); }
+            static type splat(float s) { return splat4(s); }
+        };
+    #endif
+
+} // namespace hwr::detail::simd
+
+#endif // HWR_SIMD_HPP
@@ -0,0 +1,350 @@
+#ifndef HWR_TRANSFORM_HPP
+#define HWR_TRANSFORM_HPP
+
+#include "math_util.hpp"
+#include <cmath>
+
+// Conventions match mat4f: row-major storage, column vectors (m * v),
+// right-handed view space looking down -z, clip space z in [-w, w].
+
+namespace hwr {
+
+    // Rotation quaternion, w is the scalar part.
+    struct quatf {
+        float x, y, z, w;
+    };
+
+    static_assert(sizeof(quatf) == 16, "quatf must be exactly 16 bytes");
+
+    // Affine transform [R | t] with an implied last row (0, 0, 0, 1).
+    // 48 bytes instead of mat4f's 64, and 36 instead of 64 multiplies to
+    // compose two of them.
+    struct affine3x4f {
+        float m[3][4]; // row-major
+    };
+
+    static_assert(sizeof(affine3x4f) == 48, "affine3x4f must be exactly 48 bytes");
+
+    namespace detail {
+        constexpr float sqrt(float x) {
+            if consteval {
+                if (x <= 0.0f) return 0.0f;
+                float r = x > 1.0f ? x : 1.0f;
+                for (int i = 0; i < 32; ++i) {
+                    r = 0.5f * (r + x / r);
+                }
+                return r;
+            } else {
+                return std::sqrt(x);
+            }
+        }
+    }
+
+
+    constexpr quatf quat_identity() {
+        return { 0.0f, 0.0f, 0.0f, 1.0f };
+    }
+
+    // Rotation by b, then by a.
+    constexpr quatf quat_mul(const quatf& a, const quatf& b) {
+        return {
+            a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+        };
+    }
+
+    // Inverse rotation of a unit quaternion.
+    constexpr quatf quat_conjugate(const quatf& q) {
+        return { -q.x, -q.y, -q.z, q.w };
+    }
+
+    constexpr quatf quat_normalize(const quatf& q) {
+        const float len = detail::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        if (len == 0.0f) return quat_identity();
+        const float inv = 1.0f / len;
+        return { q.x * inv, q.y * inv, q.z * inv, q.w * inv };
+    }
+
+    // axis.xyz must be normalized.
+    inline quatf quat_from_axis_angle(const vec4f& axis, float radians) {
+        const float s = std::sin(0.5f * radians);
+        return { axis.x * s, axis.y * s, axis.z * s, std::cos(0.5f * radians) };
+    }
+
+    // Rotates v.xyz, keeps v.w.
+    constexpr vec4f quat_rotate(const quatf& q, const vec4f& v) {
+        // v + 2w (q x v) + 2 q x (q x v)
+        const float tx = 2.0f * (q.y * v.z - q.z * v.y);
+        const float ty = 2.0f * (q.z * v.x - q.x * v.z);
+        const float tz = 2.0f * (q.x * v.y - q.y * v.x);
+        return {
+            v.x + q.w * tx + (q.y * tz - q.z * ty),
+            v.y + q.w * ty + (q.z * tx - q.x * tz),
+            v.z + q.w * tz + (q.x * ty - q.y * tx),
+            v.w
+        };
+    }
+
+    // Normalized lerp along the shorter arc; close to slerp for small angles.
+    constexpr quatf quat_nlerp(const quatf& a, const quatf& b, float t) {
+        const float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+        const float sb = dot < 0.0f ? -t : t;
+        const float sa = 1.0f - t;
+        return quat_normalize({ sa * a.x + sb * b.x, sa * a.y + sb * b.y,
+                                sa * a.z + sb * b.z, sa * a.w + sb * b.w });
+    }
+
+    inline quatf quat_slerp(const quatf& a, const quatf& b, float t) {
+        float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+        const float sign = dot < 0.0f ? -1.0f : 1.0f;
+        dot *= sign;
+        if (dot > 0.9995f) {
+            return quat_nlerp(a, b, t);
+        }
+        const float theta = std::acos(dot);
+        const float sa = std::sin((1.0f - t) * theta) / std::sin(theta);
+        const float sb = sign * std::sin(t * theta) / std::sin(theta);
+        return { sa * a.x + sb * b.x, sa * a.y + sb * b.y,
+                 sa * a.z + sb * b.z, sa * a.w + sb * b.w };
+    }
+
+
+    constexpr affine3x4f affine_identity() {
+        return { { { 1.0f, 0.0f, 0.0f, 0.0f },
+                   { 0.0f, 1.0f, 0.0f, 0.0f },
+                   { 0.0f, 0.0f, 1.0f, 0.0f } } };
+    }
+
+    // Scale, then rotate, then translate. Only xyz of t and s are used.
+    constexpr affine3x4f affine_from_trs(const vec4f& t, const quatf& r, const vec4f& s) {
+        const float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+        const float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+        const float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+        return { {
+            { (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy - wz) * s.y, 2.0f * (xz + wy) * s.z, t.x },
+            { 2.0f * (xy + wz) * s.x, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz - wx) * s.z, t.y },
+            { 2.0f * (xz - wy) * s.x, 2.0f * (yz + wx) * s.y, (1.0f - 2.0f * (xx + yy)) * s.z, t.z }
+        } };
+    }
+
+    constexpr mat4f quat_to_mat4(const quatf& q) {
+        const affine3x4f a = affine_from_trs({ 0.0f, 0.0f, 0.0f, 0.0f }, q, { 1.0f, 1.0f, 1.0f, 1.0f });
+        mat4f m = mat_identity();
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                m.m[i][j] = a.m[i][j];
+        return m;
+    }
+
+    // Drops the last row, which must be (0, 0, 0, 1) for the result to match.
+    constexpr affine3x4f affine_from_mat4(const mat4f& m) {
+        affine3x4f a = {};
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 4; ++j)
+                a.m[i][j] = m.m[i][j];
+        return a;
+    }
+
+    constexpr mat4f affine_to_mat4(const affine3x4f& a) {
+        mat4f m = mat_identity();
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 4; ++j)
+                m.m[i][j] = a.m[i][j];
+        return m;
+    }
+
+    // a after b: [Ra Rb | Ra tb + ta].
+    constexpr affine3x4f affine_mul(const affine3x4f& a, const affine3x4f& b) {
+        affine3x4f r = {};
+        if consteval {
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 4; ++col) {
+                    for (int k = 0; k < 3; ++k) {
+                        r.m[row][col] += a.m[row][k] * b.m[k][col];
+                    }
+                }
+                r.m[row][3] += a.m[row][3];
+            }
+        } else {
+            namespace simd = detail::simd;
+            const simd::f32x4 b0 = simd::load4(b.m[0]), b1 = simd::load4(b.m[1]);
+            const simd::f32x4 b2 = simd::load4(b.m[2]);
+            for (int row = 0; row < 3; ++row) {
+                const float t[4] = { 0.0f, 0.0f, 0.0f, a.m[row][3] };
+                simd::f32x4 v = simd::fmadd(simd::splat4(a.m[row][0]), b0, simd::load4(t));
+                v = simd::fmadd(simd::splat4(a.m[row][1]), b1, v);
+                v = simd::fmadd(simd::splat4(a.m[row][2]), b2, v);
+                simd::store4(r.m[row], v);
+            }
+        }
+        return r;
+    }
+
+    // Points (w = 1) get the translation, directions (w = 0) do not.
+    constexpr vec4f affine_transform(const affine3x4f& a, const vec4f& v) {
+        const auto row = [&](int i) {
+            return a.m[i][0] * v.x + a.m[i][1] * v.y + a.m[i][2] * v.z + a.m[i][3] * v.w;
+        };
+        return { row(0), row(1), row(2), v.w };
+    }
+
+    constexpr float affine_determinant(const affine3x4f& a) {
+        const auto& m = a.m;
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    // Zero matrix if a is singular.
+    constexpr affine3x4f affine_inverse(const affine3x4f& a) {
+        const float det = affine_determinant(a);
+        if (det == 0.0f) return {};
+        const float inv = 1.0f / det;
+        const auto& m = a.m;
+        affine3x4f r = {};
+        r.m[0][0] =  (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv;
+        r.m[0][1] = -(m[0][1] * m[2][2] - m[0][2] * m[2][1]) * inv;
+        r.m[0][2] =  (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv;
+        r.m[1][0] = -(m[1][0] * m[2][2] - m[1][2] * m[2][0]) * inv;
+        r.m[1][1] =  (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv;
+        r.m[1][2] = -(m[0][0] * m[1][2] - m[0][2] * m[1][0]) * inv;
+        r.m[2][0] =  (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv;
+        r.m[2][1] = -(m[0][0] * m[2][1] - m[0][1] * m[2][0]) * inv;
+        r.m[2][2] =  (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv;
+        for (int i = 0; i < 3; ++i) {
+            r.m[i][3] = -(r.m[i][0] * m[0][3] + r.m[i][1] * m[1][3] + r.m[i][2] * m[2][3]);
+        }
+        return r;
+    }
+
+    // Inverse-transpose of the linear part, for transforming normals
+    // under non-uniform scale. No translation.
+    constexpr affine3x4f affine_normal_matrix(const affine3x4f& a) {
+        const affine3x4f inv = affine_inverse(a);
+        affine3x4f r = {};
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                r.m[i][j] = inv.m[j][i];
+        return r;
+    }
+
+
+    constexpr float mat_determinant(const mat4f& a) {
+        const auto& m = a.m;
+        const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+        const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+
+    // Zero matrix if a is singular. Prefer affine_inverse for affines.
+    constexpr mat4f mat_inverse(const mat4f& a) {
+        const auto& m = a.m;
+        const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+        const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+        const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        if (det == 0.0f) return {};
+        const float inv = 1.0f / det;
+
+        mat4f r = {};
+        r.m[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * inv;
+        r.m[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * inv;
+        r.m[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * inv;
+        r.m[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * inv;
+        r.m[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * inv;
+        r.m[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * inv;
+        r.m[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * inv;
+        r.m[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * inv;
+        r.m[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * inv;
+        r.m[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * inv;
+        r.m[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * inv;
+        r.m[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * inv;
+        r.m[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * inv;
+        r.m[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * inv;
+        r.m[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * inv;
+        r.m[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * inv;
+        return r;
+    }
+
+    // Inverse-transpose of the upper 3x3, identity elsewhere.
+    constexpr mat4f mat_normal(const mat4f& m) {
+        return affine_to_mat4(affine_normal_matrix(affine_from_mat4(m)));
+    }
+
+
+    constexpr mat4f mat_frustum(float left, float right, float bottom, float top,
+                                float nearZ, float farZ) {
+        mat4f m = {};
+        m.m[0][0] = 2.0f * nearZ / (right - left);
+        m.m[0][2] = (right + left) / (right - left);
+        m.m[1][1] = 2.0f * nearZ / (top - bottom);
+        m.m[1][2] = (top + bottom) / (top - bottom);
+        m.m[2][2] = -(farZ + nearZ) / (farZ - nearZ);
+        m.m[2][3] = -2.0f * farZ * nearZ / (farZ - nearZ);
+        m.m[3][2] = -1.0f;
+        return m;
+    }
+
+    // fovY in radians.
+    inline mat4f mat_perspective(float fovY, float aspect, float nearZ, float farZ) {
+        const float top = nearZ * std::tan(0.5f * fovY);
+        return mat_frustum(-top * aspect, top * aspect, -top, top, nearZ, farZ);
+    }
+
+    constexpr mat4f mat_orthographic(float left, float right, float bottom, float top,
+                                     float nearZ, float farZ) {
+        mat4f m = {};
+        m.m[0][0] = 2.0f / (right - left);
+        m.m[0][3] = -(right + left) / (right - left);
+        m.m[1][1] = 2.0f / (top - bottom);
+        m.m[1][3] = -(top + bottom) / (top - bottom);
+        m.m[2][2] = -2.0f / (farZ - nearZ);
+        m.m[2][3] = -(farZ + nearZ) / (farZ - nearZ);
+        m.m[3][3] = 1.0f;
+        return m;
+    }
+
+    // View matrix of a camera at eye looking at target. Only xyz are used.
+    constexpr affine3x4f affine_look_at(const vec4f& eye, const vec4f& target, const vec4f& up) {
+        const auto normalize3 = [](float x, float y, float z) {
+            const float len = detail::sqrt(x * x + y * y + z * z);
+            const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+            return vec4f{ x * inv, y * inv, z * inv, 0.0f };
+        };
+        const vec4f f = normalize3(target.x - eye.x, target.y - eye.y, target.z - eye.z);
+        const vec4f s = normalize3(f.y * up.z - f.z * up.y, f.z * up.x - f.x * up.z, f.x * up.y - f.y * up.x);
+        const vec4f u = { s.y * f.z - s.z * f.y, s.z * f.x - s.x * f.z, s.x * f.y - s.y * f.x, 0.0f };
+        return { {
+            {  s.x,  s.y,  s.z, -(s.x * eye.x + s.y * eye.y + s.z * eye.z) },
+            {  u.x,  u.y,  u.z, -(u.x * eye.x + u.y * eye.y + u.z * eye.z) },
+            { -f.x, -f.y, -f.z,  (f.x * eye.x + f.y * eye.y + f.z * eye.z) }
+        } };
+    }
+
+    static_assert(affine_mul(affine_identity(), affine_identity()).m[2][2] == 1.0f);
+    static_assert(mat_determinant(mat_identity()) == 1.0f);
+
+} // namespace hwr
+
+#endif // HWR_TRANSFORM_HPP
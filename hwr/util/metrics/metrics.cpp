@@ -0,0 +1,199 @@
+#include "metrics.hpp"
+#include "../log/log.hpp"
+#include "../json/json.hpp"
+#include <algorithm>
+#include <fstream>
+
+namespace hwr {
+
+    namespace detail {
+
+        size_t metricShard() {
+            static std::atomic<size_t> nextThread{0};
+            thread_local const size_t shard =
+                nextThread.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+            return shard;
+        }
+
+    }
+
+    uint64_t Counter::value() const {
+        uint64_t sum = 0;
+        for (const detail::MetricCell& cell : m_shards) {
+            sum += cell.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    double HistogramSnapshot::quantile(double q) const {
+        if (count == 0) {
+            return 0.0;
+        }
+        const double target = q * static_cast<double>(count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (static_cast<double>(seen) >= target && counts[i] > 0) {
+                return i < bounds.size() ? bounds[i] : bounds.back();
+            }
+        }
+        return bounds.back();
+    }
+
+    Histogram::Histogram(std::vector<double> bounds)
+        : m_bounds(std::move(bounds))
+    {
+        if (m_bounds.empty() || !std::is_sorted(m_bounds.begin(), m_bounds.end())) {
+            HWR_FATAL("Histogram - bounds must be non-empty and ascending");
+        }
+        for (Shard& shard : m_shards) {
+            const size_t buckets = m_bounds.size() + 1;
+            shard.lines = std::make_unique<BucketLine[]>((buckets + BUCKETS_PER_LINE - 1) / BUCKETS_PER_LINE);
+        }
+    }
+
+    void Histogram::record(double v) {
+        const size_t bucket = static_cast<size_t>(
+            std::lower_bound(m_bounds.begin(), m_bounds.end(), v) - m_bounds.begin());
+        Shard& shard = m_shards[detail::metricShard()];
+        shard.bucket(bucket).fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot Histogram::snapshot() const {
+        HistogramSnapshot res;
+        res.bounds = m_bounds;
+        res.counts.assign(m_bounds.size() + 1, 0);
+        for (const Shard& shard : m_shards) {
+            for (size_t i = 0; i < res.counts.size(); ++i) {
+                const uint64_t c = shard.bucket(i).load(std::memory_order_relaxed);
+                res.counts[i] += c;
+                res.count += c;
+            }
+            res.sum += shard.sum.load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    std::vector<double> Histogram::latencyBounds() {
+        std::vector<double> res;
+        for (double b = 0.01; b < 1000.0; b *= 2.0) {
+            res.push_back(b);
+        }
+        return res;
+    }
+
+    MetricsRegistry& MetricsRegistry::instance() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    MetricsRegistry::~MetricsRegistry() {
+        stopExport();
+    }
+
+    Counter& MetricsRegistry::counter(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_ptr<Counter>& slot = m_counters[name];
+        if (!slot) {
+            slot = std::make_unique<Counter>();
+        }
+        return *slot;
+    }
+
+    Gauge& MetricsRegistry::gauge(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_ptr<Gauge>& slot = m_gauges[name];
+        if (!slot) {
+            slot = std::make_unique<Gauge>();
+        }
+        return *slot;
+    }
+
+    Histogram& MetricsRegistry::histogram(const std::string& name, const std::vector<double>& bounds) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_ptr<Histogram>& slot = m_histograms[name];
+        if (!slot) {
+            slot = std::make_unique<Histogram>(bounds);
+        }
+        return *slot;
+    }
+
+    MetricsSnapshot MetricsRegistry::snapshot() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        MetricsSnapshot res;
+        res.time = std::chrono::system_clock::now();
+        for (const auto& [name, c] : m_counters) {
+            res.counters.emplace_back(name, c->value());
+        }
+        for (const auto& [name, g] : m_gauges) {
+            res.gauges.emplace_back(name, g->value());
+        }
+        for (const auto& [name, h] : m_histograms) {
+            res.histograms.emplace_back(name, h->snapshot());
+        }
+        return res;
+    }
+
+    bool MetricsRegistry::writeSnapshot(const std::string& path) const {
+        const MetricsSnapshot snap = snapshot();
+        std::ofstream out(path, std::ios::app);
+        if (!out) {
+            HWR_ERR("MetricsRegistry::writeSnapshot - cannot open " + path);
+            return false;
+        }
+
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            snap.time.time_since_epoch()).count();
+
+        out << std::fixed;
+        out.precision(3);
+        out << "{\"time_ms\":" << ms << ",\"counters\":{";
+        for (size_t i = 0; i < snap.counters.size(); ++i) {
+            out << (i ? "," : "") << "\"" << jsonEscape(snap.counters[i].first) << "\":"
+                << snap.counters[i].second;
+        }
+        out << "},\"gauges\":{";
+        for (size_t i = 0; i < snap.gauges.size(); ++i) {
+            out << (i ? "," : "") << "\"" << jsonEscape(snap.gauges[i].first) << "\":"
+                << snap.gauges[i].second;
+        }
+        out << "},\"histograms\":{";
+        for (size_t i = 0; i < snap.histograms.size(); ++i) {
+            const HistogramSnapshot& h = snap.histograms[i].second;
+            out << (i ? "," : "") << "\"" << jsonEscape(snap.histograms[i].first) << "\":{"
+                << "\"count\":" << h.count
+                << ",\"mean\":" << h.mean()
+                << ",\"p50\":" << h.quantile(0.5)
+                << ",\"p95\":" << h.quantile(0.95)
+                << ",\"p99\":" << h.quantile(0.99) << "}";
+        }
+        out << "}}\n";
+        return static_cast<bool>(out);
+    }
+
+    void MetricsRegistry::startExport(const std::string& path, std::chrono::milliseconds interval) {
+        stopExport();
+        m_exportStop = false;
+        m_exporter = std::thread([this, path, interval] {
+            std::unique_lock<std::mutex> lock(m_exportMutex);
+            while (!m_exportCv.wait_for(lock, interval, [this] { return m_exportStop; })) {
+                writeSnapshot(path);
+            }
+            writeSnapshot(path); // final state on stop
+        });
+    }
+
+    void MetricsRegistry::stopExport() {
+        if (!m_exporter.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_exportMutex);
+            m_exportStop = true;
+        }
+        m_exportCv.notify_all();
+        m_exporter.join();
+    }
+
+} // namespace hwr
@@ -0,0 +1,180 @@
+#ifndef HWR_METRICS_HPP
+#define HWR_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hwr {
+
+    namespace detail {
+        constexpr size_t METRIC_SHARDS = 16;
+
+        // Shard of the calling thread; threads are spread round robin.
+        size_t metricShard();
+
+        struct alignas(64) MetricCell {
+            std::atomic<uint64_t> value{0};
+        };
+    }
+
+    // Monotonic count. add() only touches the calling thread's shard.
+    class Counter {
+    public:
+        void add(uint64_t n = 1) {
+            m_shards[detail::metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const;
+
+    private:
+        std::array<detail::MetricCell, detail::METRIC_SHARDS> m_shards;
+    };
+
+    // Current level of something, e.g. bytes resident. Last set() wins.
+    class Gauge {
+    public:
+        void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+        void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value{0};
+    };
+
+    struct HistogramSnapshot {
+        std::vector<double> bounds;     // upper bucket bounds, ascending
+        std::vector<uint64_t> counts;   // bounds.size() + 1, last is overflow
+        uint64_t count = 0;
+        double sum = 0.0;
+
+        double mean() const { return count ? sum / static_cast<double>(count) : 0.0; }
+        // Upper bound of the bucket holding the q-quantile, q in [0, 1].
+        double quantile(double q) const;
+    };
+
+    /**
+    * \class Histogram
+    * \brief Distribution over fixed buckets, e.g. latencies in ms.
+    *
+    * record() increments one bucket of the calling thread's shard, so
+    * threads never contend on the same cache line.
+    */
+    class Histogram {
+    public:
+        explicit Histogram(std::vector<double> bounds);
+
+        void record(double v);
+        HistogramSnapshot snapshot() const;
+
+        // 0.01 ms .. ~650 ms in powers of two.
+        static std::vector<double> latencyBounds();
+
+    private:
+        // Buckets come in whole cache lines, so the counts of two shards
+        // never share one.
+        static constexpr size_t BUCKETS_PER_LINE = 64 / sizeof(std::atomic<uint64_t>);
+        struct alignas(64) BucketLine {
+            std::array<std::atomic<uint64_t>, BUCKETS_PER_LINE> counts{};
+        };
+
+        struct alignas(64) Shard {
+            std::unique_ptr<BucketLine[]> lines;
+            std::atomic<double> sum{0.0};
+
+            std::atomic<uint64_t>& bucket(size_t i) {
+                return lines[i / BUCKETS_PER_LINE].counts[i % BUCKETS_PER_LINE];
+            }
+            const std::atomic<uint64_t>& bucket(size_t i) const {
+                return lines[i / BUCKETS_PER_LINE].counts[i % BUCKETS_PER_LINE];
+            }
+        };
+
+        std::vector<double> m_bounds;
+        std::array<Shard, detail::METRIC_SHARDS> m_shards;
+    };
+
+    struct MetricsSnapshot {
+        std::chrono::system_clock::time_point time;
+        std::vector<std::pair<std::string, uint64_t>> counters;
+        std::vector<std::pair<std::string, int64_t>> gauges;
+        std::vector<std::pair<std::string, HistogramSnapshot>> histograms;
+    };
+
+    /**
+    * \class MetricsRegistry
+    * \brief Named counters, gauges and histograms of the process.
+    *
+    * Lookup by name takes a lock, so call sites keep the reference:
+    *   static Counter& uploads = metrics().counter("gpu.buffer.uploads");
+    * Metrics live as long as the registry. Snapshots can be appended to a
+    * file as JSON lines, once or periodically from a background thread.
+    */
+    class MetricsRegistry {
+    public:
+        static MetricsRegistry& instance();
+
+        ~MetricsRegistry();
+
+        Counter& counter(const std::string& name);
+        Gauge& gauge(const std::string& name);
+        // bounds are only used when the histogram is created.
+        Histogram& histogram(const std::string& name,
+                             const std::vector<double>& bounds = Histogram::latencyBounds());
+
+        MetricsSnapshot snapshot() const;
+
+        // Appends one JSON line; returns false if the file cannot be written.
+        bool writeSnapshot(const std::string& path) const;
+
+        // Appends a snapshot every interval until stopExport().
+        void startExport(const std::string& path, std::chrono::milliseconds interval);
+        void stopExport();
+
+    private:
+        MetricsRegistry() = default;
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, std::unique_ptr<Counter>> m_counters;
+        std::map<std::string, std::unique_ptr<Gauge>> m_gauges;
+        std::map<std::string, std::unique_ptr<Histogram>> m_histograms;
+
+        std::mutex m_exportMutex;
+        std::condition_variable m_exportCv;
+        bool m_exportStop = false;
+        std::thread m_exporter;
+    };
+
+    inline MetricsRegistry& metrics() { return MetricsRegistry::instance(); }
+
+    // Records the time between construction and destruction in ms.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram)
+            : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer() {
+            const std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - m_start;
+            m_histogram.record(elapsed.count());
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& m_histogram;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+} // namespace hwr
+
+#endif // HWR_METRICS_HPP
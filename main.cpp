@@ -4,9 +4,13 @@
 #include <hwr/math.hpp>
 #include <hwr/shader/types.hpp>
 #include <hwr/shader/shader.hpp>
+#include <hwr/layout.hpp>
+#include <hwr/compute.hpp>
 #include<cassert>
 #include<iostream>
 #include<string>
+#include<span>
+#include<vector>
 
 using vec4 = hwr::vec4f;
 
@@ -57,6 +61,24 @@ int main(){
 
     std::string code = sample_struct::opencl_def.compile();
     std::cout<<code<<std::endl;
+
+    // host and device must agree on where each field sits.
+    hwr::verifyStructLayouts<sample_struct>(gpu_context);
+
+    // same structs, one buffer per field. Binding the SoABuffer by name
+    // binds all of its columns.
+    std::vector<sample_struct> samples(256, sample_struct{1.0f, 2.0f, 3.0f});
+    hwr::SoABuffer<sample_struct> soa(gpu_context, samples.size());
+    soa.writeFrom(std::span<const sample_struct>(samples));
+    hwr::ComputeKernel scale{gpu_context, [](){
+        auto s = hwr::soa_buffer<sample_struct>("samples");
+        UInt i = hwr::global_id();
+        s.field<float>("y")[i] = s.field<float>("x")[i] * 2.0f;
+    }};
+    scale.bind("samples", soa);
+    scale.dispatch(cl::NDRange(samples.size()));
+    soa.readTo(std::span<sample_struct>(samples));
+    assert(samples[0].y == 2.0f);
     
     
 }
\ No newline at end of file